@@ -24,6 +24,11 @@
  * =======================================================================
  */
 
+/* For recvmmsg() and sendmmsg() - must be before any include! */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+ #define _GNU_SOURCE
+#endif
+
 #include "../../common/header/common.h"
 
 #include <unistd.h>
@@ -44,12 +49,25 @@
 #include <arpa/inet.h>
 #include <net/if.h>
 
+#if defined(__linux__)
+ #include <sys/epoll.h>
+ #include <sys/timerfd.h>
+ #define HAVE_EPOLL
+#endif
+
 netadr_t net_local_adr;
 
 #define LOOPBACK 0x7f000001
 #define MAX_LOOPBACK 4
 #define QUAKE2MCAST "ff12::666"
 
+#if defined(__linux__)
+ #define HAVE_MMSG
+#endif
+
+/* Packets per recvmmsg() and sendmmsg() call */
+#define NET_BATCH 32
+
 typedef struct
 {
 	byte data[MAX_MSGLEN];
@@ -70,6 +88,56 @@ char *multicast_interface = NULL;
 
 static int NET_Socket(char *net_interface, int port, netsrc_t type, int family);
 static const char *NET_ErrorString(void);
+#ifdef HAVE_EPOLL
+static void NET_CloseEpoll(void);
+#endif
+
+/* Counters for net_stats */
+static struct
+{
+	size_t recvcalls, recvpackets, recvbytes;
+	size_t sendcalls, sendpackets, sendbytes;
+} net_stats;
+
+#ifdef HAVE_MMSG
+/* Packets read ahead by recvmmsg(), one
+   queue per netsrc_t and IPv4 / IPv6 */
+typedef struct
+{
+	byte data[NET_BATCH][MAX_MSGLEN];
+	struct sockaddr_storage from[NET_BATCH];
+	int length[NET_BATCH];
+	int count, next;
+} netrecvqueue_t;
+
+static netrecvqueue_t recvqueues[2][2];
+
+/* Packets waiting for sendmmsg() */
+typedef struct
+{
+	int socket;
+	struct sockaddr_storage addr;
+	socklen_t addr_size;
+	netadr_t to;
+	int length;
+	byte data[MAX_MSGLEN];
+} netsendqueue_t;
+
+static netsendqueue_t sendqueue[NET_BATCH];
+static int sendcount;
+#endif
+
+static qboolean batching[2];
+
+#ifdef HAVE_EPOLL
+/* NET_Sleep() waits on the server sockets,
+   stdin and a timer in one epoll set. */
+static int net_epollfd = -1;
+static int net_timerfd = -1;
+static int net_epollsockets[2];
+static qboolean net_epollstdin;
+static qboolean net_epollstdinfailed;
+#endif
 
 static void
 NetadrToSockadr(netadr_t *a, struct sockaddr_storage *s)
@@ -184,9 +252,27 @@ SockadrToNetadr(struct sockaddr_storage *s, netadr_t *a)
 	}
 }
 
+static void
+NET_Stats_f(void)
+{
+	if ((Cmd_Argc() == 2) && !strcmp(Cmd_Argv(1), "reset"))
+	{
+		memset(&net_stats, 0, sizeof(net_stats));
+		return;
+	}
+
+	Com_Printf("received " YQ2_COM_PRIdS " packets, " YQ2_COM_PRIdS
+			" bytes in " YQ2_COM_PRIdS " calls\n",
+			net_stats.recvpackets, net_stats.recvbytes, net_stats.recvcalls);
+	Com_Printf("sent " YQ2_COM_PRIdS " packets, " YQ2_COM_PRIdS
+			" bytes in " YQ2_COM_PRIdS " calls\n",
+			net_stats.sendpackets, net_stats.sendbytes, net_stats.sendcalls);
+}
+
 void
 NET_Init()
 {
+	Cmd_AddCommand("net_stats", NET_Stats_f);
 }
 
 qboolean
@@ -512,6 +598,83 @@ NET_SendLoopPacket(netsrc_t sock, int length, void *data, netadr_t to)
 	loop->msgs[i].datalen = length;
 }
 
+#ifdef HAVE_MMSG
+/*
+ * Returns the next packet of a socket. The packets
+ * are read NET_BATCH at a time by recvmmsg().
+ */
+static qboolean
+NET_GetQueuedPacket(netsrc_t sock, int protocol, int net_socket,
+		netadr_t *net_from, sizebuf_t *net_message)
+{
+	netrecvqueue_t *queue = &recvqueues[sock][protocol];
+	struct mmsghdr msgs[NET_BATCH];
+	struct iovec iovs[NET_BATCH];
+	int i, ret;
+
+	for ( ; ; )
+	{
+		if (queue->next == queue->count)
+		{
+			memset(msgs, 0, sizeof(msgs));
+
+			for (i = 0; i < NET_BATCH; i++)
+			{
+				iovs[i].iov_base = queue->data[i];
+				iovs[i].iov_len = sizeof(queue->data[i]);
+
+				msgs[i].msg_hdr.msg_name = &queue->from[i];
+				msgs[i].msg_hdr.msg_namelen = sizeof(queue->from[i]);
+				msgs[i].msg_hdr.msg_iov = &iovs[i];
+				msgs[i].msg_hdr.msg_iovlen = 1;
+			}
+
+			queue->count = queue->next = 0;
+
+			ret = recvmmsg(net_socket, msgs, NET_BATCH, MSG_DONTWAIT, NULL);
+			net_stats.recvcalls++;
+
+			if (ret == -1)
+			{
+				if ((errno != EWOULDBLOCK) && (errno != ECONNREFUSED))
+				{
+					Com_Printf("%s: %s\n", NET_ErrorString(), __func__);
+				}
+
+				return false;
+			}
+
+			for (i = 0; i < ret; i++)
+			{
+				queue->length[i] = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) ?
+					-1 : (int)msgs[i].msg_len;
+			}
+
+			queue->count = ret;
+		}
+
+		i = queue->next++;
+
+		SockadrToNetadr(&queue->from[i], net_from);
+
+		if ((queue->length[i] < 0) ||
+			(queue->length[i] >= net_message->maxsize))
+		{
+			Com_Printf("Oversize packet from %s\n", NET_AdrToString(*net_from));
+			continue;
+		}
+
+		memcpy(net_message->data, queue->data[i], queue->length[i]);
+		net_message->cursize = queue->length[i];
+
+		net_stats.recvpackets++;
+		net_stats.recvbytes += net_message->cursize;
+
+		return true;
+	}
+}
+#endif
+
 qboolean
 NET_GetPacket(netsrc_t sock, netadr_t *net_from, sizebuf_t *net_message)
 {
@@ -547,9 +710,23 @@ NET_GetPacket(netsrc_t sock, netadr_t *net_from, sizebuf_t *net_message)
 			continue;
 		}
 
+#ifdef HAVE_MMSG
+		if (protocol < 2)
+		{
+			if (NET_GetQueuedPacket(sock, protocol, net_socket,
+						net_from, net_message))
+			{
+				return true;
+			}
+
+			continue;
+		}
+#endif
+
 		fromlen = sizeof(from);
 		ret = recvfrom(net_socket, net_message->data, net_message->maxsize,
 				0, (struct sockaddr *)&from, &fromlen);
+		net_stats.recvcalls++;
 
 		SockadrToNetadr(&from, net_from);
 
@@ -574,12 +751,99 @@ NET_GetPacket(netsrc_t sock, netadr_t *net_from, sizebuf_t *net_message)
 		}
 
 		net_message->cursize = ret;
+
+		net_stats.recvpackets++;
+		net_stats.recvbytes += ret;
+
 		return true;
 	}
 
 	return false;
 }
 
+#ifdef HAVE_MMSG
+/*
+ * Sends all queued packets, one sendmmsg()
+ * call for each run of packets to the same
+ * socket.
+ */
+static void
+NET_FlushSendQueue(void)
+{
+	struct mmsghdr msgs[NET_BATCH];
+	struct iovec iovs[NET_BATCH];
+	int first, count, ret, i;
+
+	memset(msgs, 0, sizeof(msgs));
+
+	for (i = 0; i < sendcount; i++)
+	{
+		iovs[i].iov_base = sendqueue[i].data;
+		iovs[i].iov_len = sendqueue[i].length;
+
+		msgs[i].msg_hdr.msg_name = &sendqueue[i].addr;
+		msgs[i].msg_hdr.msg_namelen = sendqueue[i].addr_size;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	for (first = 0; first < sendcount; first += ret)
+	{
+		for (count = 1; first + count < sendcount; count++)
+		{
+			if (sendqueue[first + count].socket != sendqueue[first].socket)
+			{
+				break;
+			}
+		}
+
+		ret = sendmmsg(sendqueue[first].socket, &msgs[first], count, 0);
+		net_stats.sendcalls++;
+
+		if (ret <= 0)
+		{
+			/* skip the packet that failed */
+			Com_Printf("%s ERROR: %s to %s\n", NET_ErrorString(),
+					__func__, NET_AdrToString(sendqueue[first].to));
+			ret = 1;
+			continue;
+		}
+
+		for (i = first; i < first + ret; i++)
+		{
+			net_stats.sendbytes += msgs[i].msg_len;
+		}
+
+		net_stats.sendpackets += ret;
+	}
+
+	sendcount = 0;
+}
+#endif
+
+/*
+ * Between NET_BatchPackets() and NET_FlushPackets() the
+ * packets of a netsrc_t are queued and sent at once.
+ */
+void
+NET_BatchPackets(netsrc_t sock)
+{
+	batching[sock] = true;
+}
+
+void
+NET_FlushPackets(netsrc_t sock)
+{
+	batching[sock] = false;
+
+#ifdef HAVE_MMSG
+	if (sendcount)
+	{
+		NET_FlushSendQueue();
+	}
+#endif
+}
+
 void
 NET_SendPacket(netsrc_t sock, int length, void *data, netadr_t to)
 {
@@ -720,18 +984,46 @@ NET_SendPacket(netsrc_t sock, int length, void *data, netadr_t to)
 		}
 	}
 
+#ifdef HAVE_MMSG
+	if (batching[sock] && (length <= MAX_MSGLEN))
+	{
+		netsendqueue_t *queued;
+
+		if (sendcount == NET_BATCH)
+		{
+			NET_FlushSendQueue();
+		}
+
+		queued = &sendqueue[sendcount++];
+
+		queued->socket = net_socket;
+		queued->addr = addr;
+		queued->addr_size = addr_size;
+		queued->to = to;
+		queued->length = length;
+		memcpy(queued->data, data, length);
+
+		return;
+	}
+#endif
+
 	ret = sendto(net_socket,
 			data,
 			length,
 			0,
 			(struct sockaddr *)&addr,
 			addr_size);
+	net_stats.sendcalls++;
 
 	if (ret == -1)
 	{
 		Com_Printf("%s ERROR: %s to %s\n", NET_ErrorString(),
 				__func__, NET_AdrToString(to));
+		return;
 	}
+
+	net_stats.sendpackets++;
+	net_stats.sendbytes += ret;
 }
 
 static void
@@ -773,6 +1065,20 @@ NET_OpenIP(void)
 void
 NET_Config(qboolean multiplayer)
 {
+#ifdef HAVE_EPOLL
+	NET_CloseEpoll();
+#endif
+
+#ifdef HAVE_MMSG
+	/* the queues belong to the old sockets */
+	if (sendcount)
+	{
+		NET_FlushSendQueue();
+	}
+
+	memset(recvqueues, 0, sizeof(recvqueues));
+#endif
+
 	if (!multiplayer)
 	{
 		int i;
@@ -991,23 +1297,175 @@ NET_ErrorString(void)
 	return strerror(code);
 }
 
+#ifdef HAVE_EPOLL
+static void
+NET_CloseEpoll(void)
+{
+	if (net_epollfd != -1)
+	{
+		close(net_epollfd);
+	}
+
+	if (net_timerfd != -1)
+	{
+		close(net_timerfd);
+	}
+
+	net_epollfd = -1;
+	net_timerfd = -1;
+	net_epollsockets[0] = net_epollsockets[1] = 0;
+	net_epollstdin = false;
+	net_epollstdinfailed = false;
+}
+
+static qboolean
+NET_EpollWatch(int fd, qboolean watch)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+
+	if (epoll_ctl(net_epollfd, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL,
+				fd, &ev) == -1)
+	{
+		/* closed sockets already left the set by themselves */
+		if (watch)
+		{
+			Com_Printf("%s: fd %i: %s\n", __func__, fd, NET_ErrorString());
+		}
+
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Sleeps with epoll on the server sockets and stdin. A
+ * timerfd ends the sleep, so the wakeup is precise to
+ * the microsecond. Returns false if epoll isn't usable.
+ */
+static qboolean
+NET_SleepEpoll(int usec, qboolean watchstdin)
+{
+	struct epoll_event events[4];
+	struct itimerspec timer;
+	uint64_t expirations;
+	int sockets[2];
+	int i;
+
+	if (net_epollfd == -1)
+	{
+		net_epollfd = epoll_create1(EPOLL_CLOEXEC);
+		net_timerfd = timerfd_create(CLOCK_MONOTONIC,
+				TFD_NONBLOCK | TFD_CLOEXEC);
+
+		if ((net_epollfd == -1) || (net_timerfd == -1) ||
+			!NET_EpollWatch(net_timerfd, true))
+		{
+			Com_Printf("%s: %s, falling back to select()\n",
+					__func__, NET_ErrorString());
+			NET_CloseEpoll();
+			return false;
+		}
+	}
+
+	/* the sockets change with NET_Config() */
+	sockets[0] = ip_sockets[NS_SERVER];
+	sockets[1] = ip6_sockets[NS_SERVER];
+
+	for (i = 0; i < 2; i++)
+	{
+		if (sockets[i] != net_epollsockets[i])
+		{
+			if (net_epollsockets[i])
+			{
+				NET_EpollWatch(net_epollsockets[i], false);
+			}
+
+			if (sockets[i])
+			{
+				NET_EpollWatch(sockets[i], true);
+			}
+
+			net_epollsockets[i] = sockets[i];
+		}
+	}
+
+	/* stdin can't always be watched, for example when
+	   it's a regular file. The console is still read
+	   every frame, just without waking up early. */
+	if ((watchstdin != net_epollstdin) && !net_epollstdinfailed)
+	{
+		if (NET_EpollWatch(0, watchstdin))
+		{
+			net_epollstdin = watchstdin;
+		}
+
+		else if (watchstdin)
+		{
+			net_epollstdinfailed = true;
+		}
+	}
+
+	memset(&timer, 0, sizeof(timer));
+	timer.it_value.tv_sec = usec / 1000000;
+	timer.it_value.tv_nsec = (usec % 1000000) * 1000;
+
+	timerfd_settime(net_timerfd, 0, &timer, NULL);
+
+	epoll_wait(net_epollfd, events, sizeof(events) / sizeof(events[0]), -1);
+
+	/* disarm and drain the timer for the next sleep */
+	memset(&timer, 0, sizeof(timer));
+	timerfd_settime(net_timerfd, 0, &timer, NULL);
+
+	if (read(net_timerfd, &expirations, sizeof(expirations)) < 0)
+	{
+		/* not expired, woken up by a socket */
+	}
+
+	return true;
+}
+#endif
+
 /*
- * sleeps msec or until net socket is ready
+ * sleeps usec or until net socket is ready
  */
 void
-NET_Sleep(int msec)
+NET_Sleep(int usec)
 {
 	struct timeval timeout;
 	fd_set fdset;
 	extern cvar_t *dedicated;
 	extern qboolean stdin_active;
 
-	if ((!ip_sockets[NS_SERVER] &&
-		 !ip6_sockets[NS_SERVER]) || (dedicated && !dedicated->value))
+	if (dedicated && !dedicated->value)
 	{
 		return; /* we're not a server, just run full speed */
 	}
 
+	if (usec <= 0)
+	{
+		return;
+	}
+
+	if (!ip_sockets[NS_SERVER] && !ip6_sockets[NS_SERVER])
+	{
+		/* nothing to wait for */
+		Sys_Nanosleep(usec * 1000);
+		return;
+	}
+
+#ifdef HAVE_EPOLL
+	if (NET_SleepEpoll(usec, stdin_active))
+	{
+		return;
+	}
+#endif
+
 	FD_ZERO(&fdset);
 
 	if (stdin_active)
@@ -1017,9 +1475,8 @@ NET_Sleep(int msec)
 
 	FD_SET(ip_sockets[NS_SERVER], &fdset); /* IPv4 network socket */
 	FD_SET(ip6_sockets[NS_SERVER], &fdset); /* IPv6 network socket */
-	timeout.tv_sec = msec / 1000;
-	timeout.tv_usec = (msec % 1000) * 1000;
+	timeout.tv_sec = usec / 1000000;
+	timeout.tv_usec = usec % 1000000;
 	select(MAX(ip_sockets[NS_SERVER],
 					ip6_sockets[NS_SERVER]) + 1, &fdset, NULL, NULL, &timeout);
 }
-
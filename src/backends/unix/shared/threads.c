@@ -0,0 +1,198 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * Thin wrappers around POSIX threads, mutexes and condition variables.
+ * Shared between the engine and the renderer libraries, so they must
+ * not use the zone allocator.
+ *
+ * =======================================================================
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../../../common/header/shared.h"
+
+struct qthread_s
+{
+	pthread_t handle;
+	void (*func)(void *data);
+	void *data;
+};
+
+struct qmutex_s
+{
+	pthread_mutex_t handle;
+};
+
+struct qcond_s
+{
+	pthread_cond_t handle;
+};
+
+static void *
+Thread_Main(void *arg)
+{
+	qthread_t *thread = arg;
+
+	thread->func(thread->data);
+
+	return NULL;
+}
+
+qthread_t *
+Thread_Create(void (*func)(void *data), void *data)
+{
+	qthread_t *thread;
+
+	thread = malloc(sizeof(*thread));
+
+	if (!thread)
+	{
+		return NULL;
+	}
+
+	thread->func = func;
+	thread->data = data;
+
+	if (pthread_create(&thread->handle, NULL, Thread_Main, thread) != 0)
+	{
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+void
+Thread_Join(qthread_t *thread)
+{
+	if (!thread)
+	{
+		return;
+	}
+
+	pthread_join(thread->handle, NULL);
+	free(thread);
+}
+
+int
+Thread_NumCPUs(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (n > 0) ? (int)n : 1;
+}
+
+qmutex_t *
+Mutex_Create(void)
+{
+	qmutex_t *mutex;
+
+	mutex = malloc(sizeof(*mutex));
+
+	if (!mutex)
+	{
+		return NULL;
+	}
+
+	if (pthread_mutex_init(&mutex->handle, NULL) != 0)
+	{
+		free(mutex);
+		return NULL;
+	}
+
+	return mutex;
+}
+
+void
+Mutex_Destroy(qmutex_t *mutex)
+{
+	if (!mutex)
+	{
+		return;
+	}
+
+	pthread_mutex_destroy(&mutex->handle);
+	free(mutex);
+}
+
+void
+Mutex_Lock(qmutex_t *mutex)
+{
+	pthread_mutex_lock(&mutex->handle);
+}
+
+void
+Mutex_Unlock(qmutex_t *mutex)
+{
+	pthread_mutex_unlock(&mutex->handle);
+}
+
+qcond_t *
+Cond_Create(void)
+{
+	qcond_t *cond;
+
+	cond = malloc(sizeof(*cond));
+
+	if (!cond)
+	{
+		return NULL;
+	}
+
+	if (pthread_cond_init(&cond->handle, NULL) != 0)
+	{
+		free(cond);
+		return NULL;
+	}
+
+	return cond;
+}
+
+void
+Cond_Destroy(qcond_t *cond)
+{
+	if (!cond)
+	{
+		return;
+	}
+
+	pthread_cond_destroy(&cond->handle);
+	free(cond);
+}
+
+void
+Cond_Wait(qcond_t *cond, qmutex_t *mutex)
+{
+	pthread_cond_wait(&cond->handle, &mutex->handle);
+}
+
+void
+Cond_Signal(qcond_t *cond)
+{
+	pthread_cond_signal(&cond->handle);
+}
+
+void
+Cond_Broadcast(qcond_t *cond)
+{
+	pthread_cond_broadcast(&cond->handle);
+}
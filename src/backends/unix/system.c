@@ -34,12 +34,18 @@
 #include <time.h>
 #include <unistd.h>
 #include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/select.h> /* for fd_set */
 #ifndef FNDELAY
 #define FNDELAY O_NDELAY
 #endif
 
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
 #ifdef __APPLE__
 #include <mach/clock.h>
 #include <mach/mach.h>
@@ -160,6 +166,66 @@ Sys_Init(void)
 
 }
 
+/*
+ * Forks count - 1 copies of the process. The copies share
+ * everything loaded so far with the parent copy-on-write.
+ * Returns the number of the running copy, 0 in the parent.
+ */
+int
+Sys_ForkInstances(int count)
+{
+#ifdef __linux__
+	pid_t parent = getpid();
+#endif
+	int i;
+
+	/* don't let the copies write the parents buffers again */
+	fflush(NULL);
+
+	/* nobody waits for the copies */
+	signal(SIGCHLD, SIG_IGN);
+
+	for (i = 1; i < count; i++)
+	{
+		pid_t pid = fork();
+
+		if (pid == -1)
+		{
+			Com_Printf("Couldn't fork instance %i: %s\n", i, strerror(errno));
+			break;
+		}
+
+		if (pid == 0)
+		{
+#ifdef __linux__
+			/* go down together with the parent */
+			prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+			if (getppid() != parent)
+			{
+				_exit(0);
+			}
+#endif
+
+			signal(SIGCHLD, SIG_DFL);
+
+			/* only the parent reads the console */
+			stdin_active = false;
+
+			/* every instance has its own log */
+			if (logfile)
+			{
+				fclose(logfile);
+				logfile = NULL;
+			}
+
+			return i;
+		}
+	}
+
+	return 0;
+}
+
 /* ================================================================ */
 
 char *
@@ -509,6 +575,20 @@ Sys_GetGameAPI(void *parms)
 	return GetGameAPI(parms);
 }
 
+/*
+ * Looks up an optional entry point of the loaded game.
+ */
+void *
+Sys_GetGameProc(const char *sym)
+{
+	if (!game_library)
+	{
+		return NULL;
+	}
+
+	return dlsym(game_library, sym);
+}
+
 /* ================================================================ */
 
 void
@@ -662,6 +742,73 @@ Sys_Realpath(const char *in, char *out, size_t size)
 	return true;
 }
 
+/*
+ * Maps size bytes at offset of the given file into memory.
+ * The mapping is private and copy-on-write, callers may
+ * modify the returned data without touching the file. Bytes
+ * past the end of the file read as zero. Returns NULL if the
+ * file can't be mapped. base and mapsize receive what must
+ * be passed to Sys_UnmapFile().
+ */
+void *
+Sys_MapFile(FILE *f, size_t offset, size_t size, void **base, size_t *mapsize)
+{
+	struct stat st;
+	size_t pagesize, delta, total, filelen;
+	byte *map;
+	int fd;
+
+	fd = fileno(f);
+
+	if ((fd < 0) || fstat(fd, &st) || !S_ISREG(st.st_mode))
+	{
+		return NULL;
+	}
+
+	if ((off_t)offset > st.st_size)
+	{
+		return NULL;
+	}
+
+	pagesize = (size_t)sysconf(_SC_PAGESIZE);
+	delta = offset % pagesize;
+	total = (delta + size + pagesize - 1) & ~(pagesize - 1);
+	filelen = (size_t)(st.st_size - (off_t)(offset - delta));
+
+	if (filelen > delta + size)
+	{
+		filelen = delta + size;
+	}
+
+	/* Reserve the whole range as zeroed memory first, so whatever
+	   isn't covered by the file below is safe to access. */
+	map = mmap(NULL, total, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (map == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	if (mmap(map, filelen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+			fd, (off_t)(offset - delta)) == MAP_FAILED)
+	{
+		munmap(map, total);
+		return NULL;
+	}
+
+	*base = map;
+	*mapsize = total;
+
+	return map + delta;
+}
+
+void
+Sys_UnmapFile(void *base, size_t mapsize)
+{
+	munmap(base, mapsize);
+}
+
 /* ================================================================ */
 
 void *
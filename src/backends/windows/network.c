@@ -61,6 +61,13 @@ static const char *NET_ErrorString(void);
 
 static WSADATA winsockdata;
 
+/* Counters for net_stats */
+static struct
+{
+	size_t recvcalls, recvpackets, recvbytes;
+	size_t sendcalls, sendpackets, sendbytes;
+} net_stats;
+
 /* ============================================================================= */
 
 static void
@@ -576,6 +583,7 @@ NET_GetPacket(netsrc_t sock, netadr_t *net_from, sizebuf_t *net_message)
 		ret = recvfrom(net_socket, (char *)net_message->data,
 				net_message->maxsize, 0, (struct sockaddr *)&from,
 				&fromlen);
+		net_stats.recvcalls++;
 
 		SockadrToNetadr(&from, net_from);
 
@@ -616,12 +624,30 @@ NET_GetPacket(netsrc_t sock, netadr_t *net_from, sizebuf_t *net_message)
 		}
 
 		net_message->cursize = ret;
+
+		net_stats.recvpackets++;
+		net_stats.recvbytes += ret;
+
 		return true;
 	}
 
 	return false;
 }
 
+/*
+ * Winsock has no batched send, packets
+ * are always sent right away.
+ */
+void
+NET_BatchPackets(netsrc_t sock)
+{
+}
+
+void
+NET_FlushPackets(netsrc_t sock)
+{
+}
+
 /* ============================================================================= */
 
 void
@@ -758,6 +784,7 @@ NET_SendPacket(netsrc_t sock, int length, void *data, netadr_t to)
 
 	ret = sendto(net_socket, data, length, 0,
 			(struct sockaddr *)&addr, addr_size);
+	net_stats.sendcalls++;
 
 	if (ret == -1)
 	{
@@ -795,7 +822,12 @@ NET_SendPacket(netsrc_t sock, int length, void *data, netadr_t to)
 						__func__, NET_ErrorString(), NET_AdrToString(to));
 			}
 		}
+
+		return;
 	}
+
+	net_stats.sendpackets++;
+	net_stats.sendbytes += ret;
 }
 
 /* ============================================================================= */
@@ -1216,11 +1248,11 @@ NET_Config(qboolean multiplayer)
 }
 
 /*
- * sleeps msec or until
+ * sleeps usec or until
  * net socket is ready
  */
 void
-NET_Sleep(int msec)
+NET_Sleep(int usec)
 {
 	struct timeval timeout;
 	fd_set fdset;
@@ -1257,8 +1289,8 @@ NET_Sleep(int msec)
 		}
 	}
 
-	timeout.tv_sec = msec / 1000;
-	timeout.tv_usec = (msec % 1000) * 1000;
+	timeout.tv_sec = usec / 1000000;
+	timeout.tv_usec = usec % 1000000;
 	i = Q_max(ip_sockets[NS_SERVER], ip6_sockets[NS_SERVER]);
 	i = Q_max(i, ipx_sockets[NS_SERVER]);
 	select(i + 1, &fdset, NULL, NULL, &timeout);
@@ -1266,6 +1298,23 @@ NET_Sleep(int msec)
 
 /* =================================================================== */
 
+static void
+NET_Stats_f(void)
+{
+	if ((Cmd_Argc() == 2) && !strcmp(Cmd_Argv(1), "reset"))
+	{
+		memset(&net_stats, 0, sizeof(net_stats));
+		return;
+	}
+
+	Com_Printf("received " YQ2_COM_PRIdS " packets, " YQ2_COM_PRIdS
+			" bytes in " YQ2_COM_PRIdS " calls\n",
+			net_stats.recvpackets, net_stats.recvbytes, net_stats.recvcalls);
+	Com_Printf("sent " YQ2_COM_PRIdS " packets, " YQ2_COM_PRIdS
+			" bytes in " YQ2_COM_PRIdS " calls\n",
+			net_stats.sendpackets, net_stats.sendbytes, net_stats.sendcalls);
+}
+
 void
 NET_Init(void)
 {
@@ -1285,6 +1334,8 @@ NET_Init(void)
 	noipx = Cvar_Get("noipx", "0", CVAR_NOSET);
 
 	net_shownet = Cvar_Get("net_shownet", "0", 0);
+
+	Cmd_AddCommand("net_stats", NET_Stats_f);
 }
 
 void
@@ -0,0 +1,188 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * Thin wrappers around Win32 threads, critical sections and condition
+ * variables. Shared between the engine and the renderer libraries, so
+ * they must not use the zone allocator.
+ *
+ * =======================================================================
+ */
+
+#include <windows.h>
+#include <stdlib.h>
+
+#include "../../../common/header/shared.h"
+
+struct qthread_s
+{
+	HANDLE handle;
+	void (*func)(void *data);
+	void *data;
+};
+
+struct qmutex_s
+{
+	CRITICAL_SECTION handle;
+};
+
+struct qcond_s
+{
+	CONDITION_VARIABLE handle;
+};
+
+static DWORD WINAPI
+Thread_Main(LPVOID arg)
+{
+	qthread_t *thread = arg;
+
+	thread->func(thread->data);
+
+	return 0;
+}
+
+qthread_t *
+Thread_Create(void (*func)(void *data), void *data)
+{
+	qthread_t *thread;
+
+	thread = malloc(sizeof(*thread));
+
+	if (!thread)
+	{
+		return NULL;
+	}
+
+	thread->func = func;
+	thread->data = data;
+	thread->handle = CreateThread(NULL, 0, Thread_Main, thread, 0, NULL);
+
+	if (!thread->handle)
+	{
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+void
+Thread_Join(qthread_t *thread)
+{
+	if (!thread)
+	{
+		return;
+	}
+
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+	free(thread);
+}
+
+int
+Thread_NumCPUs(void)
+{
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+
+	return (info.dwNumberOfProcessors > 0) ? (int)info.dwNumberOfProcessors : 1;
+}
+
+qmutex_t *
+Mutex_Create(void)
+{
+	qmutex_t *mutex;
+
+	mutex = malloc(sizeof(*mutex));
+
+	if (!mutex)
+	{
+		return NULL;
+	}
+
+	InitializeCriticalSection(&mutex->handle);
+
+	return mutex;
+}
+
+void
+Mutex_Destroy(qmutex_t *mutex)
+{
+	if (!mutex)
+	{
+		return;
+	}
+
+	DeleteCriticalSection(&mutex->handle);
+	free(mutex);
+}
+
+void
+Mutex_Lock(qmutex_t *mutex)
+{
+	EnterCriticalSection(&mutex->handle);
+}
+
+void
+Mutex_Unlock(qmutex_t *mutex)
+{
+	LeaveCriticalSection(&mutex->handle);
+}
+
+qcond_t *
+Cond_Create(void)
+{
+	qcond_t *cond;
+
+	cond = malloc(sizeof(*cond));
+
+	if (!cond)
+	{
+		return NULL;
+	}
+
+	InitializeConditionVariable(&cond->handle);
+
+	return cond;
+}
+
+void
+Cond_Destroy(qcond_t *cond)
+{
+	/* Win32 condition variables need no cleanup. */
+	free(cond);
+}
+
+void
+Cond_Wait(qcond_t *cond, qmutex_t *mutex)
+{
+	SleepConditionVariableCS(&cond->handle, &mutex->handle, INFINITE);
+}
+
+void
+Cond_Signal(qcond_t *cond)
+{
+	WakeConditionVariable(&cond->handle);
+}
+
+void
+Cond_Broadcast(qcond_t *cond)
+{
+	WakeAllConditionVariable(&cond->handle);
+}
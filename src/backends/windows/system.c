@@ -144,6 +144,21 @@ Sys_Init(void)
 	}
 }
 
+/*
+ * Windows has no fork(), every instance
+ * needs its own process.
+ */
+int
+Sys_ForkInstances(int count)
+{
+	if (count > 1)
+	{
+		Com_Printf("Multiple instances aren't supported on Windows.\n");
+	}
+
+	return 0;
+}
+
 /* ================================================================ */
 
 char *
@@ -461,6 +476,20 @@ Sys_GetGameAPI(void *parms)
 	return GetGameAPI(parms);
 }
 
+/*
+ * Looks up an optional entry point of the loaded game.
+ */
+void *
+Sys_GetGameProc(const char *sym)
+{
+	if (!game_library)
+	{
+		return NULL;
+	}
+
+	return (void *)GetProcAddress(game_library, sym);
+}
+
 /* ======================================================================= */
 
 void
@@ -634,6 +663,21 @@ Sys_Realpath(const char *in, char *out, size_t size)
 	return true;
 }
 
+/*
+ * Not implemented, FS_LoadFile() falls back to reading
+ * the file into a newly allocated buffer.
+ */
+void *
+Sys_MapFile(FILE *f, size_t offset, size_t size, void **base, size_t *mapsize)
+{
+	return NULL;
+}
+
+void
+Sys_UnmapFile(void *base, size_t mapsize)
+{
+}
+
 /* ======================================================================= */
 
 void *
@@ -26,27 +26,159 @@
 
 #include "header/client.h"
 
-cparticle_t *active_particles, *free_particles;
-cparticle_t particles[MAX_PARTICLES];
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define CL_PARTICLES_SSE2
+#endif
+
+/*
+ * Live particles are kept as a structure of arrays, so CL_AddParticles
+ * can move and fade four at a time and drop the dead ones by compacting
+ * the arrays. The effects fill in a cparticle_t from CL_AllocParticle(),
+ * those are moved into the arrays on the next frame.
+ */
+static struct
+{
+	float time[MAX_PARTICLES];
+	float org[3][MAX_PARTICLES];
+	float vel[3][MAX_PARTICLES];
+	float accel[3][MAX_PARTICLES];
+	float alpha[MAX_PARTICLES];
+	float alphavel[MAX_PARTICLES];
+	int color[MAX_PARTICLES];
+	int count;
+} cl_parts;
+
+static cparticle_t newparticles[MAX_PARTICLES];
+static int numnewparticles;
+
 int cl_numparticles = MAX_PARTICLES;
 
 void
 CL_ClearParticles(void)
 {
-	if (cl_numparticles == 0)
-		return;
-		
-	int i;
+	cl_parts.count = 0;
+	numnewparticles = 0;
+}
+
+/*
+ * Returns a particle for the caller to fill in
+ * or NULL if there are too many already.
+ */
+cparticle_t *
+CL_AllocParticle(void)
+{
+	if (cl_parts.count + numnewparticles >= cl_numparticles)
+	{
+		return NULL;
+	}
+
+	return &newparticles[numnewparticles++];
+}
 
-	free_particles = &particles[0];
-	active_particles = NULL;
+static void
+CL_StoreNewParticles(void)
+{
+	int i, j;
 
-	for (i = 0; i < cl_numparticles; i++)
+	for (i = 0; i < numnewparticles; i++)
 	{
-		particles[i].next = &particles[i + 1];
+		const cparticle_t *p = &newparticles[i];
+		int n = cl_parts.count++;
+
+		cl_parts.time[n] = p->time;
+
+		for (j = 0; j < 3; j++)
+		{
+			cl_parts.org[j][n] = p->org[j];
+			cl_parts.vel[j][n] = p->vel[j];
+			cl_parts.accel[j][n] = p->accel[j];
+		}
+
+		cl_parts.alpha[n] = p->alpha;
+		cl_parts.alphavel[n] = p->alphavel;
+		cl_parts.color[n] = p->color;
 	}
 
-	particles[cl_numparticles - 1].next = NULL;
+	numnewparticles = 0;
+}
+
+/*
+ * Computes position and alpha of particles first to first + 3. Instant
+ * particles get a time of 0, their alpha velocity then adds nothing.
+ */
+static void
+CL_MoveParticles(int first, float now, float org[3][4], float alpha[4])
+{
+#ifdef CL_PARTICLES_SSE2
+	__m128 time, time2, instant, alphavel;
+	int j;
+
+	time = _mm_sub_ps(_mm_set1_ps(now), _mm_loadu_ps(&cl_parts.time[first]));
+	time = _mm_div_ps(time, _mm_set1_ps(1000.0f));
+
+	alphavel = _mm_loadu_ps(&cl_parts.alphavel[first]);
+	instant = _mm_cmpeq_ps(alphavel, _mm_set1_ps(INSTANT_PARTICLE));
+	time = _mm_andnot_ps(instant, time);
+	time2 = _mm_mul_ps(time, time);
+
+	_mm_storeu_ps(alpha, _mm_add_ps(_mm_loadu_ps(&cl_parts.alpha[first]),
+				_mm_mul_ps(time, alphavel)));
+
+	for (j = 0; j < 3; j++)
+	{
+		__m128 o;
+
+		o = _mm_add_ps(_mm_loadu_ps(&cl_parts.org[j][first]),
+				_mm_mul_ps(_mm_loadu_ps(&cl_parts.vel[j][first]), time));
+		o = _mm_add_ps(o, _mm_mul_ps(_mm_loadu_ps(&cl_parts.accel[j][first]), time2));
+		_mm_storeu_ps(org[j], o);
+	}
+#else
+	int i, j;
+
+	for (i = 0; i < 4; i++)
+	{
+		int n = first + i;
+		float time, time2;
+
+		time = (now - cl_parts.time[n]) / 1000.0f;
+
+		if (cl_parts.alphavel[n] == INSTANT_PARTICLE)
+		{
+			time = 0;
+		}
+
+		time2 = time * time;
+
+		alpha[i] = cl_parts.alpha[n] + time * cl_parts.alphavel[n];
+
+		for (j = 0; j < 3; j++)
+		{
+			org[j][i] = cl_parts.org[j][n] + cl_parts.vel[j][n] * time +
+				cl_parts.accel[j][n] * time2;
+		}
+	}
+#endif
+}
+
+static void
+CL_CopyParticle(int to, int from)
+{
+	int j;
+
+	cl_parts.time[to] = cl_parts.time[from];
+
+	for (j = 0; j < 3; j++)
+	{
+		cl_parts.org[j][to] = cl_parts.org[j][from];
+		cl_parts.vel[j][to] = cl_parts.vel[j][from];
+		cl_parts.accel[j][to] = cl_parts.accel[j][from];
+	}
+
+	cl_parts.alpha[to] = cl_parts.alpha[from];
+	cl_parts.alphavel[to] = cl_parts.alphavel[from];
+	cl_parts.color[to] = cl_parts.color[from];
 }
 
 void
@@ -58,16 +190,11 @@ CL_ParticleEffect(vec3_t org, vec3_t dir, int color, int count)
 
 	for (i = 0; i < count; i++)
 	{
-		if (!free_particles)
+		if (!(p = CL_AllocParticle()))
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		p->time = cl.time;
 		p->color = color + (randk() & 7);
 		d = randk() & 31;
@@ -98,16 +225,11 @@ CL_ParticleEffect2(vec3_t org, vec3_t dir, int color, int count)
 
 	for (i = 0; i < count; i++)
 	{
-		if (!free_particles)
+		if (!(p = CL_AllocParticle()))
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		p->time = time;
 		p->color = color + (randk() & 7);
 
@@ -139,16 +261,11 @@ CL_ParticleEffect3(vec3_t org, vec3_t dir, int color, int count)
 
 	for (i = 0; i < count; i++)
 	{
-		if (!free_particles)
+		if (!(p = CL_AllocParticle()))
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		p->time = time;
 		p->color = color;
 
@@ -171,74 +288,65 @@ CL_ParticleEffect3(vec3_t org, vec3_t dir, int color, int count)
 void
 CL_AddParticles(void)
 {
-	cparticle_t *p, *next;
-	float alpha;
-	float time, time2;
-	vec3_t org;
-	int color;
-	cparticle_t *active, *tail;
+	particle_t *out;
+	float now;
+	int i, live, room, added;
+
+	CL_StoreNewParticles();
 
-	active = NULL;
-	tail = NULL;
+	room = cl_parts.count;
+	out = V_BeginParticles(&room);
+	added = 0;
+	live = 0;
+	now = (float)cl.time;
 
-	for (p = active_particles; p; p = next)
+	/* the arrays are a multiple of four long, so
+	   the last block may read unused entries */
+	for (i = 0; i < cl_parts.count; i += 4)
 	{
-		next = p->next;
+		float org[3][4], alpha[4];
+		int j, n;
 
-		if (p->alphavel != INSTANT_PARTICLE)
+		CL_MoveParticles(i, now, org, alpha);
+
+		n = Q_min(4, cl_parts.count - i);
+
+		for (j = 0; j < n; j++)
 		{
-			time = (cl.time - p->time) * 0.001;
-			alpha = p->alpha + time * p->alphavel;
+			qboolean instant = (cl_parts.alphavel[i + j] == INSTANT_PARTICLE);
 
-			if (alpha <= 0)
+			if (!instant && (alpha[j] <= 0))
 			{
 				/* faded out */
-				p->next = free_particles;
-				free_particles = p;
 				continue;
 			}
-		}
-		else
-		{
-			time = 0.0f;
-			alpha = p->alpha;
-		}
-
-		p->next = NULL;
-
-		if (!tail)
-		{
-			active = tail = p;
-		}
 
-		else
-		{
-			tail->next = p;
-			tail = p;
-		}
-
-		if (alpha > 1.0f)
-		{
-			alpha = 1;
-		}
-
-		color = p->color;
-		time2 = time * time;
-
-		org[0] = p->org[0] + p->vel[0] * time + p->accel[0] * time2;
-		org[1] = p->org[1] + p->vel[1] * time + p->accel[1] * time2;
-		org[2] = p->org[2] + p->vel[2] * time + p->accel[2] * time2;
+			if (added < room)
+			{
+				out[added].origin[0] = org[0][j];
+				out[added].origin[1] = org[1][j];
+				out[added].origin[2] = org[2][j];
+				out[added].color = cl_parts.color[i + j];
+				out[added].alpha = Q_min(alpha[j], 1.0f);
+				added++;
+			}
 
-		V_AddParticle(org, color, alpha);
+			/* instant particles are drawn only once */
+			if (!instant)
+			{
+				if (live != i + j)
+				{
+					CL_CopyParticle(live, i + j);
+				}
 
-		if (p->alphavel == INSTANT_PARTICLE)
-		{
-			p->alphavel = 0.0;
-			p->alpha = 0.0;
+				live++;
+			}
 		}
 	}
 
-	active_particles = active;
+	cl_parts.count = live;
+
+	V_EndParticles(added);
 }
 
 void
@@ -254,16 +362,11 @@ CL_GenericParticleEffect(vec3_t org, vec3_t dir, int color,
 
 	for (i = 0; i < count; i++)
 	{
-		if (!free_particles)
+		if (!(p = CL_AllocParticle()))
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		p->time = time;
 
 		if (numcolors > 1)
@@ -101,6 +101,25 @@ V_AddParticle(vec3_t org, unsigned int color, float alpha)
 	p->alpha = alpha;
 }
 
+/*
+ * For adding many particles at once: returns where the next
+ * particle goes and in room how many fit, up to the given
+ * number. V_EndParticles() then adds the ones filled in.
+ */
+particle_t *
+V_BeginParticles(int *room)
+{
+	*room = Q_min(*room, MAX_PARTICLES - r_numparticles);
+
+	return &r_particles[r_numparticles];
+}
+
+void
+V_EndParticles(int count)
+{
+	r_numparticles += count;
+}
+
 void
 V_AddLight(vec3_t org, float intensity, float r, float g, float b)
 {
@@ -542,21 +542,78 @@ Mod_LoadLighting(byte **lightdata, const byte *mod_base, const lump_t *l)
 	memcpy(*lightdata, mod_base + l->fileofs, size);
 }
 
+#define MAX_PREFETCH_TEXTURES 32
+
+/*
+ * Prefetches the wall textures of the texinfos from first
+ * on that are not loaded yet, MAX_PREFETCH_TEXTURES at most.
+ * Returns the texinfo the next batch starts at.
+ */
+static int
+Mod_PrefetchTextures(const texinfo_t *in, int first, int count,
+	findimage_t find_loaded, qboolean r_retexturing)
+{
+	char names[MAX_PREFETCH_TEXTURES][MAX_QPATH];
+	const char *list[MAX_PREFETCH_TEXTURES];
+	int i, j, num = 0;
+
+	for (i = first; i < count && num < MAX_PREFETCH_TEXTURES; i++)
+	{
+		char pathname[MAX_QPATH];
+
+		Com_sprintf(pathname, sizeof(pathname), "textures/%s.wal",
+			in[i].texture);
+		Q_replacebackslash(pathname);
+
+		if (find_loaded(pathname, it_wall))
+		{
+			continue;
+		}
+
+		for (j = 0; j < num; j++)
+		{
+			if (!strcmp(names[j], pathname))
+			{
+				break;
+			}
+		}
+
+		if (j < num)
+		{
+			continue;
+		}
+
+		Q_strlcpy(names[num], pathname, sizeof(names[num]));
+		list[num] = names[num];
+		num++;
+	}
+
+	if (num)
+	{
+		R_PrefetchImages(list, num, it_wall, r_retexturing);
+	}
+
+	return i;
+}
+
 /*
 =================
 Mod_LoadTexinfo
 
 extra for skybox in soft render
+find_loaded only looks up already loaded images, the
+others are decoded in batches on the worker threads
 =================
 */
 void
 Mod_LoadTexinfo(const char *name, mtexinfo_t **texinfo, int *numtexinfo,
 	const byte *mod_base, const lump_t *l, findimage_t find_image,
+	findimage_t find_loaded, qboolean r_retexturing,
 	struct image_s *notexture, int extra)
 {
-	texinfo_t *in;
+	texinfo_t *in, *first;
 	mtexinfo_t *out, *step;
-	int 	i, count;
+	int 	i, count, batch;
 
 	in = (void *)(mod_base + l->fileofs);
 
@@ -572,11 +629,20 @@ Mod_LoadTexinfo(const char *name, mtexinfo_t **texinfo, int *numtexinfo,
 	*texinfo = out;
 	*numtexinfo = count;
 
+	first = in;
+	batch = 0;
+
 	for ( i=0 ; i<count ; i++, in++, out++)
 	{
 		struct image_s *image;
 		int j, next;
 
+		if (i == batch)
+		{
+			batch = Mod_PrefetchTextures(first, i, count,
+				find_loaded, r_retexturing);
+		}
+
 		for (j = 0; j < 4; j++)
 		{
 			out->vecs[0][j] = LittleFloat(in->vecs[0][j]);
@@ -610,6 +676,8 @@ Mod_LoadTexinfo(const char *name, mtexinfo_t **texinfo, int *numtexinfo,
 		out->image = image;
 	}
 
+	R_FreePrefetchedImages();
+
 	// count animation frames
 	for (i=0 ; i<count ; i++)
 	{
@@ -168,9 +168,14 @@ PCX_RLE_Decode(byte *pix, byte *pix_max, const byte *raw, const byte *raw_max,
 	return raw;
 }
 
+/*
+ * Without verbose nothing is printed and the picture is
+ * dropped if there would have been a warning, so it can
+ * run on the worker threads.
+ */
 static void
 PCX_Decode(const char *name, const byte *raw, int len, byte **pic, byte **palette,
-	int *width, int *height, int *bitsPerPixel)
+	int *width, int *height, int *bitsPerPixel, qboolean verbose)
 {
 	const pcx_t *pcx;
 	int full_size;
@@ -210,8 +215,11 @@ PCX_Decode(const char *name, const byte *raw, int len, byte **pic, byte **palett
 		(pcx->color_planes <= 0) ||
 		(pcx->bits_per_pixel <= 0))
 	{
-		Com_Printf("%s: Bad pcx file %s: version: %d:%d, encoding: %d\n",
-			__func__, name, pcx->manufacturer, pcx->version, pcx->encoding);
+		if (verbose)
+		{
+			Com_Printf("%s: Bad pcx file %s: version: %d:%d, encoding: %d\n",
+				__func__, name, pcx->manufacturer, pcx->version, pcx->encoding);
+		}
 		return;
 	}
 
@@ -226,7 +234,10 @@ PCX_Decode(const char *name, const byte *raw, int len, byte **pic, byte **palett
 	out = malloc(full_size);
 	if (!out)
 	{
-		Com_Printf("%s: Can't allocate for %s\n", __func__, name);
+		if (verbose)
+		{
+			Com_Printf("%s: Can't allocate for %s\n", __func__, name);
+		}
 		return;
 	}
 
@@ -290,8 +301,12 @@ PCX_Decode(const char *name, const byte *raw, int len, byte **pic, byte **palett
 
 			if (!(*palette))
 			{
-				Com_Printf("%s: Can't allocate for %s\n", __func__, name);
+				if (verbose)
+				{
+					Com_Printf("%s: Can't allocate for %s\n", __func__, name);
+				}
 				free(out);
+				*pic = NULL;
 				return;
 			}
 
@@ -335,8 +350,12 @@ PCX_Decode(const char *name, const byte *raw, int len, byte **pic, byte **palett
 
 			if (!(*palette))
 			{
-				Com_Printf("%s: Can't allocate for %s\n", __func__, name);
+				if (verbose)
+				{
+					Com_Printf("%s: Can't allocate for %s\n", __func__, name);
+				}
 				free(out);
+				*pic = NULL;
 				return;
 			}
 
@@ -346,8 +365,15 @@ PCX_Decode(const char *name, const byte *raw, int len, byte **pic, byte **palett
 
 				if ((((byte *)pcx)[len - 769] != 0x0C))
 				{
-					Com_DPrintf("%s: %s has no palette marker\n",
-						__func__, name);
+					if (verbose)
+					{
+						Com_DPrintf("%s: %s has no palette marker\n",
+							__func__, name);
+					}
+					else
+					{
+						image_issues = true;
+					}
 				}
 			}
 			else
@@ -386,8 +412,12 @@ PCX_Decode(const char *name, const byte *raw, int len, byte **pic, byte **palett
 
 			if (!(*palette))
 			{
-				Com_Printf("%s: Can't allocate for %s\n", __func__, name);
+				if (verbose)
+				{
+					Com_Printf("%s: Can't allocate for %s\n", __func__, name);
+				}
 				free(out);
+				*pic = NULL;
 				return;
 			}
 
@@ -427,31 +457,74 @@ PCX_Decode(const char *name, const byte *raw, int len, byte **pic, byte **palett
 	}
 	else
 	{
-		Com_Printf("%s: Bad pcx file %s: planes: %d, bits: %d\n",
-			__func__, name, pcx->color_planes, pcx->bits_per_pixel);
+		if (verbose)
+		{
+			Com_Printf("%s: Bad pcx file %s: planes: %d, bits: %d\n",
+				__func__, name, pcx->color_planes, pcx->bits_per_pixel);
+		}
 		free(*pic);
 		*pic = NULL;
 	}
 
 	if (pcx->color_planes != 1 || pcx->bits_per_pixel != 8)
 	{
-		Com_DPrintf("%s: %s has uncommon flags, "
-			"could be unsupported by other engines\n",
-			__func__, name);
+		if (verbose)
+		{
+			Com_DPrintf("%s: %s has uncommon flags, "
+				"could be unsupported by other engines\n",
+				__func__, name);
+		}
+		else
+		{
+			image_issues = true;
+		}
 	}
 
 	if (data - (byte *)pcx > len)
 	{
-		Com_DPrintf("%s: %s file was malformed\n",
-			__func__, name);
+		if (verbose)
+		{
+			Com_DPrintf("%s: %s file was malformed\n",
+				__func__, name);
+		}
 		free(*pic);
 		*pic = NULL;
 	}
 
 	if (image_issues)
 	{
-		Com_Printf("%s: %s file has possible size issues.\n",
-			__func__, name);
+		if (verbose)
+		{
+			Com_Printf("%s: %s file has possible size issues.\n",
+				__func__, name);
+		}
+		else
+		{
+			free(*pic);
+			*pic = NULL;
+		}
+	}
+}
+
+/*
+ * Decodes the PCX file filename, already read into raw.
+ * *pic is NULL if that failed. See PCX_Decode() for verbose.
+ */
+void
+DecodePCX(const char *filename, const byte *raw, int len, byte **pic, byte **palette,
+	int *width, int *height, int *bitsPerPixel, qboolean verbose)
+{
+	PCX_Decode(filename, raw, len, pic, palette, width, height, bitsPerPixel,
+		verbose);
+
+	if(*pic && *bitsPerPixel == 8 && width && height
+		&& *width == 320 && *height == 240
+		&& Q_strcasecmp(filename, "pics/quit.pcx") == 0
+		&& Com_BlockChecksum(raw, len) == 3329419434u)
+	{
+		// it's the quit screen, and the baseq2 one (identified by checksum)
+		// so fix it
+		fixQuitScreen(*pic);
 	}
 }
 
@@ -480,45 +553,24 @@ LoadPCX(const char *origname, byte **pic, byte **palette, int *width, int *heigh
 		return;
 	}
 
-	PCX_Decode(filename, raw, len, pic, palette, width, height, bitsPerPixel);
-
-	if(*pic && *bitsPerPixel == 8 && width && height
-		&& *width == 320 && *height == 240
-		&& Q_strcasecmp(filename, "pics/quit.pcx") == 0
-		&& Com_BlockChecksum(raw, len) == 3329419434u)
-	{
-		// it's the quit screen, and the baseq2 one (identified by checksum)
-		// so fix it
-		fixQuitScreen(*pic);
-	}
+	DecodePCX(filename, raw, len, pic, palette, width, height, bitsPerPixel,
+		true);
 
 	ri.FS_FreeFile(raw);
 }
 
 void
-GetPCXInfo(const char *origname, int *width, int *height)
+GetPCXInfo(const byte *raw, int len, int *width, int *height)
 {
-	pcx_t *pcx;
-	byte *raw;
-	char filename[256];
-
-	FixFileExt(origname, "pcx", filename, sizeof(filename));
-
-	ri.FS_LoadFile(filename, (void **)&raw);
+	const pcx_t *pcx = (const pcx_t *)raw;
 
-	if (!raw)
+	if (len < sizeof(pcx_t))
 	{
 		return;
 	}
 
-	pcx = (pcx_t *)raw;
-
 	*width = pcx->xmax + 1;
 	*height = pcx->ymax + 1;
-
-	ri.FS_FreeFile(raw);
-
-	return;
 }
 
 /*
@@ -63,6 +63,31 @@ FixFileExt(const char *origname, const char *ext, char *filename, size_t size)
 	}
 }
 
+/*
+ * Decodes a tga, png or jpg file already in memory
+ * into RGBA pixels. Prints nothing, so it may run on
+ * the worker threads.
+ */
+static qboolean
+DecodeSTB(const byte *rawdata, int rawsize, byte **pic, int *width, int *height)
+{
+	int w, h, bytesPerPixel;
+	byte* data = NULL;
+
+	*pic = NULL;
+
+	data = stbi_load_from_memory(rawdata, rawsize, &w, &h, &bytesPerPixel, STBI_rgb_alpha);
+	if (data == NULL)
+	{
+		return false;
+	}
+
+	*pic = data;
+	*width = w;
+	*height = h;
+	return true;
+}
+
 /*
  * origname: the filename to be opened, might be without extension
  * type: extension of the type we wanna open ("jpg", "png" or "tga")
@@ -84,10 +109,7 @@ LoadSTB(const char *origname, const char* type, byte **pic, int *width, int *hei
 		return false;
 	}
 
-	int w, h, bytesPerPixel;
-	byte* data = NULL;
-	data = stbi_load_from_memory(rawdata, rawsize, &w, &h, &bytesPerPixel, STBI_rgb_alpha);
-	if (data == NULL)
+	if (!DecodeSTB(rawdata, rawsize, pic, width, height))
 	{
 		Com_Printf("%s couldn't load data from %s: %s!\n", __func__, filename, stbi_failure_reason());
 		ri.FS_FreeFile(rawdata);
@@ -98,9 +120,6 @@ LoadSTB(const char *origname, const char* type, byte **pic, int *width, int *hei
 
 	Com_DPrintf("%s() loaded: %s\n", __func__, filename);
 
-	*pic = data;
-	*width = w;
-	*height = h;
 	return true;
 }
 
@@ -446,31 +465,52 @@ scale3x(const byte *src, byte *dst, int width, int height)
 	}
 }
 
-static struct image_s *
-LoadHiColorImage(const char *name, const char* namewe, const char *ext,
-	imagetype_t type, loadimage_t load_image)
+/*
+ * Size of the original texture, for scaling its replacement
+ */
+static void
+GetImageInfo(const char *ext, const byte *raw, int size, int *width, int *height)
 {
-	int realwidth = 0, realheight = 0;
-	int width = 0, height = 0;
-	struct image_s	*image = NULL;
-	byte *pic = NULL;
-
-	/* Get size of the original texture */
 	if (strcmp(ext, "pcx") == 0)
 	{
-		GetPCXInfo(name, &realwidth, &realheight);
+		GetPCXInfo(raw, size, width, height);
 	}
 	else if (strcmp(ext, "wal") == 0)
 	{
-		GetWalInfo(name, &realwidth, &realheight);
+		GetWalInfo(raw, size, width, height);
 	}
 	else if (strcmp(ext, "m8") == 0)
 	{
-		GetM8Info(name, &realwidth, &realheight);
+		GetM8Info(raw, size, width, height);
 	}
 	else if (strcmp(ext, "m32") == 0)
 	{
-		GetM32Info(name, &realwidth, &realheight);
+		GetM32Info(raw, size, width, height);
+	}
+}
+
+static struct image_s *
+LoadHiColorImage(const char *name, const char* namewe, const char *ext,
+	imagetype_t type, loadimage_t load_image)
+{
+	int realwidth = 0, realheight = 0;
+	int width = 0, height = 0;
+	struct image_s	*image = NULL;
+	byte *pic = NULL;
+
+	/* Get size of the original texture */
+	if (!strcmp(ext, "pcx") || !strcmp(ext, "wal") ||
+		!strcmp(ext, "m8") || !strcmp(ext, "m32"))
+	{
+		byte *raw;
+		int size;
+
+		size = ri.FS_LoadFile(name, (void **)&raw);
+		if (raw)
+		{
+			GetImageInfo(ext, raw, size, &realwidth, &realheight);
+			ri.FS_FreeFile(raw);
+		}
 	}
 
 	/* try to load a tga, png or jpg (in that order/priority) */
@@ -502,12 +542,363 @@ LoadHiColorImage(const char *name, const char* namewe, const char *ext,
 	return image;
 }
 
+/*
+ * Images are prefetched in batches: the files are read on
+ * the main thread, decoded on the worker threads and then
+ * only uploaded by R_LoadImage(). Anything going wrong on
+ * a worker just makes R_LoadImage() fall back to loading
+ * the image the usual way, which prints why it failed.
+ */
+typedef struct
+{
+	char name[MAX_QPATH];
+	char namewe[MAX_QPATH];
+	char ext[8];
+	imagetype_t type;
+	qboolean retexturing;
+
+	/* files read on the main thread */
+	char hiname[MAX_QPATH];
+	byte *hifile;
+	int hisize;
+	byte *file;
+	int size;
+
+	/* filled in by the workers */
+	qboolean decoded;
+	byte *pic;
+	qboolean freepic;
+	int width, realwidth;
+	int height, realheight;
+	size_t datasize;
+	int bits;
+} loadingimage_t;
+
+#define MAX_PREFETCH_IMAGES 64
+
+static loadingimage_t *prefetched[MAX_PREFETCH_IMAGES];
+static int numprefetched;
+
+static void
+R_FreeLoadingImage(loadingimage_t *li)
+{
+	if (li->freepic && li->pic)
+	{
+		free(li->pic);
+	}
+
+	if (li->hifile)
+	{
+		ri.FS_FreeFile(li->hifile);
+	}
+
+	if (li->file)
+	{
+		ri.FS_FreeFile(li->file);
+	}
+
+	free(li);
+}
+
+void
+R_FreePrefetchedImages(void)
+{
+	int i;
+
+	for (i = 0; i < numprefetched; i++)
+	{
+		if (prefetched[i])
+		{
+			R_FreeLoadingImage(prefetched[i]);
+			prefetched[i] = NULL;
+		}
+	}
+
+	numprefetched = 0;
+}
+
+static void
+R_ReadImage(loadingimage_t *li)
+{
+	static const char *hiexts[] = {"tga", "png", "jpg"};
+	char filename[256];
+	int i;
+
+	if (li->retexturing)
+	{
+		for (i = 0; i < sizeof(hiexts) / sizeof(*hiexts); i++)
+		{
+			FixFileExt(li->namewe, hiexts[i], li->hiname, sizeof(li->hiname));
+
+			li->hisize = ri.FS_LoadFile(li->hiname, (void **)&li->hifile);
+			if (li->hifile)
+			{
+				break;
+			}
+		}
+	}
+
+	if (li->hifile && (!strcmp(li->ext, "tga") ||
+		!strcmp(li->ext, "png") || !strcmp(li->ext, "jpg")))
+	{
+		/* the replacement is the original */
+		return;
+	}
+
+	FixFileExt(li->namewe, li->ext, filename, sizeof(filename));
+	li->size = ri.FS_LoadFile(filename, (void **)&li->file);
+}
+
+/*
+ * Same decision and arguments to load_image as
+ * R_LoadImage() would take, without touching
+ * anything but li.
+ */
+static qboolean
+R_DecodeImage(loadingimage_t *li)
+{
+	const char *ext = li->ext;
+
+	if (li->hifile)
+	{
+		int width, height;
+		byte *pic;
+
+		if (li->file)
+		{
+			GetImageInfo(ext, li->file, li->size,
+				&li->realwidth, &li->realheight);
+		}
+
+		if (!DecodeSTB(li->hifile, li->hisize, &pic, &width, &height))
+		{
+			return false;
+		}
+
+		if (width >= li->realwidth && height >= li->realheight)
+		{
+			if (li->realheight == 0 || li->realwidth == 0)
+			{
+				li->realheight = height;
+				li->realwidth = width;
+			}
+
+			li->pic = pic;
+			li->freepic = true;
+			li->width = width;
+			li->height = height;
+			li->datasize = width * height;
+			li->bits = 32;
+			return true;
+		}
+
+		free(pic);
+		li->realwidth = 0;
+		li->realheight = 0;
+	}
+
+	if (!li->file)
+	{
+		return false;
+	}
+
+	if (!strcmp(ext, "pcx"))
+	{
+		byte *palette = NULL;
+		char filename[256];
+
+		FixFileExt(li->namewe, "pcx", filename, sizeof(filename));
+
+		li->bits = 8;
+		DecodePCX(filename, li->file, li->size, &li->pic, &palette,
+			&li->width, &li->height, &li->bits, false);
+
+		if (palette)
+		{
+			free(palette);
+		}
+
+		if (!li->pic)
+		{
+			return false;
+		}
+
+		li->freepic = true;
+		li->realwidth = li->width;
+		li->realheight = li->height;
+		li->datasize = li->width * li->height;
+		return true;
+	}
+	else if (!strcmp(ext, "wal"))
+	{
+		li->bits = 8;
+		return !DecodeWal(li->file, li->size, &li->pic,
+			&li->width, &li->height, &li->datasize);
+	}
+	else if (!strcmp(ext, "m8"))
+	{
+		li->bits = 32;
+		li->freepic = true;
+		return !DecodeM8(li->file, li->size, &li->pic,
+			&li->width, &li->height, &li->datasize);
+	}
+	else if (!strcmp(ext, "m32"))
+	{
+		li->bits = 32;
+		return !DecodeM32(li->file, li->size, &li->pic,
+			&li->width, &li->height, &li->datasize);
+	}
+	else if (!strcmp(ext, "tga") ||
+	         !strcmp(ext, "png") ||
+	         !strcmp(ext, "jpg"))
+	{
+		if (!DecodeSTB(li->file, li->size, &li->pic,
+			&li->width, &li->height))
+		{
+			return false;
+		}
+
+		li->freepic = true;
+		li->realwidth = li->width;
+		li->realheight = li->height;
+		li->datasize = li->width * li->height;
+		li->bits = 32;
+		return true;
+	}
+
+	return false;
+}
+
+static void
+R_DecodeImageJob(void *data, int index)
+{
+	loadingimage_t *li = ((loadingimage_t **)data)[index];
+
+	li->decoded = R_DecodeImage(li);
+}
+
+/*
+ * Reads the given images and decodes them on the worker
+ * threads, to be picked up by R_LoadImage(). Names must
+ * be given like R_LoadImage() gets them. Does nothing
+ * without workers, the images are then loaded one by one.
+ */
+void
+R_PrefetchImages(const char **names, int count, imagetype_t type,
+	qboolean r_retexturing)
+{
+	int i;
+
+	R_FreePrefetchedImages();
+
+	if (!ri.Jobs_NumWorkers())
+	{
+		return;
+	}
+
+	if (count > MAX_PREFETCH_IMAGES)
+	{
+		count = MAX_PREFETCH_IMAGES;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		loadingimage_t *li;
+		const char *ext;
+		size_t len;
+
+		ext = COM_FileExtension(names[i]);
+		len = (ext - names[i]) - 1;
+
+		if (!ext[0] || (len < 1) || (len > sizeof(li->namewe) - 1) ||
+			(strlen(ext) > sizeof(li->ext) - 1))
+		{
+			continue;
+		}
+
+		li = calloc(1, sizeof(*li));
+		if (!li)
+		{
+			break;
+		}
+
+		Q_strlcpy(li->name, names[i], sizeof(li->name));
+		memcpy(li->namewe, names[i], len);
+		li->namewe[len] = 0;
+		Q_strlcpy(li->ext, ext, sizeof(li->ext));
+		li->type = type;
+		li->retexturing = r_retexturing;
+
+		R_ReadImage(li);
+
+		if (!li->hifile && !li->file)
+		{
+			R_FreeLoadingImage(li);
+			continue;
+		}
+
+		prefetched[numprefetched++] = li;
+	}
+
+	if (numprefetched)
+	{
+		ri.Jobs_Run(R_DecodeImageJob, prefetched, numprefetched);
+	}
+}
+
+/*
+ * Uploads the image if it was prefetched and decoded
+ */
+static struct image_s *
+R_LoadPrefetchedImage(const char *name, imagetype_t type,
+	qboolean r_retexturing, loadimage_t load_image)
+{
+	struct image_s	*image = NULL;
+	int i;
+
+	for (i = 0; i < numprefetched; i++)
+	{
+		loadingimage_t *li = prefetched[i];
+
+		if (!li || strcmp(li->name, name))
+		{
+			continue;
+		}
+
+		if (li->decoded && li->type == type &&
+			li->retexturing == r_retexturing)
+		{
+			if (li->hifile)
+			{
+				Com_DPrintf("%s() loaded: %s\n", __func__, li->hiname);
+			}
+
+			image = load_image(name, li->pic,
+				li->width, li->realwidth,
+				li->height, li->realheight,
+				li->datasize, type, li->bits);
+		}
+
+		R_FreeLoadingImage(li);
+		prefetched[i] = NULL;
+		break;
+	}
+
+	return image;
+}
+
 struct image_s *
 R_LoadImage(const char *name, const char* namewe, const char *ext, imagetype_t type,
 	qboolean r_retexturing, loadimage_t load_image)
 {
 	struct image_s	*image = NULL;
 
+	image = R_LoadPrefetchedImage(name, type, r_retexturing, load_image);
+	if (image)
+	{
+		return image;
+	}
+
 	// with retexturing and not skin
 	if (r_retexturing)
 	{
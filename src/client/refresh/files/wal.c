@@ -26,255 +26,286 @@
 
 #include "../ref_shared.h"
 
-struct image_s *
-LoadWal(const char *origname, imagetype_t type, loadimage_t load_image)
+/*
+ * Finds the pixels of a wal texture in the file. Returns
+ * NULL on success, otherwise why the file can't be loaded.
+ * Touches nothing else, so it may run on the worker threads.
+ */
+const char *
+DecodeWal(byte *raw, int size, byte **pic, int *width, int *height,
+	size_t *datasize)
 {
-	int	width, height, ofs, size;
-	struct image_s	*image;
-	char	name[256];
-	miptex_t	*mt;
-
-	FixFileExt(origname, "wal", name, sizeof(name));
-
-	size = ri.FS_LoadFile(name, (void **)&mt);
-
-	if (!mt)
-	{
-		return NULL;
-	}
+	miptex_t *mt;
+	int ofs;
 
 	if (size < sizeof(miptex_t))
 	{
-		Com_Printf("%s: can't load %s, small header\n", __func__, name);
-		ri.FS_FreeFile((void *)mt);
-		return NULL;
+		return "small header";
 	}
 
-	width = LittleLong(mt->width);
-	height = LittleLong(mt->height);
+	mt = (miptex_t *)raw;
+
+	*width = LittleLong(mt->width);
+	*height = LittleLong(mt->height);
 	ofs = LittleLong(mt->offsets[0]);
 
-	if ((ofs <= 0) || (width <= 0) || (height <= 0) ||
-	    (((size - ofs) / height) < width))
+	if ((ofs <= 0) || (*width <= 0) || (*height <= 0) ||
+	    (((size - ofs) / *height) < *width))
 	{
-		Com_Printf("%s: can't load %s, small body\n", __func__, name);
-		ri.FS_FreeFile((void *)mt);
-		return NULL;
+		return "small body";
 	}
 
-	image = load_image(name, (byte *)mt + ofs,
-		width, 0,
-		height, 0,
-		(size - ofs), type, 8);
+	*pic = raw + ofs;
+	*datasize = size - ofs;
 
-	ri.FS_FreeFile((void *)mt);
-
-	return image;
+	return NULL;
 }
 
-struct image_s *
-LoadM8(const char *origname, imagetype_t type, loadimage_t load_image)
+/*
+ * Like DecodeWal(), but the 8 bit pixels are converted
+ * to 32 bit into a newly allocated buffer.
+ */
+const char *
+DecodeM8(byte *raw, int size, byte **pic, int *width, int *height,
+	size_t *datasize)
 {
+	unsigned char *image_buffer;
 	m8tex_t *mt;
-	int width, height, ofs, size, i;
-	struct image_s *image;
-	char name[256];
-	unsigned char *image_buffer = NULL;
-
-	FixFileExt(origname, "m8", name, sizeof(name));
-
-	size = ri.FS_LoadFile(name, (void **)&mt);
-
-	if (!mt)
-	{
-		return NULL;
-	}
+	int ofs, i;
 
 	if (size < sizeof(m8tex_t))
 	{
-		Com_Printf("%s: can't load %s, small header\n", __func__, name);
-		ri.FS_FreeFile((void *)mt);
-		return NULL;
+		return "small header";
 	}
 
+	mt = (m8tex_t *)raw;
+
 	if (LittleLong (mt->version) != M8_VERSION)
 	{
-		Com_Printf("%s: can't load %s, wrong magic value.\n", __func__, name);
-		ri.FS_FreeFile ((void *)mt);
-		return NULL;
+		return "wrong magic value.";
 	}
 
-	width = LittleLong(mt->width[0]);
-	height = LittleLong(mt->height[0]);
+	*width = LittleLong(mt->width[0]);
+	*height = LittleLong(mt->height[0]);
 	ofs = LittleLong(mt->offsets[0]);
 
-	if ((ofs <= 0) || (width <= 0) || (height <= 0) ||
-	    (((size - ofs) / height) < width))
+	if ((ofs <= 0) || (*width <= 0) || (*height <= 0) ||
+	    (((size - ofs) / *height) < *width))
 	{
-		Com_Printf("%s: can't load %s, small body\n", __func__, name);
-		ri.FS_FreeFile((void *)mt);
-		return NULL;
+		return "small body";
 	}
 
 	image_buffer = malloc ((size - ofs) * 4);
 	for(i=0; i<(size - ofs); i++)
 	{
-		unsigned char value = *((byte *)mt + ofs + i);
+		unsigned char value = *(raw + ofs + i);
 		image_buffer[i * 4 + 0] = mt->palette[value].r;
 		image_buffer[i * 4 + 1] = mt->palette[value].g;
 		image_buffer[i * 4 + 2] = mt->palette[value].b;
 		image_buffer[i * 4 + 3] = value == 255 ? 0 : 255;
 	}
 
-	image = load_image(name, image_buffer,
-		width, 0,
-		height, 0,
-		(size - ofs), type, 32);
-	free(image_buffer);
+	*pic = image_buffer;
+	*datasize = size - ofs;
 
-	ri.FS_FreeFile((void *)mt);
+	return NULL;
+}
 
-	return image;
+/*
+ * Like DecodeWal(), for 32 bit m32 textures.
+ */
+const char *
+DecodeM32(byte *raw, int size, byte **pic, int *width, int *height,
+	size_t *datasize)
+{
+	m32tex_t *mt;
+	int ofs;
+
+	if (size < sizeof(m32tex_t))
+	{
+		return "small header";
+	}
+
+	mt = (m32tex_t *)raw;
+
+	if (LittleLong (mt->version) != M32_VERSION)
+	{
+		return "wrong magic value.";
+	}
+
+	*width = LittleLong (mt->width[0]);
+	*height = LittleLong (mt->height[0]);
+	ofs = LittleLong (mt->offsets[0]);
+
+	if ((ofs <= 0) || (*width <= 0) || (*height <= 0) ||
+	    (((size - ofs) / *height) < (*width * 4)))
+	{
+		return "small body";
+	}
+
+	*pic = raw + ofs;
+	*datasize = (size - ofs) / 4;
+
+	return NULL;
 }
 
 struct image_s *
-LoadM32(const char *origname, imagetype_t type, loadimage_t load_image)
+LoadWal(const char *origname, imagetype_t type, loadimage_t load_image)
 {
-	m32tex_t	*mt;
-	int		width, height, ofs, size;
+	int	width, height, size;
 	struct image_s	*image;
-	char name[256];
+	char	name[256];
+	const char *error;
+	size_t	datasize;
+	byte	*raw, *pic;
 
-	FixFileExt(origname, "m32", name, sizeof(name));
+	FixFileExt(origname, "wal", name, sizeof(name));
 
-	size = ri.FS_LoadFile(name, (void **)&mt);
+	size = ri.FS_LoadFile(name, (void **)&raw);
 
-	if (!mt)
+	if (!raw)
 	{
 		return NULL;
 	}
 
-	if (size < sizeof(m32tex_t))
+	error = DecodeWal(raw, size, &pic, &width, &height, &datasize);
+
+	if (error)
 	{
-		Com_Printf("%s: can't load %s, small header\n", __func__, name);
-		ri.FS_FreeFile((void *)mt);
+		Com_Printf("%s: can't load %s, %s\n", __func__, name, error);
+		ri.FS_FreeFile((void *)raw);
 		return NULL;
 	}
 
-	if (LittleLong (mt->version) != M32_VERSION)
+	image = load_image(name, pic,
+		width, 0,
+		height, 0,
+		datasize, type, 8);
+
+	ri.FS_FreeFile((void *)raw);
+
+	return image;
+}
+
+struct image_s *
+LoadM8(const char *origname, imagetype_t type, loadimage_t load_image)
+{
+	int width, height, size;
+	struct image_s *image;
+	char name[256];
+	const char *error;
+	size_t datasize;
+	byte *raw, *image_buffer;
+
+	FixFileExt(origname, "m8", name, sizeof(name));
+
+	size = ri.FS_LoadFile(name, (void **)&raw);
+
+	if (!raw)
 	{
-		Com_Printf("%s: can't load %s, wrong magic value.\n", __func__, name);
-		ri.FS_FreeFile ((void *)mt);
 		return NULL;
 	}
 
-	width = LittleLong (mt->width[0]);
-	height = LittleLong (mt->height[0]);
-	ofs = LittleLong (mt->offsets[0]);
+	error = DecodeM8(raw, size, &image_buffer, &width, &height, &datasize);
 
-	if ((ofs <= 0) || (width <= 0) || (height <= 0) ||
-	    (((size - ofs) / height) < (width * 4)))
+	if (error)
 	{
-		Com_Printf("%s: can't load %s, small body\n", __func__, name);
-		ri.FS_FreeFile((void *)mt);
+		Com_Printf("%s: can't load %s, %s\n", __func__, name, error);
+		ri.FS_FreeFile((void *)raw);
 		return NULL;
 	}
 
-	image = load_image(name, (byte *)mt + ofs,
+	image = load_image(name, image_buffer,
 		width, 0,
 		height, 0,
-		(size - ofs) / 4, type, 32);
-	ri.FS_FreeFile ((void *)mt);
+		datasize, type, 32);
+	free(image_buffer);
+
+	ri.FS_FreeFile((void *)raw);
 
 	return image;
 }
 
-void
-GetWalInfo(const char *origname, int *width, int *height)
+struct image_s *
+LoadM32(const char *origname, imagetype_t type, loadimage_t load_image)
 {
-	miptex_t *mt;
-	int size;
-	char filename[256];
+	int		width, height, size;
+	struct image_s	*image;
+	char name[256];
+	const char *error;
+	size_t	datasize;
+	byte	*raw, *pic;
 
-	FixFileExt(origname, "wal", filename, sizeof(filename));
+	FixFileExt(origname, "m32", name, sizeof(name));
 
-	size = ri.FS_LoadFile(filename, (void **)&mt);
+	size = ri.FS_LoadFile(name, (void **)&raw);
 
-	if (!mt)
+	if (!raw)
 	{
-		return;
+		return NULL;
 	}
 
-	if (size < sizeof(miptex_t))
+	error = DecodeM32(raw, size, &pic, &width, &height, &datasize);
+
+	if (error)
 	{
-		ri.FS_FreeFile((void *)mt);
-		return;
+		Com_Printf("%s: can't load %s, %s\n", __func__, name, error);
+		ri.FS_FreeFile((void *)raw);
+		return NULL;
 	}
 
-	*width = LittleLong(mt->width);
-	*height = LittleLong(mt->height);
-
-	ri.FS_FreeFile((void *)mt);
+	image = load_image(name, pic,
+		width, 0,
+		height, 0,
+		datasize, type, 32);
+	ri.FS_FreeFile ((void *)raw);
 
-	return;
+	return image;
 }
 
+/*
+ * The GetXInfo() functions read the size of a texture
+ * from its file, they leave width and height alone if
+ * it's broken.
+ */
 void
-GetM8Info(const char *origname, int *width, int *height)
+GetWalInfo(const byte *raw, int size, int *width, int *height)
 {
-	m8tex_t *mt;
-	int size;
-	char filename[256];
+	const miptex_t *mt = (const miptex_t *)raw;
 
-	FixFileExt(origname, "m8", filename, sizeof(filename));
-
-	size = ri.FS_LoadFile(filename, (void **)&mt);
-
-	if (!mt)
+	if (size < sizeof(miptex_t))
 	{
 		return;
 	}
 
+	*width = LittleLong(mt->width);
+	*height = LittleLong(mt->height);
+}
+
+void
+GetM8Info(const byte *raw, int size, int *width, int *height)
+{
+	const m8tex_t *mt = (const m8tex_t *)raw;
+
 	if (size < sizeof(m8tex_t) || LittleLong (mt->version) != M8_VERSION)
 	{
-		ri.FS_FreeFile((void *)mt);
 		return;
 	}
 
 	*width = LittleLong(mt->width[0]);
 	*height = LittleLong(mt->height[0]);
-
-	ri.FS_FreeFile((void *)mt);
-
-	return;
 }
 
 void
-GetM32Info(const char *origname, int *width, int *height)
+GetM32Info(const byte *raw, int size, int *width, int *height)
 {
-	m32tex_t *mt;
-	int size;
-	char filename[256];
-
-	FixFileExt(origname, "m32", filename, sizeof(filename));
-
-	size = ri.FS_LoadFile(filename, (void **)&mt);
-
-	if (!mt)
-	{
-		return;
-	}
+	const m32tex_t *mt = (const m32tex_t *)raw;
 
 	if (size < sizeof(m32tex_t) || LittleLong (mt->version) != M32_VERSION)
 	{
-		ri.FS_FreeFile((void *)mt);
 		return;
 	}
 
 	*width = LittleLong(mt->width[0]);
 	*height = LittleLong(mt->height[0]);
-
-	ri.FS_FreeFile((void *)mt);
-
-	return;
 }
@@ -1086,6 +1086,27 @@ R_LoadPic(const char *name, byte *pic, int width, int realwidth,
 	return image;
 }
 
+/*
+ * Finds the given image if it's already loaded, name
+ * must have its backslashes fixed
+ */
+image_t *
+R_FindLoadedImage(const char *name, imagetype_t type)
+{
+	image_t *image;
+	int i;
+
+	for (i = 0, image = gltextures; i < numgltextures; i++, image++)
+	{
+		if (!strcmp(name, image->name))
+		{
+			return image;
+		}
+	}
+
+	return NULL;
+}
+
 /*
  * Finds or loads the given image or null
  */
@@ -1096,7 +1117,6 @@ R_FindImage(const char *originname, imagetype_t type)
 	const char* ext;
 	image_t *image;
 	size_t len;
-	int i;
 
 	if (!originname)
 	{
@@ -1127,13 +1147,11 @@ R_FindImage(const char *originname, imagetype_t type)
 	namewe[len] = 0;
 
 	/* look for it */
-	for (i = 0, image = gltextures; i < numgltextures; i++, image++)
+	image = R_FindLoadedImage(name, type);
+	if (image)
 	{
-		if (!strcmp(name, image->name))
-		{
-			image->registration_sequence = registration_sequence;
-			return image;
-		}
+		image->registration_sequence = registration_sequence;
+		return image;
 	}
 
 	/*
@@ -298,6 +298,7 @@ void R_MarkSurfaceLights(dlight_t *light, int bit, mnode_t *node,
 image_t *R_LoadPic(const char *name, byte *pic, int width, int realwidth,
 		int height, int realheight, size_t data_size, imagetype_t type, int bits);
 image_t *R_FindImage(const char *name, imagetype_t type);
+image_t *R_FindLoadedImage(const char *name, imagetype_t type);
 void R_TextureMode(const char *string);
 void R_ImageList_f(void);
 
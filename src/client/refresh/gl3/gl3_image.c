@@ -580,6 +580,27 @@ GL3_LoadPic(char *name, byte *pic, int width, int realwidth,
 	return image;
 }
 
+/*
+ * Finds the given image if it's already loaded, name
+ * must have its backslashes fixed
+ */
+gl3image_t *
+GL3_FindLoadedImage(const char *name, imagetype_t type)
+{
+	gl3image_t *image;
+	int i;
+
+	for (i = 0, image = gl3textures; i < numgl3textures; i++, image++)
+	{
+		if (!strcmp(name, image->name))
+		{
+			return image;
+		}
+	}
+
+	return NULL;
+}
+
 /*
  * Finds or loads the given image or NULL
  */
@@ -590,7 +611,6 @@ GL3_FindImage(const char *originname, imagetype_t type)
 	gl3image_t *image;
 	const char* ext;
 	size_t len;
-	int i;
 
 	if (!originname)
 	{
@@ -621,13 +641,11 @@ GL3_FindImage(const char *originname, imagetype_t type)
 	namewe[len] = 0;
 
 	/* look for it */
-	for (i = 0, image = gl3textures; i < numgl3textures; i++, image++)
+	image = GL3_FindLoadedImage(name, type);
+	if (image)
 	{
-		if (!strcmp(name, image->name))
-		{
-			image->registration_sequence = registration_sequence;
-			return image;
-		}
+		image->registration_sequence = registration_sequence;
+		return image;
 	}
 
 	//
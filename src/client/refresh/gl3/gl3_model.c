@@ -576,6 +576,7 @@ Mod_LoadBrushModel(gl3model_t *mod, void *buffer, int modfilelen)
 		mod_base, &header->lumps[LUMP_PLANES], 0);
 	Mod_LoadTexinfo (mod->name, &mod->texinfo, &mod->numtexinfo,
 		mod_base, &header->lumps[LUMP_TEXINFO], (findimage_t)GL3_FindImage,
+		(findimage_t)GL3_FindLoadedImage, r_retexturing->value,
 		gl3_notexture, 0);
 	Mod_LoadFaces(mod, mod_base, &header->lumps[LUMP_FACES]);
 	Mod_LoadMarksurfaces(mod, mod_base, &header->lumps[LUMP_LEAFFACES]);
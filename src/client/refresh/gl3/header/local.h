@@ -533,6 +533,7 @@ extern gl3image_t *GL3_LoadPic(char *name, byte *pic, int width, int realwidth,
                                int height, int realheight, size_t data_size,
                                imagetype_t type, int bits);
 extern gl3image_t *GL3_FindImage(const char *name, imagetype_t type);
+extern gl3image_t *GL3_FindLoadedImage(const char *name, imagetype_t type);
 extern gl3image_t *GL3_RegisterSkin(const char *name);
 extern void GL3_ShutdownImages(void);
 extern void GL3_FreeUnusedImages(void);
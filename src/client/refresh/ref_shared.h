@@ -87,10 +87,18 @@ extern void FixFileExt(const char *origname, const char *ext, char *filename, si
 extern void GetPCXPalette(byte **colormap, unsigned *d_8to24table);
 extern void LoadPCX(const char *origname, byte **pic, byte **palette, int *width, int *height,
 	int *bitsPerPixel);
-extern void GetPCXInfo(const char *origname, int *width, int *height);
-extern void GetWalInfo(const char *name, int *width, int *height);
-extern void GetM8Info(const char *name, int *width, int *height);
-extern void GetM32Info(const char *name, int *width, int *height);
+extern void DecodePCX(const char *filename, const byte *raw, int len, byte **pic,
+	byte **palette, int *width, int *height, int *bitsPerPixel, qboolean verbose);
+extern const char *DecodeWal(byte *raw, int size, byte **pic, int *width, int *height,
+	size_t *datasize);
+extern const char *DecodeM8(byte *raw, int size, byte **pic, int *width, int *height,
+	size_t *datasize);
+extern const char *DecodeM32(byte *raw, int size, byte **pic, int *width, int *height,
+	size_t *datasize);
+extern void GetPCXInfo(const byte *raw, int len, int *width, int *height);
+extern void GetWalInfo(const byte *raw, int size, int *width, int *height);
+extern void GetM8Info(const byte *raw, int size, int *width, int *height);
+extern void GetM32Info(const byte *raw, int size, int *width, int *height);
 
 extern qboolean ResizeSTB(const byte *input_pixels, int input_width, int input_height,
 			  byte *output_pixels, int output_width, int output_height);
@@ -199,6 +207,9 @@ extern void R_FloodFillSkin(byte *skin, int skinwidth, int skinheight, const uns
 extern unsigned *R_Convert8to32(const byte *data, size_t width, size_t height, const unsigned *table_8to24);
 extern struct image_s *R_LoadImage(const char *name, const char *namewe, const char *ext,
 	imagetype_t type, qboolean r_retexturing, loadimage_t load_image);
+extern void R_PrefetchImages(const char **names, int count, imagetype_t type,
+	qboolean r_retexturing);
+extern void R_FreePrefetchedImages(void);
 extern void Mod_LoadNodes(const char *name, cplane_t *planes, int numplanes,
 	mleaf_t *leafs, int numleafs, mnode_t **nodes, int *numnodes,
 	const byte *mod_base, const lump_t *l);
@@ -208,6 +219,7 @@ extern void Mod_LoadVisibility(dvis_t **vis, const byte *mod_base, const lump_t
 extern void Mod_LoadLighting(byte **lightdata, const byte *mod_base, const lump_t *l);
 extern void Mod_LoadTexinfo(const char *name, mtexinfo_t **texinfo, int *numtexinfo,
 	const byte *mod_base, const lump_t *l, findimage_t find_image,
+	findimage_t find_loaded, qboolean r_retexturing,
 	struct image_s *notexture, int extra);
 extern void Mod_LoadEdges(const char *name, medge_t **edges, int *numedges,
 	const byte *mod_base, const lump_t *l, int extra);
@@ -264,6 +264,7 @@ typedef struct surfcache_s
 	unsigned		height; // DEBUG only needed for debug
 	float			mipscale;
 	image_t			*image;
+	int			spanbatch; // see d_spanbatch
 	byte			data[4]; // width*height elements
 } surfcache_t;
 
@@ -359,13 +360,36 @@ extern float	d_sdivzstepu, d_tdivzstepu;
 extern float	d_sdivzstepv, d_tdivzstepv;
 extern float	d_sdivzorigin, d_tdivzorigin;
 
-void D_DrawSpansPow2(espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv);
+// texture mapping of a world surface, set up by D_CalcGradients. Passed
+// to the span drawers instead of globals so bands can be drawn in parallel
+typedef struct
+{
+	float	sdivzstepu, tdivzstepu;
+	float	sdivzstepv, tdivzstepv;
+	float	sdivzorigin, tdivzorigin;
+	float	ziorigin, zistepu, zistepv;
+	int	sadjust, tadjust;
+	int	bbextents, bbextentt;
+	pixel_t	*cacheblock;
+	int	cachewidth;
+} spangrad_t;
+
+void D_DrawSpansPow2(espan_t *pspan, const spangrad_t *grad);
 void D_DrawZSpans(espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv);
-void TurbulentPow2(espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv);
-void NonTurbulentPow2(espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv);
+void TurbulentPow2(espan_t *pspan, const spangrad_t *grad);
+void NonTurbulentPow2(espan_t *pspan, const spangrad_t *grad);
 
 surfcache_t *D_CacheSurface(const entity_t *currententity, msurface_t *surface, int miplevel);
 
+// surface cache blocks stamped with the current batch are still read by
+// queued spans and must not be overwritten before D_FlushSpanJobs
+#define SW_MAXBANDS	64
+
+extern int	d_spanbatch;
+void D_FlushSpanJobs(void);
+void D_FreeSpanJobs(void);
+int R_NumBands(void);
+
 extern int	d_vrectx, d_vrecty, d_vrectright_particle, d_vrectbottom_particle;
 
 extern int	d_pix_min, d_pix_max, d_pix_mul;
@@ -591,6 +615,7 @@ extern byte *d_16to8table;
 void	R_InitImages(void);
 void	R_ShutdownImages(void);
 image_t	*R_FindImage(const char *name, imagetype_t type);
+image_t	*R_FindLoadedImage(const char *name, imagetype_t type);
 byte	*Get_BestImageSize(const image_t *image, int *req_width, int *req_height);
 void	R_FreeUnusedImages(void);
 qboolean R_ImageHasFreeSpace(void);
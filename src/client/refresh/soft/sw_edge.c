@@ -750,19 +750,187 @@ D_MipLevelForScale (float scale)
 }
 
 
+/*
+=========================================================================
+
+SPAN JOBS
+
+Surfaces are drawn in two steps. D_DrawSurfaces walks the surface list
+on the main thread, builds the surface cache and the gradients and queues
+a job per surface with its spans sorted into horizontal bands of the view.
+D_FlushSpanJobs then draws band by band, on the worker threads when
+sw_threads is set. Bands never share pixels, so drawing needs no locks.
+
+=========================================================================
+*/
+
+typedef enum
+{
+	SPANJOB_TEXTURE,	// surface cache or sky
+	SPANJOB_TURB,		// warping water
+	SPANJOB_FLOWING,	// flowing, but not warping
+	SPANJOB_FILL		// single color
+} spanjobkind_t;
+
+typedef struct
+{
+	spanjobkind_t	kind;
+	int		color;
+	spangrad_t	grad;
+	float		zorigin, zstepu, zstepv;
+} spanjob_t;
+
+int	d_spanbatch = 1;
+
+static spanjob_t	*spanjobs;
+static int		numspanjobs, maxspanjobs;
+
+// two span lists per job and band: spans without and with z writes
+static espan_t		**spanlists;
+static int		maxspanlists;
+
+static int	numspanbands;
+static int	spanbandtop, spanbandheight;
+
 /*
 ==============
-D_FlatFillSurface
+D_FreeSpanJobs
+==============
+*/
+void
+D_FreeSpanJobs (void)
+{
+	if (spanjobs)
+	{
+		free(spanjobs);
+	}
+	spanjobs = NULL;
 
-Simple single color fill with no texture mapping
+	if (spanlists)
+	{
+		free(spanlists);
+	}
+	spanlists = NULL;
+
+	numspanjobs = maxspanjobs = maxspanlists = 0;
+}
+
+/*
+==============
+D_SetupSpanBands
 ==============
 */
 static void
-D_FlatFillSurface (surf_t *surf, pixel_t color)
+D_SetupSpanBands (void)
 {
-	espan_t	*span;
+	numspanbands = R_NumBands();
+	spanbandtop = r_refdef.vrect.y;
+	spanbandheight = (r_refdef.vrect.height + numspanbands - 1) / numspanbands;
+	if (spanbandheight < 1)
+		spanbandheight = 1;
+}
+
+/*
+==============
+D_AllocSpanJob
+==============
+*/
+static spanjob_t *
+D_AllocSpanJob (spanjobkind_t kind)
+{
+	spanjob_t	*job;
+	int		numlists;
+
+	if (numspanjobs == maxspanjobs)
+	{
+		maxspanjobs = maxspanjobs ? maxspanjobs * 2 : 256;
+		spanjobs = realloc(spanjobs, maxspanjobs * sizeof(spanjob_t));
+		if (!spanjobs)
+		{
+			Com_Error(ERR_FATAL, "%s: Couldn't allocate %d span jobs",
+				__func__, maxspanjobs);
+		}
+	}
+
+	numlists = (numspanjobs + 1) * numspanbands * 2;
+	if (numlists > maxspanlists)
+	{
+		maxspanlists = Q_max(numlists, maxspanjobs * numspanbands * 2);
+		spanlists = realloc(spanlists, maxspanlists * sizeof(espan_t *));
+		if (!spanlists)
+		{
+			Com_Error(ERR_FATAL, "%s: Couldn't allocate %d span lists",
+				__func__, maxspanlists);
+		}
+	}
+
+	memset(&spanlists[numspanjobs * numspanbands * 2], 0,
+		numspanbands * 2 * sizeof(espan_t *));
+
+	job = &spanjobs[numspanjobs];
+	job->kind = kind;
+	job->color = 0;
+
+	return job;
+}
+
+/*
+==============
+D_QueueSpans
+
+Sorts the spans of a surface into the bands of the job allocated last
+and marks the z buffer damage. This has to be done here, in surface
+order, as the damage decides which spans write z.
+==============
+*/
+static void
+D_QueueSpans (spanjob_t *job, espan_t *pspan, float zorigin, float zstepu, float zstepv)
+{
+	espan_t	**lists;
+
+	job->zorigin = zorigin;
+	job->zstepu = zstepu;
+	job->zstepv = zstepv;
+
+	lists = &spanlists[numspanjobs * numspanbands * 2];
+	numspanjobs++;
+
+	while (pspan)
+	{
+		espan_t	*next;
+		int	band, writez;
 
-	for (span=surf->spans ; span ; span=span->pnext)
+		next = pspan->pnext;
+
+		band = (pspan->v - spanbandtop) / spanbandheight;
+		band = Q_clamp(band, 0, numspanbands - 1);
+
+		writez = VID_CheckDamageZBuffer(pspan->u, pspan->v, pspan->count, 0);
+		if (writez)
+		{
+			// solid map walls damage
+			VID_DamageZBuffer(pspan->u, pspan->v);
+			VID_DamageZBuffer(pspan->u + pspan->count, pspan->v);
+		}
+
+		pspan->pnext = lists[band * 2 + writez];
+		lists[band * 2 + writez] = pspan;
+
+		pspan = next;
+	}
+}
+
+/*
+==============
+D_FlatFillSpans
+
+Simple single color fill with no texture mapping
+==============
+*/
+static void
+D_FlatFillSpans (espan_t *span, pixel_t color)
+{
+	for ( ; span ; span=span->pnext)
 	{
 		pixel_t   *pdest;
 
@@ -771,6 +939,81 @@ D_FlatFillSurface (surf_t *surf, pixel_t color)
 	}
 }
 
+/*
+==============
+D_DrawSpanBand
+
+Draws one band of all queued jobs, may run on a worker thread
+==============
+*/
+static void
+D_DrawSpanBand (void *data, int band)
+{
+	int	i;
+
+	for (i = 0; i < numspanjobs; i++)
+	{
+		const spanjob_t	*job;
+		espan_t		**lists;
+		int		writez;
+
+		job = &spanjobs[i];
+		lists = &spanlists[(i * numspanbands + band) * 2];
+
+		for (writez = 0; writez < 2; writez++)
+		{
+			espan_t	*pspan;
+
+			pspan = lists[writez];
+			if (!pspan)
+				continue;
+
+			switch (job->kind)
+			{
+			case SPANJOB_TEXTURE:
+				D_DrawSpansPow2 (pspan, &job->grad);
+				break;
+			case SPANJOB_TURB:
+				TurbulentPow2 (pspan, &job->grad);
+				break;
+			case SPANJOB_FLOWING:
+				NonTurbulentPow2 (pspan, &job->grad);
+				break;
+			case SPANJOB_FILL:
+				D_FlatFillSpans (pspan, job->color);
+				break;
+			}
+
+			if (writez)
+				D_DrawZSpans (pspan, job->zorigin, job->zstepu, job->zstepv);
+		}
+	}
+}
+
+/*
+==============
+D_FlushSpanJobs
+
+Draws all queued jobs. Also called by the surface cache before it
+reuses a block the queued jobs still read from.
+==============
+*/
+void
+D_FlushSpanJobs (void)
+{
+	if (!numspanjobs)
+		return;
+
+	if (numspanbands > 1)
+		ri.Jobs_Run(D_DrawSpanBand, NULL, numspanbands);
+	else
+		D_DrawSpanBand(NULL, 0);
+
+	numspanjobs = 0;
+	d_spanbatch++;
+}
+
+//=============================================================================
 
 /*
 ==============
@@ -778,7 +1021,7 @@ D_CalcGradients
 ==============
 */
 static void
-D_CalcGradients (msurface_t *pface, float d_ziorigin, float d_zistepu, float d_zistepv)
+D_CalcGradients (msurface_t *pface, const surf_t *s, spangrad_t *grad)
 {
 	float		mipscale;
 	vec3_t		p_temp1;
@@ -791,25 +1034,29 @@ D_CalcGradients (msurface_t *pface, float d_ziorigin, float d_zistepu, float d_z
 	TransformVector (pface->texinfo->vecs[1], p_taxis);
 
 	t = xscaleinv * mipscale;
-	d_sdivzstepu = p_saxis[0] * t;
-	d_tdivzstepu = p_taxis[0] * t;
+	grad->sdivzstepu = p_saxis[0] * t;
+	grad->tdivzstepu = p_taxis[0] * t;
 
 	t = yscaleinv * mipscale;
-	d_sdivzstepv = -p_saxis[1] * t;
-	d_tdivzstepv = -p_taxis[1] * t;
+	grad->sdivzstepv = -p_saxis[1] * t;
+	grad->tdivzstepv = -p_taxis[1] * t;
 
-	d_sdivzorigin = p_saxis[2] * mipscale - xcenter * d_sdivzstepu -
-			ycenter * d_sdivzstepv;
-	d_tdivzorigin = p_taxis[2] * mipscale - xcenter * d_tdivzstepu -
-			ycenter * d_tdivzstepv;
+	grad->sdivzorigin = p_saxis[2] * mipscale - xcenter * grad->sdivzstepu -
+			ycenter * grad->sdivzstepv;
+	grad->tdivzorigin = p_taxis[2] * mipscale - xcenter * grad->tdivzstepu -
+			ycenter * grad->tdivzstepv;
+
+	grad->ziorigin = s->d_ziorigin;
+	grad->zistepu = s->d_zistepu;
+	grad->zistepv = s->d_zistepv;
 
 	VectorScale (transformed_modelorg, mipscale, p_temp1);
 
 	t = SHIFT16XYZ_MULT * mipscale;
-	sadjust = ((int)(DotProduct (p_temp1, p_saxis) * SHIFT16XYZ_MULT + 0.5)) -
+	grad->sadjust = ((int)(DotProduct (p_temp1, p_saxis) * SHIFT16XYZ_MULT + 0.5)) -
 			((pface->texturemins[0] << SHIFT16XYZ) >> miplevel)
 			+ pface->texinfo->vecs[0][3]*t;
-	tadjust = ((int)(DotProduct (p_temp1, p_taxis) * SHIFT16XYZ_MULT + 0.5)) -
+	grad->tadjust = ((int)(DotProduct (p_temp1, p_taxis) * SHIFT16XYZ_MULT + 0.5)) -
 			((pface->texturemins[1] << SHIFT16XYZ) >> miplevel)
 			+ pface->texinfo->vecs[1][3]*t;
 
@@ -817,16 +1064,16 @@ D_CalcGradients (msurface_t *pface, float d_ziorigin, float d_zistepu, float d_z
 	if (pface->texinfo->flags & SURF_FLOWING)
 	{
 		if(pface->texinfo->flags & SURF_WARP)
-			sadjust += SHIFT16XYZ_MULT * (-128 * ( (r_newrefdef.time * 0.25) - (int)(r_newrefdef.time * 0.25) ));
+			grad->sadjust += SHIFT16XYZ_MULT * (-128 * ( (r_newrefdef.time * 0.25) - (int)(r_newrefdef.time * 0.25) ));
 		else
-			sadjust += SHIFT16XYZ_MULT * (-128 * ( (r_newrefdef.time * 0.77) - (int)(r_newrefdef.time * 0.77) ));
+			grad->sadjust += SHIFT16XYZ_MULT * (-128 * ( (r_newrefdef.time * 0.77) - (int)(r_newrefdef.time * 0.77) ));
 	}
 
 	//
 	// -1 (-epsilon) so we never wander off the edge of the texture
 	//
-	bbextents = ((pface->extents[0] << SHIFT16XYZ) >> miplevel) - 1;
-	bbextentt = ((pface->extents[1] << SHIFT16XYZ) >> miplevel) - 1;
+	grad->bbextents = ((pface->extents[0] << SHIFT16XYZ) >> miplevel) - 1;
+	grad->bbextentt = ((pface->extents[1] << SHIFT16XYZ) >> miplevel) - 1;
 }
 
 
@@ -840,10 +1087,13 @@ The grey background filler seen when there is a hole in the map
 static void
 D_BackgroundSurf (surf_t *s)
 {
-	D_FlatFillSurface (s, (int)sw_clearcolor->value & 0xFF);
+	spanjob_t	*job;
+
+	job = D_AllocSpanJob (SPANJOB_FILL);
+	job->color = (int)sw_clearcolor->value & 0xFF;
 	// set up a gradient for the background surface that places it
 	// effectively at infinity distance from the viewpoint
-	D_DrawZSpans (s->spans, -0.9, 0, 0);
+	D_QueueSpans (job, s->spans, -0.9, 0, 0);
 }
 
 /*
@@ -854,10 +1104,10 @@ D_TurbulentSurf
 static void
 D_TurbulentSurf(surf_t *s)
 {
+	spanjob_t	*job;
+
 	pface = s->msurf;
 	miplevel = 0;
-	cacheblock = pface->texinfo->image->pixels[0];
-	cachewidth = 64;
 
 	if (s->insubmodel)
 	{
@@ -875,17 +1125,20 @@ D_TurbulentSurf(surf_t *s)
 						// make entity passed in
 	}
 
-	D_CalcGradients (pface, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
-
 	//============
 	// textures that aren't warping are just flowing. Use NonTurbulentPow2 instead
 	if(!(pface->texinfo->flags & SURF_WARP))
-		NonTurbulentPow2 (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+		job = D_AllocSpanJob (SPANJOB_FLOWING);
 	else
-		TurbulentPow2 (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+		job = D_AllocSpanJob (SPANJOB_TURB);
 	//============
 
-	D_DrawZSpans (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+	job->grad.cacheblock = pface->texinfo->image->pixels[0];
+	job->grad.cachewidth = 64;
+
+	D_CalcGradients (pface, s, &job->grad);
+
+	D_QueueSpans (job, s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
 
 	if (s->insubmodel)
 	{
@@ -911,20 +1164,22 @@ D_SkySurf
 static void
 D_SkySurf (surf_t *s)
 {
+	spanjob_t	*job;
+
 	pface = s->msurf;
 	miplevel = 0;
 	if (!pface->texinfo->image)
 		return;
-	cacheblock = pface->texinfo->image->pixels[0];
-	cachewidth = 256;
 
-	D_CalcGradients (pface, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+	job = D_AllocSpanJob (SPANJOB_TEXTURE);
+	job->grad.cacheblock = pface->texinfo->image->pixels[0];
+	job->grad.cachewidth = 256;
 
-	D_DrawSpansPow2 (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+	D_CalcGradients (pface, s, &job->grad);
 
 	// set up a gradient for the background surface that places it
 	// effectively at infinity distance from the viewpoint
-	D_DrawZSpans (s->spans, -0.9, 0, 0);
+	D_QueueSpans (job, s->spans, -0.9, 0, 0);
 }
 
 /*
@@ -938,6 +1193,7 @@ static void
 D_SolidSurf (entity_t *currententity, surf_t *s)
 {
 	float len1, len2, mipadjust;
+	spanjob_t *job;
 
 	if (s->insubmodel)
 	{
@@ -965,16 +1221,17 @@ D_SolidSurf (entity_t *currententity, surf_t *s)
 	miplevel = D_MipLevelForScale(s->nearzi * scale_for_mip * mipadjust);
 
 	// FIXME: make this passed in to D_CacheSurface
+	// may flush the queued jobs, so allocate ours afterwards
 	pcurrentcache = D_CacheSurface (currententity, pface, miplevel);
+	pcurrentcache->spanbatch = d_spanbatch;
 
-	cacheblock = (pixel_t *)pcurrentcache->data;
-	cachewidth = pcurrentcache->width;
-
-	D_CalcGradients (pface, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+	job = D_AllocSpanJob (SPANJOB_TEXTURE);
+	job->grad.cacheblock = (pixel_t *)pcurrentcache->data;
+	job->grad.cachewidth = pcurrentcache->width;
 
-	D_DrawSpansPow2 (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+	D_CalcGradients (pface, s, &job->grad);
 
-	D_DrawZSpans (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+	D_QueueSpans (job, s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
 
 	if (s->insubmodel)
 	{
@@ -1007,13 +1264,16 @@ D_DrawflatSurfaces (const surf_t *surface)
 
 	for (s = &surfaces[1] ; s<surface ; s++)
 	{
+		spanjob_t	*job;
+
 		if (!s->spans)
 			continue;
 
 		// make a stable color for each surface by taking the low
 		// bits of the msurface pointer
-		D_FlatFillSurface (s, color & 0xFF);
-		D_DrawZSpans (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+		job = D_AllocSpanJob (SPANJOB_FILL);
+		job->color = color & 0xFF;
+		D_QueueSpans (job, s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
 
 		color ++;
 	}
@@ -1034,6 +1294,8 @@ D_DrawSurfaces (entity_t *currententity, const surf_t *surface)
 	TransformVector (modelorg, transformed_modelorg);
 	VectorCopy (transformed_modelorg, world_transformed_modelorg);
 
+	D_SetupSpanBands ();
+
 	if (!sw_drawflat->value)
 	{
 		surf_t *s;
@@ -1058,6 +1320,8 @@ D_DrawSurfaces (entity_t *currententity, const surf_t *surface)
 	else
 		D_DrawflatSurfaces (surface);
 
+	D_FlushSpanJobs ();
+
 	VectorSubtract (r_origin, vec3_origin, modelorg);
 	R_TransformFrustum ();
 }
@@ -486,6 +486,37 @@ R_ApplyLight(pixel_t pix, const light3_t light)
 	return d_16to8table[i_c & 0xFFFF];
 }
 
+/*
+===============
+R_FindLoadedImage
+
+Finds the given image if it's already loaded, name
+must have its backslashes fixed
+===============
+*/
+image_t	*
+R_FindLoadedImage(const char *name, imagetype_t type)
+{
+	image_t *image;
+	int i;
+
+	/* just return white image if show lightmap only */
+	if ((type == it_wall || type == it_skin) && r_lightmap->value)
+	{
+		return r_whitetexture_mip;
+	}
+
+	for (i=0, image=r_images ; i<numr_images ; i++,image++)
+	{
+		if (!strcmp(name, image->name))
+		{
+			return image;
+		}
+	}
+
+	return NULL;
+}
+
 /*
 ===============
 R_FindImage
@@ -500,7 +531,6 @@ R_FindImage(const char *originname, imagetype_t type)
 	const char* ext;
 	image_t *image;
 	size_t len;
-	int i;
 
 	if (!originname)
 	{
@@ -537,13 +567,11 @@ R_FindImage(const char *originname, imagetype_t type)
 	namewe[len] = 0;
 
 	// look for it
-	for (i=0, image=r_images ; i<numr_images ; i++,image++)
+	image = R_FindLoadedImage(name, type);
+	if (image)
 	{
-		if (!strcmp(name, image->name))
-		{
-			image->registration_sequence = registration_sequence;
-			return image;
-		}
+		image->registration_sequence = registration_sequence;
+		return image;
 	}
 
 	//
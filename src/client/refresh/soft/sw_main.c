@@ -29,10 +29,19 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "header/local.h"
 
+/* The AVX2 row conversion is built with GCC and clang on x86
+   even if the rest of the renderer isn't, it's picked at runtime. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SW_CONVERT_AVX2
+#endif
+
 #define NUMSTACKEDGES		2048
 #define NUMSTACKSURFACES	1024
 #define MAXALIASVERTS		2048
 #define MAXLIGHTS		1024 // allow some very large lightmaps
+#define SW_TILESIZE		32 // partial refresh compares frames in tiles
+#define SW_MAXDIRTYRECTS	16
 
 pixel_t		*vid_buffer = NULL;
 static pixel_t	*swap_buffers = NULL;
@@ -46,6 +55,9 @@ static int	vid_minu, vid_minv, vid_maxu, vid_maxv;
 static int	vid_zminu, vid_zminv, vid_zmaxu, vid_zmaxv;
 static qboolean IsHighDPIaware = false;
 static qboolean texture_high_color = false;
+#if defined(SW_CONVERT_AVX2)
+static qboolean sw_avx2 = false; // set by RE_Init
+#endif
 
 // last position  on map
 static vec3_t	lastvieworg;
@@ -153,6 +165,7 @@ cvar_t	*r_scale8bittextures;
 cvar_t	*sw_gunzposition;
 cvar_t	*r_validation;
 static cvar_t	*sw_partialrefresh;
+static cvar_t	*sw_threads;
 
 cvar_t	*r_drawworld;
 static cvar_t	*r_drawentities;
@@ -212,6 +225,30 @@ int		cachewidth;
 pixel_t		*d_viewbuffer;
 zvalue_t	*d_pzbuffer;
 
+/*
+================
+R_NumBands
+
+Number of horizontal bands the view is split into for drawing world
+spans and particles on the worker threads. 1 draws on the main thread.
+================
+*/
+int
+R_NumBands (void)
+{
+	int	bands;
+
+	bands = (int)sw_threads->value;
+
+	if (bands < 0)
+	{
+		// a few bands per thread, they don't take equally long
+		bands = (ri.Jobs_NumWorkers() + 1) * 4;
+	}
+
+	return Q_clamp(bands, 1, SW_MAXBANDS);
+}
+
 static void RE_BeginFrame(float camera_separation);
 static void Draw_BuildGammaTable(void);
 static void RE_CleanFrame(void);
@@ -386,6 +423,7 @@ R_RegisterVariables (void)
 	r_scale8bittextures = ri.Cvar_Get("r_scale8bittextures", "0", CVAR_ARCHIVE);
 	sw_gunzposition = ri.Cvar_Get("sw_gunzposition", "8", CVAR_ARCHIVE);
 	r_validation = ri.Cvar_Get("r_validation", "0", CVAR_ARCHIVE);
+	sw_threads = ri.Cvar_Get("sw_threads", "0", CVAR_ARCHIVE);
 
 	// On MacOS texture is cleaned up after render and code have to copy a whole
 	// screen to texture, other platforms save previous texture content and can be
@@ -472,6 +510,11 @@ RE_Init(void)
 
 	r_aliasuvscale = 1.0;
 
+#if defined(SW_CONVERT_AVX2)
+	__builtin_cpu_init();
+	sw_avx2 = (__builtin_cpu_supports("avx2") != 0);
+#endif
+
 	GetPCXPalette (&vid_colormap, (unsigned *)d_8to24table);
 	vid_alphamap = vid_colormap + 64*256;
 
@@ -2188,6 +2231,8 @@ RE_ShutdownContext(void)
 	}
 	edge_basespans = NULL;
 
+	D_FreeSpanJobs();
+
 	if (finalverts)
 	{
 		free(finalverts);
@@ -2237,97 +2282,238 @@ point math used in R_ScanEdges() overflows at width 2048 !!
 */
 char shift_size;
 
-static void
-RE_CopyFrame(Uint32 *pixels, int pitch, SDL_Rect *rect)
+#if defined(SW_CONVERT_AVX2)
+/*
+ * Looks up eight pixels at once with a gather. Returns how many
+ * pixels were converted, the rest is left to RE_ConvertRow.
+ */
+__attribute__((target("avx2"))) static int
+RE_ConvertRowAVX2(Uint32 *dst, const pixel_t *src, int count, const Uint32 *palette)
 {
-	const unsigned *sdl_palette;
+	int done;
 
-	sdl_palette = (unsigned *)sw_state.currentpalette;
+	for (done = 0; done + 8 <= count; done += 8)
+	{
+		__m256i index;
 
-	/* no gaps between images rows */
-	if (pitch == vid_buffer_width)
+		index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + done)));
+		_mm256_storeu_si256((__m256i *)(dst + done),
+			_mm256_i32gather_epi32((const int *)palette, index, 4));
+	}
+
+	return done;
+}
+#endif
+
+/*
+ * Converts a row of palette indices to 32 bit colors. On x86 CPUs with
+ * AVX2 eight pixels are looked up at once with a gather. SSE2 and NEON
+ * have no table lookup wide enough for a 256 entry palette, so the others
+ * stay with plain loads and get their speed up from RE_CopyFrame running
+ * on all threads.
+ */
+static void
+RE_ConvertRow(Uint32 *dst, const pixel_t *src, int count, const Uint32 *palette)
+{
+#if defined(SW_CONVERT_AVX2)
+	if (sw_avx2)
 	{
-		const byte *src_max;
-		Uint32 *dst;
-		byte *src;
+		int done = RE_ConvertRowAVX2(dst, src, count, palette);
 
-		dst = pixels;
-		src = vid_buffer + rect->y * vid_buffer_width;
-		src_max = src + rect->h * vid_buffer_width;
+		src += done;
+		dst += done;
+		count -= done;
+	}
+#endif
 
-		while (src < src_max)
-		{
-			*dst = sdl_palette[*src];
+	while (count >= 4)
+	{
+		dst[0] = palette[src[0]];
+		dst[1] = palette[src[1]];
+		dst[2] = palette[src[2]];
+		dst[3] = palette[src[3]];
 
-			src++;
-			dst++;
-		}
+		src += 4;
+		dst += 4;
+		count -= 4;
 	}
-	else
+
+	while (count > 0)
 	{
-		int y, buffer_pos;
-		Uint32 *dst;
+		*dst++ = palette[*src++];
+		count--;
+	}
+}
 
-		buffer_pos = rect->y * vid_buffer_width;
-		dst = pixels;
+typedef struct
+{
+	Uint32		*pixels;
+	int		pitch;
+	const SDL_Rect	*rect;
+	int		rows;
+} copyjob_t;
 
-		for (y = rect->y; y < rect->y + rect->h; y++)
-		{
-			int x;
+static void
+RE_CopyRows(void *data, int index)
+{
+	const copyjob_t *job = data;
+	const Uint32 *palette;
+	int y, ymax;
 
-			for (x = 0; x < vid_buffer_width; x++)
-			{
-				dst[x] = sdl_palette[vid_buffer[buffer_pos]];
-				buffer_pos ++;
-			}
+	palette = (const Uint32 *)sw_state.currentpalette;
 
-			dst += pitch;
-		}
+	y = index * job->rows;
+	ymax = Q_min(y + job->rows, job->rect->h);
+
+	for ( ; y < ymax; y++)
+	{
+		RE_ConvertRow(job->pixels + y * job->pitch,
+			vid_buffer + (job->rect->y + y) * vid_buffer_width + job->rect->x,
+			job->rect->w, palette);
+	}
+}
+
+static void
+RE_CopyFrame(Uint32 *pixels, int pitch, const SDL_Rect *rect)
+{
+	copyjob_t job;
+	int bands;
+
+	job.pixels = pixels;
+	job.pitch = pitch;
+	job.rect = rect;
+
+	bands = Q_min(R_NumBands(), rect->h);
+	if (bands > 1)
+	{
+		job.rows = (rect->h + bands - 1) / bands;
+		ri.Jobs_Run(RE_CopyRows, &job, (rect->h + job.rows - 1) / job.rows);
+	}
+	else
+	{
+		job.rows = rect->h;
+		RE_CopyRows(&job, 0);
 	}
 
 	if ((sw_anisotropic->value > 0) && !fastmoving)
 	{
+		/* rect spans whole rows, see RE_FindDirtyRects */
 		SmoothColorImage((unsigned *)pixels, rect->h * vid_buffer_width,
 			sw_anisotropic->value);
 	}
 }
 
-static int
-RE_BufferDifferenceStart(int vmin, int vmax)
+/*
+ * True if any pixel of a tile, clipped to the given rows and columns,
+ * differs between the two frames.
+ */
+static qboolean
+RE_TileChanged(const pixel_t *back, const pixel_t *front, int tx, int y0, int y1,
+	int minu, int maxu)
 {
-	int *front_buffer, *back_buffer;
-	const int *back_max;
+	int x0, x1, y;
 
-	back_buffer = (int*)(swap_frames[0] + vmin);
-	front_buffer = (int*)(swap_frames[1] + vmin);
-	back_max = (int*)(swap_frames[0] + vmax);
+	x0 = Q_max(tx * SW_TILESIZE, minu);
+	x1 = Q_min((tx + 1) * SW_TILESIZE, maxu);
 
-	while (back_buffer < back_max && *back_buffer == *front_buffer) {
-		back_buffer ++;
-		front_buffer ++;
+	for (y = y0; y < y1; y++)
+	{
+		int offset = y * vid_buffer_width + x0;
+
+		if (memcmp(back + offset, front + offset, (x1 - x0) * sizeof(pixel_t)))
+		{
+			return true;
+		}
 	}
-	return (pixel_t*)back_buffer - swap_frames[0];
+
+	return false;
 }
 
-static size_t
-RE_BufferDifferenceEnd(int vmin, int vmax)
+/*
+ * Compares the new frame with the one shown before in SW_TILESIZE
+ * square tiles, inside the damaged area only. Runs of tile rows with
+ * changes become one rectangle each, as wide as their changed tiles.
+ */
+static int
+RE_FindDirtyRects(int minu, int minv, int maxu, int maxv, SDL_Rect *rects)
 {
-	int *front_buffer, *back_buffer;
-	const int *back_min;
+	const pixel_t *back, *front;
+	int numrects, ty;
+	qboolean lastdirty;
+
+	back = swap_frames[swap_current & 1];
+	front = swap_frames[(swap_current + 1) & 1];
 
-	back_buffer = (int*)(swap_frames[0] + vmax);
-	front_buffer = (int*)(swap_frames[1] + vmax);
-	back_min = (int*)(swap_frames[0] + vmin);
+	numrects = 0;
+	lastdirty = false;
 
-	do
+	for (ty = minv / SW_TILESIZE; ty * SW_TILESIZE < maxv; ty++)
 	{
-		back_buffer --;
-		front_buffer --;
+		int y0, y1, tx, tx0, tx1, x0, x1;
+
+		y0 = Q_max(ty * SW_TILESIZE, minv);
+		y1 = Q_min((ty + 1) * SW_TILESIZE, maxv);
+
+		/* the changed tiles in between get uploaded anyway */
+		tx0 = minu / SW_TILESIZE;
+		tx1 = (maxu - 1) / SW_TILESIZE;
+
+		for ( ; tx0 <= tx1; tx0++)
+		{
+			if (RE_TileChanged(back, front, tx0, y0, y1, minu, maxu))
+			{
+				break;
+			}
+		}
+
+		if (tx0 > tx1)
+		{
+			lastdirty = false;
+			continue;
+		}
+
+		for (tx = tx1; tx > tx0; tx--)
+		{
+			if (RE_TileChanged(back, front, tx, y0, y1, minu, maxu))
+			{
+				break;
+			}
+		}
+		tx1 = tx;
+
+		x0 = Q_max(tx0 * SW_TILESIZE, minu);
+		x1 = Q_min((tx1 + 1) * SW_TILESIZE, maxu);
+
+		if (sw_anisotropic->value > 0)
+		{
+			/* smoothing runs along whole rows */
+			x0 = 0;
+			x1 = vid_buffer_width;
+		}
+
+		if (numrects && (lastdirty || numrects == SW_MAXDIRTYRECTS))
+		{
+			/* grow the last one */
+			SDL_Rect *rect = &rects[numrects - 1];
+			int right = Q_max(rect->x + rect->w, x1);
+
+			rect->x = Q_min(rect->x, x0);
+			rect->w = right - rect->x;
+			rect->h = y1 - rect->y;
+		}
+		else
+		{
+			rects[numrects].x = x0;
+			rects[numrects].y = y0;
+			rects[numrects].w = x1 - x0;
+			rects[numrects].h = y1 - y0;
+			numrects++;
+		}
+
+		lastdirty = true;
 	}
-	while (back_buffer > back_min && *back_buffer == *front_buffer);
 
-	/* +1 for fully cover changes */
-	return (pixel_t*)back_buffer - swap_frames[0] + sizeof(int);
+	return numrects;
 }
 
 static void
@@ -2358,56 +2544,31 @@ RE_CleanFrame(void)
 }
 
 static void
-RE_FlushFrame(int vmin, int vmax)
+RE_FlushFrame(const SDL_Rect *rects, int numrects)
 {
-	int pitch;
-	Uint32 *pixels;
-	SDL_Rect rect;
-
-	if (vmin >= vmax)
-	{
-		/* Looks like we already updated everything */
-		return;
-	}
+	int i;
 
 	if (!texture_high_color)
 	{
-		if (sw_partialrefresh->value)
+		for (i = 0; i < numrects; i++)
 		{
-			vmin = vmin / vid_buffer_width;
-			vmax = vmax / vid_buffer_width + 1;
-			if (vmax > vid_buffer_height)
-			{
-				vmax = vid_buffer_height;
-			}
-		}
-		else
-		{
-			// On MacOS texture is cleaned up after render,
-			// code have to copy a whole screen to the texture
-			vmin = 0;
-			vmax = vid_buffer_height;
-		}
-
-		/* set section to update */
-		rect.x = 0;
-		rect.y = vmin;
-		rect.w = vid_buffer_width;
-		rect.h = vmax - vmin;
+			int pitch;
+			Uint32 *pixels;
 
 #ifdef USE_SDL3
-		if (!SDL_LockTexture(texture, &rect, (void**)&pixels, &pitch))
+			if (!SDL_LockTexture(texture, &rects[i], (void**)&pixels, &pitch))
 #else
-		if (SDL_LockTexture(texture, &rect, (void**)&pixels, &pitch))
+			if (SDL_LockTexture(texture, &rects[i], (void**)&pixels, &pitch))
 #endif
-		{
-			Com_Printf("Can't lock texture: %s\n", SDL_GetError());
-			return;
-		}
+			{
+				Com_Printf("Can't lock texture: %s\n", SDL_GetError());
+				return;
+			}
 
-		RE_CopyFrame(pixels, pitch / sizeof(Uint32), &rect);
+			RE_CopyFrame(pixels, pitch / sizeof(Uint32), &rects[i]);
 
-		SDL_UnlockTexture(texture);
+			SDL_UnlockTexture(texture);
+		}
 	}
 
 #ifdef USE_SDL3
@@ -2435,59 +2596,55 @@ RE_FlushFrame(int vmin, int vmax)
 static void
 RE_EndFrame(void)
 {
-	int vmin, vmax;
+	SDL_Rect rects[SW_MAXDIRTYRECTS];
+	int minu, minv, maxu, maxv;
+	int numrects;
 
-	// fix possible issue with min/max
-	if (vid_minu < 0)
-	{
-		vid_minu = 0;
-	}
+	// fix possible issue with min/max, the damaged
+	// corners are inclusive
+	minu = Q_max(vid_minu, 0);
+	minv = Q_max(vid_minv, 0);
+	maxu = Q_min(vid_maxu + 1, vid_buffer_width);
+	maxv = Q_min(vid_maxv + 1, vid_buffer_height);
 
-	if (vid_minv < 0)
+	if (minu >= maxu || minv >= maxv)
 	{
-		vid_minv = 0;
-	}
-
-	if (vid_maxu > vid_buffer_width)
-	{
-		vid_maxu = vid_buffer_width;
+		/* Looks like we already updated everything */
+		return;
 	}
 
-	if (vid_maxv > vid_buffer_height)
+	if (!sw_partialrefresh->value)
 	{
-		vid_maxv = vid_buffer_height;
+		// On MacOS texture is cleaned up after render,
+		// code have to copy a whole screen to the texture
+		rects[0].x = 0;
+		rects[0].y = 0;
+		rects[0].w = vid_buffer_width;
+		rects[0].h = vid_buffer_height;
+		numrects = 1;
 	}
-
-	vmin = vid_minu + vid_minv * vid_buffer_width;
-	vmax = vid_maxu + vid_maxv * vid_buffer_width;
-
-	// fix to correct limit
-	if (vmax > (vid_buffer_height * vid_buffer_width))
+	else if (palette_changed)
 	{
-		vmax = vid_buffer_height * vid_buffer_width;
+		// if palette changed need to flush whole damaged rows
+		rects[0].x = 0;
+		rects[0].y = minv;
+		rects[0].w = vid_buffer_width;
+		rects[0].h = maxv - minv;
+		numrects = 1;
 	}
-
-	// if palette changed need to flush whole buffer
-	if (!palette_changed && sw_partialrefresh->value)
+	else
 	{
-		// search real begin/end of difference
-		vmin = RE_BufferDifferenceStart(vmin, vmax);
+		// search the changed tiles
+		numrects = RE_FindDirtyRects(minu, minv, maxu, maxv, rects);
 
 		// no differences found
-		if (vmin >= vmax)
+		if (!numrects)
 		{
 			return;
 		}
-
-		// search difference end
-		vmax = RE_BufferDifferenceEnd(vmin, vmax);
-		if (vmax > (vid_buffer_height * vid_buffer_width))
-		{
-			vmax = vid_buffer_height * vid_buffer_width;
-		}
 	}
 
-	RE_FlushFrame(vmin, vmax);
+	RE_FlushFrame(rects, numrects);
 }
 
 /*
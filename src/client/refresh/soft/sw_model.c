@@ -674,6 +674,7 @@ Mod_LoadBrushModel(model_t *mod, void *buffer, int modfilelen)
 		mod_base, &header->lumps[LUMP_PLANES], 6);
 	Mod_LoadTexinfo (mod->name, &mod->texinfo, &mod->numtexinfo,
 		mod_base, &header->lumps[LUMP_TEXINFO], (findimage_t)R_FindImage,
+		(findimage_t)R_FindLoadedImage, r_retexturing->value,
 		r_notexture_mip, 6);
 	Mod_LoadFaces (mod, mod_base, &header->lumps[LUMP_FACES]);
 	Mod_LoadMarksurfaces (mod, mod_base, &header->lumps[LUMP_LEAFFACES]);
@@ -26,30 +26,31 @@ extern cvar_t	*sw_custom_particles;
 #define PARTICLE_66     1
 #define PARTICLE_OPAQUE 2
 
+typedef struct
+{
+	int		u, v, pix;
+	zvalue_t	izi;
+	int		color, level;
+} partdraw_t;
+
+static partdraw_t	r_partdraws[MAX_PARTICLES];
+static int		r_numpartdraws;
+static int		r_partbands, r_partbandheight;
+
 /*
-** R_DrawParticle
-**
-** Yes, this is amazingly slow, but it's the C reference
-** implementation and should be both robust and vaguely
-** understandable.  The only time this path should be
-** executed is if we're debugging on x86 or if we're
-** recompiling and deploying on a non-x86 platform.
+** R_ProjectParticle
 **
-** To minimize error and improve readability I went the
-** function pointer route.  This exacts some overhead, but
-** it pays off in clean and easy to understand code.
+** Transforms a particle to the screen and rejects it if hidden. Also
+** marks the z buffer damage, so it must run on the main thread.
 */
-static void
-R_DrawParticle(particle_t *pparticle, int level)
+static qboolean
+R_ProjectParticle(const particle_t *pparticle, int level, partdraw_t *pdraw)
 {
 	vec3_t		local, transformed;
 	float		zi;
-	byte		*pdest;
 	zvalue_t	*pz;
-	int		color = pparticle->color;
-	int		i, pix, count, u, v;
+	int		pix, u, v;
 	zvalue_t	izi;
-	int 		custom_particle = (int)sw_custom_particles->value;
 
 	/*
 	** transform the particle
@@ -61,7 +62,7 @@ R_DrawParticle(particle_t *pparticle, int level)
 	transformed[2] = DotProduct(local, r_ppn);
 
 	if (transformed[2] < PARTICLE_Z_CLIP)
-		return;
+		return false;
 
 	/*
 	** project the point
@@ -76,15 +77,12 @@ R_DrawParticle(particle_t *pparticle, int level)
 		(v < d_vrecty) ||
 		(u < d_vrectx))
 	{
-		return;
+		return false;
 	}
 
 	/*
-	** compute addresses of zbuffer, framebuffer, and
 	** compute the Z-buffer reference value.
 	*/
-	pz = d_pzbuffer + (vid_buffer_width * v) + u;
-	pdest = d_viewbuffer + vid_buffer_width * v + u;
 	izi = (int)(zi * 0x8000);
 
 	/*
@@ -97,28 +95,78 @@ R_DrawParticle(particle_t *pparticle, int level)
 	else if (pix > d_pix_max)
 		pix = d_pix_max;
 
-	/*
-	** render the appropriate pixels
-	*/
-	count = pix;
-
-	int half_count = count / 2;
-
+	pz = d_pzbuffer + (vid_buffer_width * v) + u;
+	int half_count = pix / 2;
 	if (pz[(vid_buffer_width * half_count) + half_count] > izi)
 	{
 		// looks like under some object
-		return;
+		return false;
 	}
 
 	// zbuffer particles damage
 	VID_DamageZBuffer(u, v);
-	VID_DamageZBuffer(u + count, v + count);
+	VID_DamageZBuffer(u + pix, v + pix);
+
+	pdraw->u = u;
+	pdraw->v = v;
+	pdraw->pix = pix;
+	pdraw->izi = izi;
+	pdraw->color = pparticle->color;
+	pdraw->level = level;
+
+	return true;
+}
+
+/*
+** R_DrawParticle
+**
+** Yes, this is amazingly slow, but it's the C reference
+** implementation and should be both robust and vaguely
+** understandable.  The only time this path should be
+** executed is if we're debugging on x86 or if we're
+** recompiling and deploying on a non-x86 platform.
+**
+** Only the rows from top up to bottom are drawn, so bands
+** of the screen can be drawn in parallel.
+*/
+static void
+R_DrawParticle(const partdraw_t *pdraw, int top, int bottom)
+{
+	pixel_t		*pdest;
+	zvalue_t	*pz;
+	int		color = pdraw->color;
+	int		i, pix, count, lastcount, v;
+	zvalue_t	izi = pdraw->izi;
+	int 		custom_particle = (int)sw_custom_particles->value;
+
+	pix = pdraw->pix;
+
+	/*
+	** clip the rows to the band, count runs from pix down to 1
+	*/
+	v = Q_max(pdraw->v, top);
+	count = pix - (v - pdraw->v);
+	lastcount = pix - (Q_min(pdraw->v + pix, bottom) - pdraw->v);
+
+	if (count <= lastcount)
+	{
+		return;
+	}
+
+	/*
+	** compute addresses of zbuffer, framebuffer
+	*/
+	pz = d_pzbuffer + (vid_buffer_width * v) + pdraw->u;
+	pdest = d_viewbuffer + vid_buffer_width * v + pdraw->u;
 
+	/*
+	** render the appropriate pixels
+	*/
 	if (custom_particle == 0)
 	{
-		switch (level) {
+		switch (pdraw->level) {
 		case PARTICLE_33 :
-			for ( ; count ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
+			for ( ; count > lastcount ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
 			{
 				//FIXME--do it in blocks of 8?
 				for (i=0 ; i<pix ; i++)
@@ -135,7 +183,8 @@ R_DrawParticle(particle_t *pparticle, int level)
 		case PARTICLE_66 :
 		{
 			int color_part = (color<<8);
-			for ( ; count ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
+
+			for ( ; count > lastcount ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
 			{
 				for (i=0 ; i<pix ; i++)
 				{
@@ -150,7 +199,7 @@ R_DrawParticle(particle_t *pparticle, int level)
 		}
 
 		default:  //100
-			for ( ; count ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
+			for ( ; count > lastcount ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
 			{
 				for (i=0 ; i<pix ; i++)
 				{
@@ -167,12 +216,13 @@ R_DrawParticle(particle_t *pparticle, int level)
 	else
 	{
 		int min_int, max_int;
+
 		min_int = pix / 2;
 		max_int = (pix * 2) - min_int;
 
-		switch (level) {
+		switch (pdraw->level) {
 		case PARTICLE_33 :
-			for ( ; count ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
+			for ( ; count > lastcount ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
 			{
 				//FIXME--do it in blocks of 8?
 				for (i=0 ; i<pix ; i++)
@@ -190,7 +240,8 @@ R_DrawParticle(particle_t *pparticle, int level)
 		case PARTICLE_66 :
 		{
 			int color_part = (color<<8);
-			for ( ; count ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
+
+			for ( ; count > lastcount ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
 			{
 				for (i=0 ; i<pix ; i++)
 				{
@@ -206,7 +257,7 @@ R_DrawParticle(particle_t *pparticle, int level)
 		}
 
 		default:  //100
-			for ( ; count ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
+			for ( ; count > lastcount ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
 			{
 				for (i=0 ; i<pix ; i++)
 				{
@@ -223,6 +274,31 @@ R_DrawParticle(particle_t *pparticle, int level)
 	}
 }
 
+/*
+** R_DrawParticleBand
+**
+** Draws one band of all projected particles, may run on a
+** worker thread
+*/
+static void
+R_DrawParticleBand(void *data, int band)
+{
+	int	i, top, bottom;
+
+	top = r_refdef.vrect.y + band * r_partbandheight;
+	bottom = top + r_partbandheight;
+
+	if (band == 0)
+		top = 0;
+	if (band == r_partbands - 1)
+		bottom = vid_buffer_height;
+
+	for (i = 0; i < r_numpartdraws; i++)
+	{
+		R_DrawParticle(&r_partdraws[i], top, bottom);
+	}
+}
+
 /*
 ** R_DrawParticles
 **
@@ -241,6 +317,12 @@ R_DrawParticles (void)
 	VectorScale( vup, yscaleshrink, r_pup );
 	VectorCopy( vpn, r_ppn );
 
+	r_numpartdraws = 0;
+	r_partbands = R_NumBands();
+	r_partbandheight = (r_refdef.vrect.height + r_partbands - 1) / r_partbands;
+	if (r_partbandheight < 1)
+		r_partbandheight = 1;
+
 	for (p=r_newrefdef.particles, i=0 ; i<r_newrefdef.num_particles ; i++,p++)
 	{
 		int level;
@@ -252,6 +334,22 @@ R_DrawParticles (void)
 		else
 			level = PARTICLE_33;
 
-		R_DrawParticle(p, level);
+		if (!R_ProjectParticle(p, level, &r_partdraws[r_numpartdraws]))
+			continue;
+
+		if (r_partbands > 1)
+		{
+			// drawn below, after all are projected
+			r_numpartdraws++;
+		}
+		else
+		{
+			R_DrawParticle(&r_partdraws[r_numpartdraws], 0, vid_buffer_height);
+		}
+	}
+
+	if (r_numpartdraws)
+	{
+		ri.Jobs_Run(R_DrawParticleBand, NULL, r_partbands);
 	}
 }
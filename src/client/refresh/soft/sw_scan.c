@@ -184,8 +184,15 @@ TurbulentPow2
 =============
 */
 void
-TurbulentPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv)
+TurbulentPow2 (espan_t *pspan, const spangrad_t *grad)
 {
+	const float	d_sdivzstepu = grad->sdivzstepu, d_tdivzstepu = grad->tdivzstepu;
+	const float	d_sdivzstepv = grad->sdivzstepv, d_tdivzstepv = grad->tdivzstepv;
+	const float	d_sdivzorigin = grad->sdivzorigin, d_tdivzorigin = grad->tdivzorigin;
+	const float	d_ziorigin = grad->ziorigin;
+	const float	d_zistepu = grad->zistepu, d_zistepv = grad->zistepv;
+	const int	sadjust = grad->sadjust, tadjust = grad->tadjust;
+	const int	bbextents = grad->bbextents, bbextentt = grad->bbextentt;
 	float	spancountminus1;
 	float	sdivzpow2stepu, tdivzpow2stepu, zipow2stepu;
 	pixel_t	*r_turb_pbase;
@@ -197,7 +204,7 @@ TurbulentPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistep
 
 	r_turb_turb = sintable + ((int)(r_newrefdef.time*SPEED)&(CYCLE-1));
 
-	r_turb_pbase = (unsigned char *)cacheblock;
+	r_turb_pbase = grad->cacheblock;
 
 	sdivzpow2stepu = d_sdivzstepu * spanstep_value;
 	tdivzpow2stepu = d_tdivzstepu * spanstep_value;
@@ -338,8 +345,15 @@ NonTurbulentPow2 - this is for drawing scrolling textures. they're warping water
 =============
 */
 void
-NonTurbulentPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv)
+NonTurbulentPow2 (espan_t *pspan, const spangrad_t *grad)
 {
+	const float	d_sdivzstepu = grad->sdivzstepu, d_tdivzstepu = grad->tdivzstepu;
+	const float	d_sdivzstepv = grad->sdivzstepv, d_tdivzstepv = grad->tdivzstepv;
+	const float	d_sdivzorigin = grad->sdivzorigin, d_tdivzorigin = grad->tdivzorigin;
+	const float	d_ziorigin = grad->ziorigin;
+	const float	d_zistepu = grad->zistepu, d_zistepv = grad->zistepv;
+	const int	sadjust = grad->sadjust, tadjust = grad->tadjust;
+	const int	bbextents = grad->bbextents, bbextentt = grad->bbextentt;
 	float spancountminus1;
 	float sdivzpow2stepu, tdivzpow2stepu, zipow2stepu;
 	pixel_t	*r_turb_pbase;
@@ -351,7 +365,7 @@ NonTurbulentPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zis
 
 	r_turb_turb = blanktable;
 
-	r_turb_pbase = (unsigned char *)cacheblock;
+	r_turb_pbase = grad->cacheblock;
 
 	sdivzpow2stepu = d_sdivzstepu * spanstep_value;
 	tdivzpow2stepu = d_tdivzstepu * spanstep_value;
@@ -505,7 +519,8 @@ D_DrawSpan
 =============
 */
 static pixel_t *
-D_DrawSpan(pixel_t *pdest, const pixel_t *pbase, int s, int t, int sstep, int tstep, int spancount)
+D_DrawSpan(pixel_t *pdest, const pixel_t *pbase, int s, int t, int sstep, int tstep, int spancount,
+	int cachewidth)
 {
 	const pixel_t *tdest_max = pdest + spancount;
 
@@ -553,8 +568,8 @@ D_DrawSpanFiltered
 =============
 */
 static pixel_t *
-D_DrawSpanFiltered(pixel_t *pdest, pixel_t *pbase, int s, int t, int sstep, int tstep, int spancount,
-	   const espan_t *pspan)
+D_DrawSpanFiltered(pixel_t *pdest, const pixel_t *pbase, int s, int t, int sstep, int tstep, int spancount,
+	   const espan_t *pspan, int cachewidth)
 {
 	do
 	{
@@ -590,8 +605,16 @@ D_DrawSpansPow2
 =============
 */
 void
-D_DrawSpansPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv)
+D_DrawSpansPow2 (espan_t *pspan, const spangrad_t *grad)
 {
+	const float	d_sdivzstepu = grad->sdivzstepu, d_tdivzstepu = grad->tdivzstepu;
+	const float	d_sdivzstepv = grad->sdivzstepv, d_tdivzstepv = grad->tdivzstepv;
+	const float	d_sdivzorigin = grad->sdivzorigin, d_tdivzorigin = grad->tdivzorigin;
+	const float	d_ziorigin = grad->ziorigin;
+	const float	d_zistepu = grad->zistepu, d_zistepv = grad->zistepv;
+	const int	sadjust = grad->sadjust, tadjust = grad->tadjust;
+	const int	bbextents = grad->bbextents, bbextentt = grad->bbextentt;
+	const int	cachewidth = grad->cachewidth;
 	int 	spancount;
 	pixel_t	*pbase;
 	int	snext, tnext;
@@ -603,7 +626,7 @@ D_DrawSpansPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zist
 	spanstep_shift = D_DrawSpanGetStep(d_zistepu, d_zistepv);
 	spanstep_value = (1 << spanstep_shift);
 
-	pbase = (unsigned char *)cacheblock;
+	pbase = grad->cacheblock;
 
 	texture_filtering = (int)sw_texture_filtering->value;
 	sdivzpow2stepu = d_sdivzstepu * spanstep_value;
@@ -722,12 +745,12 @@ D_DrawSpansPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zist
 			if ((texture_filtering == 0) || fastmoving)
 			{
 				pdest = D_DrawSpan(pdest, pbase, s, t, sstep, tstep,
-						   spancount);
+						   spancount, cachewidth);
 			}
 			else
 			{
 				pdest = D_DrawSpanFiltered(pdest, pbase, s, t, sstep, tstep,
-						   spancount, pspan);
+						   spancount, pspan, cachewidth);
 			}
 			s = snext;
 			t = tnext;
@@ -739,6 +762,8 @@ D_DrawSpansPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zist
 /*
 =============
 D_DrawZSpans
+
+The caller checks and marks the z buffer damage, see D_QueueSpans
 =============
 */
 void
@@ -760,15 +785,6 @@ D_DrawZSpans (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv
 		float		zi;
 		float		du, dv;
 
-		if (!VID_CheckDamageZBuffer(pspan->u, pspan->v, pspan->count, 0))
-		{
-			continue;
-		}
-
-		// solid map walls damage
-		VID_DamageZBuffer(pspan->u, pspan->v);
-		VID_DamageZBuffer(pspan->u + pspan->count, pspan->v);
-
 		pdest = d_pzbuffer + (vid_buffer_width * pspan->v) + pspan->u;
 
 		count = pspan->count;
@@ -297,6 +297,7 @@ R_InitCaches (void)
 	sc_base->next = NULL;
 	sc_base->owner = NULL;
 	sc_base->size = sc_size;
+	sc_base->spanbatch = 0;
 }
 
 
@@ -323,6 +324,7 @@ D_FlushCaches (void)
 	sc_base->next = NULL;
 	sc_base->owner = NULL;
 	sc_base->size = sc_size;
+	sc_base->spanbatch = 0;
 }
 
 /*
@@ -334,6 +336,7 @@ static surfcache_t *
 D_SCAlloc (int width, int size)
 {
 	surfcache_t	*new;
+	int		freed;
 
 	if ((width < 0) || (width > 256))
 	{
@@ -359,6 +362,18 @@ D_SCAlloc (int width, int size)
 		sc_rover = sc_base;
 	}
 
+	// queued spans may still read from the blocks about to be reused
+	for (new = sc_rover, freed = 0; new && freed < size; new = new->next)
+	{
+		if (new->spanbatch == d_spanbatch)
+		{
+			D_FlushSpanJobs();
+			break;
+		}
+
+		freed += new->size;
+	}
+
 	// colect and free surfcache_t blocks until the rover block is large enough
 	new = sc_rover;
 	if (sc_rover->owner)
@@ -387,6 +402,7 @@ D_SCAlloc (int width, int size)
 		sc_rover->next = new->next;
 		sc_rover->width = 0;
 		sc_rover->owner = NULL;
+		sc_rover->spanbatch = 0;
 		new->next = sc_rover;
 		new->size = size;
 	}
@@ -399,6 +415,7 @@ D_SCAlloc (int width, int size)
 		new->height = (size - sizeof(*new) + sizeof(new->data)) / width;
 
 	new->owner = NULL; // should be set properly after return
+	new->spanbatch = 0;
 
 	return new;
 }
@@ -440,6 +457,12 @@ D_CacheSurface (const entity_t *currententity, msurface_t *surface, int miplevel
 			&& cache->lightadj[3] == r_drawsurf.lightadj[3] )
 		return cache;
 
+	if (cache && cache->spanbatch == d_spanbatch)
+	{
+		// queued spans still read the old contents
+		D_FlushSpanJobs();
+	}
+
 	//
 	// determine shape of surface
 	//
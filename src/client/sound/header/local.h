@@ -282,6 +282,11 @@ void SDL_RawSamples(int samples, int rate, int width,
  */
 void SDL_Spatialize(channel_t *ch);
 
+/*
+ * Benchmarks the mixing loops
+ */
+void SDL_MixBench_f(void);
+
 /* ----------------------------------------------------------------- */
 
 #if USE_OPENAL
@@ -43,6 +43,7 @@ void OGG_SaveState(void);
 void OGG_Shutdown(void);
 void OGG_Stop(void);
 void OGG_Stream(void);
-void OGG_LoadAsWav(char *filename, wavinfo_t *info, void **buffer);
+short *OGG_DecodeMemory(const byte *data, int size, wavinfo_t *info);
+short *OGG_LoadAsWav(const char *filename, wavinfo_t *info);
 
 #endif
@@ -46,6 +46,17 @@
 #include "../../client/header/client.h"
 #include "../../client/sound/header/local.h"
 
+/* Vectorized mixing, the scalar loops handle the rest */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define SDL_MIX_SSE2
+#define SDL_MIX_NAME "SSE2"
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SDL_MIX_NEON
+#define SDL_MIX_NAME "NEON"
+#endif
+
 /* Defines */
 #define SDL_PAINTBUFFER_SIZE 2048
 #define SDL_FULLVOLUME 80
@@ -173,6 +184,297 @@ lpf_update_samples(LpfContext* lpf_context,int sample_count, portable_samplepair
 	}
 }
 
+/* ------------------------------------------------------------------ */
+
+/*
+ * The mixing loops. The scalar versions work on any number of
+ * samples, the vector versions on as many as fit into their
+ * registers and return how many that were. Both give the very
+ * same results, s_mixbench checks that.
+ */
+
+/*
+ * Mixes 8 bit samples, scale is snd_scaletable[vol][1].
+ */
+static void
+SDL_MixScalar8(portable_samplepair_t *samp, const unsigned char *sfx,
+		int count, const int *lscale, const int *rscale)
+{
+	int i;
+
+	for (i = 0; i < count; i++, samp++)
+	{
+		int data;
+
+		data = sfx[i];
+		samp->left += lscale[data];
+		samp->right += rscale[data];
+	}
+}
+
+/*
+ * Mixes 16 bit samples, vol is channel volume * snd_vol.
+ */
+static void
+SDL_MixScalar16(portable_samplepair_t *samp, const signed short *sfx,
+		int count, int leftvol, int rightvol)
+{
+	int i;
+
+	for (i = 0; i < count; i++, samp++)
+	{
+		int data;
+		int left, right;
+
+		data = sfx[i];
+		left = (data * leftvol) >> 8;
+		right = (data * rightvol) >> 8;
+		samp->left += left;
+		samp->right += right;
+	}
+}
+
+/*
+ * Shifts the mixed stereo samples down to 16 bit and clips them.
+ */
+static void
+SDL_ClipScalar16(short *out, const int *in, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		int val;
+
+		val = in[i] >> 8;
+
+		if (val > 0x7fff)
+		{
+			out[i] = 0x7fff;
+		}
+		else if (val < -32768)
+		{
+			out[i] = -32768;
+		}
+		else
+		{
+			out[i] = val;
+		}
+	}
+}
+
+#if defined(SDL_MIX_SSE2)
+
+/*
+ * _mm_madd_epi16() multiplies pairs of 16 bit values and adds
+ * them into 32 bit. Repeating each sample four times next to
+ * the left and right factors gives the interleaved left and
+ * right sums of the paintbuffer in one instruction.
+ *
+ * The snd_scaletable maps 8 bit sample j to (j - 255) * scale
+ * for negative samples, one more than the sign extended value.
+ * The 8 bit mixing keeps that. The scale is split into 256 *
+ * high + low, so both factors fit into 16 bit.
+ */
+static int
+SDL_MixVector8(portable_samplepair_t *samp, const unsigned char *sfx,
+		int count, int lscale, int rscale)
+{
+	__m128i factors, zero;
+	int i;
+
+	factors = _mm_setr_epi16(lscale & 0xff, lscale >> 8, rscale & 0xff, rscale >> 8,
+			lscale & 0xff, lscale >> 8, rscale & 0xff, rscale >> 8);
+	zero = _mm_setzero_si128();
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		__m128i data, pairs, lo, hi;
+		__m128i *out = (__m128i *)(samp + i);
+
+		data = _mm_loadl_epi64((const __m128i *)(sfx + i));
+		data = _mm_srai_epi16(_mm_unpacklo_epi8(data, data), 8);
+		data = _mm_sub_epi16(data, _mm_cmplt_epi16(data, zero));
+
+		lo = _mm_unpacklo_epi16(data, _mm_slli_epi16(data, 8));
+		hi = _mm_unpackhi_epi16(data, _mm_slli_epi16(data, 8));
+
+		pairs = _mm_unpacklo_epi32(lo, lo);
+		_mm_storeu_si128(out, _mm_add_epi32(_mm_loadu_si128(out),
+				_mm_madd_epi16(pairs, factors)));
+		pairs = _mm_unpackhi_epi32(lo, lo);
+		_mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1),
+				_mm_madd_epi16(pairs, factors)));
+		pairs = _mm_unpacklo_epi32(hi, hi);
+		_mm_storeu_si128(out + 2, _mm_add_epi32(_mm_loadu_si128(out + 2),
+				_mm_madd_epi16(pairs, factors)));
+		pairs = _mm_unpackhi_epi32(hi, hi);
+		_mm_storeu_si128(out + 3, _mm_add_epi32(_mm_loadu_si128(out + 3),
+				_mm_madd_epi16(pairs, factors)));
+	}
+
+	return i;
+}
+
+/*
+ * The volumes are split into two halfs, so each fits into a
+ * signed 16 bit factor. That works up to 65534, larger volumes
+ * are left to the scalar loop.
+ */
+static int
+SDL_MixVector16(portable_samplepair_t *samp, const signed short *sfx,
+		int count, int leftvol, int rightvol)
+{
+	__m128i factors;
+	int i;
+
+	if ((leftvol < 0) || (leftvol > 65534) || (rightvol < 0) || (rightvol > 65534))
+	{
+		return 0;
+	}
+
+	factors = _mm_setr_epi16(leftvol >> 1, leftvol - (leftvol >> 1),
+			rightvol >> 1, rightvol - (rightvol >> 1),
+			leftvol >> 1, leftvol - (leftvol >> 1),
+			rightvol >> 1, rightvol - (rightvol >> 1));
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		__m128i data, pairs, lo, hi;
+		__m128i *out = (__m128i *)(samp + i);
+
+		data = _mm_loadu_si128((const __m128i *)(sfx + i));
+		lo = _mm_unpacklo_epi16(data, data);
+		hi = _mm_unpackhi_epi16(data, data);
+
+		pairs = _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi32(lo, lo), factors), 8);
+		_mm_storeu_si128(out, _mm_add_epi32(_mm_loadu_si128(out), pairs));
+		pairs = _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi32(lo, lo), factors), 8);
+		_mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), pairs));
+		pairs = _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi32(hi, hi), factors), 8);
+		_mm_storeu_si128(out + 2, _mm_add_epi32(_mm_loadu_si128(out + 2), pairs));
+		pairs = _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi32(hi, hi), factors), 8);
+		_mm_storeu_si128(out + 3, _mm_add_epi32(_mm_loadu_si128(out + 3), pairs));
+	}
+
+	return i;
+}
+
+static int
+SDL_ClipVector16(short *out, const int *in, int count)
+{
+	int i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		__m128i a, b;
+
+		a = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(in + i)), 8);
+		b = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(in + i + 4)), 8);
+		_mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(a, b));
+	}
+
+	return i;
+}
+
+#elif defined(SDL_MIX_NEON)
+
+/*
+ * vld2q_s32() splits the paintbuffer into left and right,
+ * so the samples just need to be widened and multiplied.
+ * See the SSE2 version for the quirk of 8 bit samples.
+ */
+static int
+SDL_MixVector8(portable_samplepair_t *samp, const unsigned char *sfx,
+		int count, int lscale, int rscale)
+{
+	int i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		int16x8_t data;
+		int32x4_t half;
+		int32x4x2_t out;
+		int32_t *p = (int32_t *)(samp + i);
+
+		data = vmovl_s8(vld1_s8((const int8_t *)(sfx + i)));
+		data = vsubq_s16(data, vreinterpretq_s16_u16(vcltq_s16(data, vdupq_n_s16(0))));
+
+		half = vmovl_s16(vget_low_s16(data));
+		out = vld2q_s32(p);
+		out.val[0] = vmlaq_n_s32(out.val[0], half, lscale);
+		out.val[1] = vmlaq_n_s32(out.val[1], half, rscale);
+		vst2q_s32(p, out);
+
+		half = vmovl_s16(vget_high_s16(data));
+		out = vld2q_s32(p + 8);
+		out.val[0] = vmlaq_n_s32(out.val[0], half, lscale);
+		out.val[1] = vmlaq_n_s32(out.val[1], half, rscale);
+		vst2q_s32(p + 8, out);
+	}
+
+	return i;
+}
+
+static int
+SDL_MixVector16(portable_samplepair_t *samp, const signed short *sfx,
+		int count, int leftvol, int rightvol)
+{
+	int i;
+
+	for (i = 0; i + 4 <= count; i += 4)
+	{
+		int32x4_t data;
+		int32x4x2_t out;
+		int32_t *p = (int32_t *)(samp + i);
+
+		data = vmovl_s16(vld1_s16(sfx + i));
+		out = vld2q_s32(p);
+		out.val[0] = vaddq_s32(out.val[0], vshrq_n_s32(vmulq_n_s32(data, leftvol), 8));
+		out.val[1] = vaddq_s32(out.val[1], vshrq_n_s32(vmulq_n_s32(data, rightvol), 8));
+		vst2q_s32(p, out);
+	}
+
+	return i;
+}
+
+static int
+SDL_ClipVector16(short *out, const int *in, int count)
+{
+	int i;
+
+	for (i = 0; i + 4 <= count; i += 4)
+	{
+		vst1_s16(out + i, vqmovn_s32(vshrq_n_s32(vld1q_s32(in + i), 8)));
+	}
+
+	return i;
+}
+
+#else
+
+static int
+SDL_MixVector8(portable_samplepair_t *samp, const unsigned char *sfx,
+		int count, int lscale, int rscale)
+{
+	return 0;
+}
+
+static int
+SDL_MixVector16(portable_samplepair_t *samp, const signed short *sfx,
+		int count, int leftvol, int rightvol)
+{
+	return 0;
+}
+
+static int
+SDL_ClipVector16(short *out, const int *in, int count)
+{
+	return 0;
+}
+
+#endif
+
 /*
  * Transfers a mixed "paint buffer" to
  * the SDL output buffer and places it
@@ -229,38 +531,8 @@ SDL_TransferPaintBuffer(int endtime)
 
 			snd_linear_count <<= 1;
 
-			for (i = 0; i < snd_linear_count; i += 2)
-			{
-				val = snd_p[i] >> 8;
-
-				if (val > 0x7fff)
-				{
-					snd_out[i] = 0x7fff;
-				}
-				else if (val < -32768)
-				{
-					snd_out[i] = -32768;
-				}
-				else
-				{
-					snd_out[i] = val;
-				}
-
-				val = snd_p[i + 1] >> 8;
-
-				if (val > 0x7fff)
-				{
-					snd_out[i + 1] = 0x7fff;
-				}
-				else if (val < -32768)
-				{
-					snd_out[i + 1] = -32768;
-				}
-				else
-				{
-					snd_out[i + 1] = val;
-				}
-			}
+			i = SDL_ClipVector16(snd_out, snd_p, snd_linear_count);
+			SDL_ClipScalar16(snd_out + i, snd_p + i, snd_linear_count - i);
 
 			snd_p += snd_linear_count;
 			ls_paintedtime += (snd_linear_count >> 1);
@@ -337,7 +609,7 @@ SDL_PaintChannelFrom8(channel_t *ch, sfxcache_t *sc, int count, int offset)
 {
 	int *lscale, *rscale;
 	unsigned char *sfx;
-	int i;
+	int done;
 	portable_samplepair_t *samp;
 
 	if (ch->leftvol > 255)
@@ -356,14 +628,8 @@ SDL_PaintChannelFrom8(channel_t *ch, sfxcache_t *sc, int count, int offset)
 
 	samp = &paintbuffer[offset];
 
-	for (i = 0; i < count; i++, samp++)
-	{
-		int data;
-
-		data = sfx[i];
-		samp->left += lscale[data];
-		samp->right += rscale[data];
-	}
+	done = SDL_MixVector8(samp, sfx, count, lscale[1], rscale[1]);
+	SDL_MixScalar8(samp + done, sfx + done, count - done, lscale, rscale);
 
 	ch->pos += count;
 }
@@ -376,7 +642,7 @@ SDL_PaintChannelFrom16(channel_t *ch, sfxcache_t *sc, int count, int offset)
 {
 	int leftvol, rightvol;
 	signed short *sfx;
-	int i;
+	int done;
 	portable_samplepair_t *samp;
 
 	leftvol = ch->leftvol * snd_vol;
@@ -385,17 +651,8 @@ SDL_PaintChannelFrom16(channel_t *ch, sfxcache_t *sc, int count, int offset)
 
 	samp = &paintbuffer[offset];
 
-	for (i = 0; i < count; i++, samp++)
-	{
-		int data;
-		int left, right;
-
-		data = sfx[i];
-		left = (data * leftvol) >> 8;
-		right = (data * rightvol) >> 8;
-		samp->left += left;
-		samp->right += right;
-	}
+	done = SDL_MixVector16(samp, sfx, count, leftvol, rightvol);
+	SDL_MixScalar16(samp + done, sfx + done, count - done, leftvol, rightvol);
 
 	ch->pos += count;
 }
@@ -1268,6 +1525,164 @@ SDL_SoundInfo(void)
 	Com_Printf("%p sound buffer\n", sound.buffer);
 }
 
+/*
+ * Mixes a paintbuffer full of random 8 and 16 bit samples
+ * for the given number of channels, once with the scalar
+ * loops and once with the vectorized ones, and prints how
+ * long it took. Also checks that both give the same result.
+ */
+void
+SDL_MixBench_f(void)
+{
+	const int count = SDL_PAINTBUFFER_SIZE;
+	portable_samplepair_t *mixed[2];
+	short *clipped[2];
+	unsigned char *data8;
+	signed short *data16;
+	int *vols;
+	int numchannels, runs;
+	int i, run, width, pass;
+	long long start, times[3][2];
+
+	numchannels = (Cmd_Argc() > 1) ? (int)strtol(Cmd_Argv(1), NULL, 10) : 32;
+	runs = (Cmd_Argc() > 2) ? (int)strtol(Cmd_Argv(2), NULL, 10) : 100;
+
+	if ((numchannels < 1) || (runs < 1))
+	{
+		Com_Printf("Usage: s_mixbench [channels] [runs]\n");
+		return;
+	}
+
+	SDL_UpdateScaletable();
+	snd_vol = (int)(s_volume->value * 256);
+
+	/* every channel starts at another sample */
+	data8 = Z_Malloc(count + numchannels);
+	data16 = Z_Malloc((count + numchannels) * sizeof(short));
+	vols = Z_Malloc(numchannels * 2 * sizeof(int));
+
+	for (i = 0; i < count + numchannels; i++)
+	{
+		data8[i] = randk() & 0xff;
+		data16[i] = randk() & 0xffff;
+	}
+
+	for (i = 0; i < numchannels * 2; i++)
+	{
+		vols[i] = randk() & 0xff;
+	}
+
+	for (i = 0; i < 2; i++)
+	{
+		mixed[i] = Z_Malloc(count * sizeof(portable_samplepair_t));
+		clipped[i] = Z_Malloc(count * 2 * sizeof(short));
+	}
+
+	memset(times, 0, sizeof(times));
+
+	for (run = 0; run < runs; run++)
+	{
+		for (width = 1; width <= 2; width++)
+		{
+			for (pass = 0; pass < 2; pass++)
+			{
+				portable_samplepair_t *samp = mixed[pass];
+				int done = 0;
+
+				memset(samp, 0, count * sizeof(portable_samplepair_t));
+				start = Sys_Microseconds();
+
+				for (i = 0; i < numchannels; i++)
+				{
+					int left = vols[i * 2], right = vols[i * 2 + 1];
+
+					if (width == 1)
+					{
+						const int *lscale = snd_scaletable[left >> 3];
+						const int *rscale = snd_scaletable[right >> 3];
+
+						if (pass)
+						{
+							done = SDL_MixVector8(samp, data8 + i, count,
+									lscale[1], rscale[1]);
+						}
+
+						SDL_MixScalar8(samp + done, data8 + i + done,
+								count - done, lscale, rscale);
+					}
+					else
+					{
+						left *= snd_vol;
+						right *= snd_vol;
+
+						if (pass)
+						{
+							done = SDL_MixVector16(samp, data16 + i, count,
+									left, right);
+						}
+
+						SDL_MixScalar16(samp + done, data16 + i + done,
+								count - done, left, right);
+					}
+				}
+
+				times[width - 1][pass] += Sys_Microseconds() - start;
+			}
+
+			if (memcmp(mixed[0], mixed[1], count * sizeof(portable_samplepair_t)))
+			{
+				Com_Printf("%i bit mixing gives different results!\n", width * 8);
+			}
+		}
+
+		for (pass = 0; pass < 2; pass++)
+		{
+			int done = 0;
+
+			start = Sys_Microseconds();
+
+			if (pass)
+			{
+				done = SDL_ClipVector16(clipped[pass], (int *)mixed[pass], count * 2);
+			}
+
+			SDL_ClipScalar16(clipped[pass] + done, (int *)mixed[pass] + done,
+					count * 2 - done);
+
+			times[2][pass] += Sys_Microseconds() - start;
+		}
+
+		if (memcmp(clipped[0], clipped[1], count * 2 * sizeof(short)))
+		{
+			Com_Printf("Clipping gives different results!\n");
+		}
+	}
+
+#ifdef SDL_MIX_NAME
+	Com_Printf("Mixing %i channels of %i samples, average of %i runs, "
+			"scalar / " SDL_MIX_NAME ":\n", numchannels, count, runs);
+#else
+	Com_Printf("Mixing %i channels of %i samples, average of %i runs, "
+			"no vectorized loops:\n", numchannels, count, runs);
+#endif
+	Com_Printf("  8 bit: %.1f / %.1f usec\n",
+			(double)times[0][0] / runs, (double)times[0][1] / runs);
+	Com_Printf(" 16 bit: %.1f / %.1f usec\n",
+			(double)times[1][0] / runs, (double)times[1][1] / runs);
+	Com_Printf("   clip: %.1f / %.1f usec\n",
+			(double)times[2][0] / runs, (double)times[2][1] / runs);
+
+	for (i = 0; i < 2; i++)
+	{
+		Z_Free(clipped[i]);
+		Z_Free(mixed[i]);
+	}
+
+	Z_Free(vols);
+	Z_Free(data16);
+	Z_Free(data8);
+}
+
 /*
  * Callback funktion for SDL. Writes
  * sound data to SDL when requested.
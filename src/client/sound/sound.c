@@ -209,32 +209,35 @@ S_IsSilencedMuzzleFlash(const wavinfo_t* info, const void* raw_data, const char*
 	return true;
 }
 
-static void
-S_LoadVorbis(const char *path, wavinfo_t *info, void **buffer)
+/*
+ * Builds the name of the ogg/vorbis
+ * replacement for the given sound
+ */
+static qboolean
+S_VorbisName(const char *path, char *filename, size_t size)
 {
 	const char ogg_ext[] = ".ogg";
-	char filename[MAX_QPATH];
 	const char* ext;
 	int	len;
 
 	if (!path)
 	{
-		return;
+		return false;
 	}
 
 	ext = COM_FileExtension(path);
 	if (!ext[0])
 	{
 		/* file has no extension */
-		return;
+		return false;
 	}
 
 	/* Remove the extension */
 	len = (ext - path) - 1;
-	if ((len < 1) || (len > sizeof(filename) - 5))
+	if ((len < 1) || (len > size - sizeof(ogg_ext)))
 	{
 		Com_DPrintf("%s: Bad filename %s\n", __func__, path);
-		return;
+		return false;
 	}
 
 	/* copy base path */
@@ -243,7 +246,20 @@ S_LoadVorbis(const char *path, wavinfo_t *info, void **buffer)
 	/* Add the extension */
 	memcpy(filename + len, ogg_ext, sizeof(ogg_ext));
 
-	OGG_LoadAsWav(filename, info, buffer);
+	return true;
+}
+
+static short *
+S_LoadVorbis(const char *path, wavinfo_t *info)
+{
+	char filename[MAX_QPATH];
+
+	if (!S_VorbisName(path, filename, sizeof(filename)))
+	{
+		return NULL;
+	}
+
+	return OGG_LoadAsWav(filename, info);
 }
 
 static void
@@ -435,36 +451,19 @@ S_GetStatistics(const byte *data, int sound_length, int width, int channels,
 }
 
 /*
- * Loads one sample into memory
+ * Builds the path of a sounds file,
+ * returns false for sexed sounds
  */
-sfxcache_t *
-S_LoadSound(sfx_t *s)
+static qboolean
+S_SoundPath(const sfx_t *s, char *namebuffer, size_t size)
 {
-	char namebuffer[MAX_QPATH];
-	byte *data = NULL;
-	wavinfo_t info;
-	sfxcache_t *sc;
-	double sound_volume = 0;
-	int begin_length = 0;
-	int attack_length = 0;
-	int fade_length = 0;
-	int end_length = 0;
-	char *name;
+	const char *name;
 
 	if (s->name[0] == '*')
 	{
-		return NULL;
-	}
-
-	/* see if still in memory */
-	sc = s->cache;
-
-	if (sc)
-	{
-		return sc;
+		return false;
 	}
 
-	/* load it */
 	if (s->truename)
 	{
 		name = s->truename;
@@ -477,80 +476,168 @@ S_LoadSound(sfx_t *s)
 
 	if (name[0] == '#')
 	{
-		Q_strlcpy(namebuffer, &name[1], sizeof(namebuffer));
+		Q_strlcpy(namebuffer, &name[1], size);
 	}
 	else
 	{
-		Com_sprintf(namebuffer, sizeof(namebuffer), "sound/%s", name);
+		Com_sprintf(namebuffer, size, "sound/%s", name);
 	}
 
-	S_LoadVorbis(namebuffer, &info, (void **)&data);
+	return true;
+}
 
-	// can't load ogg file
-	if (!data)
-	{
-		int size = FS_LoadFile(namebuffer, (void **)&data);
+/* What S_AnalyzeSound() found out about a sample. */
+typedef struct
+{
+	qboolean silenced;
+	double volume;
+	int begin_length;
+	int attack_length;
+	int fade_length;
+	int end_length;
+} sfxstats_t;
 
-		if (data)
-		{
-			info = GetWavinfo(s->name, data, size);
-		}
-	}
+/*
+ * Analyzes decoded sample data. Touches
+ * nothing else, so it may run on the
+ * worker threads.
+ */
+static void
+S_AnalyzeSound(const char *namebuffer, const wavinfo_t *info, const byte *data,
+		sfxstats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
 
-	if (!data)
+	/* S_UploadSound() complains */
+	if (info->channels < 1 || info->channels > 2)
 	{
-		s->cache = NULL;
-		Com_DPrintf("Couldn't load %s\n", namebuffer);
-		return NULL;
+		return;
 	}
 
+	stats->silenced = S_IsSilencedMuzzleFlash(info, data, namebuffer);
+
+	S_GetVolume(data + info->dataofs, info->samples,
+		info->width, &stats->volume);
+
+	S_GetStatistics(data + info->dataofs, info->samples,
+		info->width, info->channels, stats->volume, &stats->begin_length,
+		&stats->end_length, &stats->attack_length, &stats->fade_length);
+}
+
+/*
+ * Hands analyzed sample
+ * data to the sound backend
+ */
+static sfxcache_t *
+S_UploadSound(sfx_t *s, wavinfo_t *info, byte *data, const sfxstats_t *stats)
+{
+	sfxcache_t *sc = NULL;
+
 	/*
 	Com_Printf("%s: rate:%d\n\twidth:%d\n\tchannels:%d\n\tloopstart:%d\n\tsamples:%d\n\tdataofs:%d\n",
-		s->name, info.rate, info.width, info.channels, info.loopstart, info.samples, info.dataofs);
+		s->name, info->rate, info->width, info->channels, info->loopstart, info->samples, info->dataofs);
 	*/
 
-	if (info.channels < 1 || info.channels > 2)
+	if (info->channels < 1 || info->channels > 2)
 	{
 		Com_Printf("%s has an invalid number of channels\n", s->name);
-		FS_FreeFile(data);
 		return NULL;
 	}
 
-	if (S_IsSilencedMuzzleFlash(&info, data, namebuffer))
+	if (stats->silenced)
 	{
 		s->is_silenced_muzzle_flash = true;
 	}
 
-	S_GetVolume(data + info.dataofs, info.samples,
-		info.width, &sound_volume);
-
-	S_GetStatistics(data + info.dataofs, info.samples,
-		info.width, info.channels, sound_volume, &begin_length, &end_length,
-		&attack_length, &fade_length);
-
 #if USE_OPENAL
 	if (sound_started == SS_OAL)
 	{
-		sc = AL_UploadSfx(s, &info, data + info.dataofs, sound_volume,
-						  begin_length, end_length,
-						  attack_length, fade_length);
+		sc = AL_UploadSfx(s, info, data + info->dataofs, stats->volume,
+						  stats->begin_length, stats->end_length,
+						  stats->attack_length, stats->fade_length);
 	}
 	else
 #endif
 	{
 		if (sound_started == SS_SDL)
 		{
-			if (!SDL_Cache(s, &info, data + info.dataofs, sound_volume,
-						  begin_length, end_length,
-						  attack_length, fade_length))
+			if (!SDL_Cache(s, info, data + info->dataofs, stats->volume,
+						  stats->begin_length, stats->end_length,
+						  stats->attack_length, stats->fade_length))
 			{
 				Com_Printf("Pansen!\n");
-				FS_FreeFile(data);
 				return NULL;
 			}
 		}
 	}
 
+	return sc;
+}
+
+/*
+ * Analyzes decoded sample data and
+ * hands it to the sound backend
+ */
+static sfxcache_t *
+S_CacheSound(sfx_t *s, const char *namebuffer, wavinfo_t *info, byte *data)
+{
+	sfxstats_t stats;
+
+	S_AnalyzeSound(namebuffer, info, data, &stats);
+
+	return S_UploadSound(s, info, data, &stats);
+}
+
+/*
+ * Loads one sample into memory
+ */
+sfxcache_t *
+S_LoadSound(sfx_t *s)
+{
+	char namebuffer[MAX_QPATH];
+	byte *data = NULL;
+	short *samples;
+	wavinfo_t info;
+	sfxcache_t *sc;
+	int size;
+
+	/* see if still in memory */
+	sc = s->cache;
+
+	if (sc)
+	{
+		return sc;
+	}
+
+	/* load it */
+	if (!S_SoundPath(s, namebuffer, sizeof(namebuffer)))
+	{
+		return NULL;
+	}
+
+	samples = S_LoadVorbis(namebuffer, &info);
+
+	if (samples)
+	{
+		sc = S_CacheSound(s, namebuffer, &info, (byte *)samples);
+		free(samples);
+
+		return sc;
+	}
+
+	// can't load ogg file
+	size = FS_LoadFile(namebuffer, (void **)&data);
+
+	if (!data)
+	{
+		s->cache = NULL;
+		Com_DPrintf("Couldn't load %s\n", namebuffer);
+		return NULL;
+	}
+
+	info = GetWavinfo(s->name, data, size);
+	sc = S_CacheSound(s, namebuffer, &info, data);
+
 	FS_FreeFile(data);
 	return sc;
 }
@@ -838,6 +925,150 @@ S_HasFreeSpace(void)
 	return (num_sfx + used) < MAX_SFX;
 }
 
+/* Number of sounds decoded in parallel at once. */
+#define MAX_PREFETCH 64
+
+typedef struct
+{
+	sfx_t *sfx;
+	qboolean *done;
+	char name[MAX_QPATH];
+	byte *file;
+	int filesize;
+	qboolean ogg;
+	short *samples;    /* decoded ogg/vorbis */
+	wavinfo_t info;
+	sfxstats_t stats;
+} sfxprefetch_t;
+
+static void
+S_DecodeJob(void *data, int index)
+{
+	sfxprefetch_t *p = (sfxprefetch_t *)data + index;
+
+	if (p->ogg)
+	{
+		p->samples = OGG_DecodeMemory(p->file, p->filesize, &p->info);
+
+		if (p->samples)
+		{
+			S_AnalyzeSound(p->name, &p->info, (byte *)p->samples, &p->stats);
+		}
+	}
+	else
+	{
+		S_AnalyzeSound(p->name, &p->info, p->file, &p->stats);
+	}
+}
+
+/*
+ * Decodes and analyzes a batch of sounds on
+ * the worker threads. The files are read and
+ * the results uploaded here, in the main thread.
+ */
+static void
+S_PrefetchBatch(sfxprefetch_t *batch, int count)
+{
+	int i;
+
+	Jobs_Run(S_DecodeJob, batch, count);
+
+	for (i = 0; i < count; i++)
+	{
+		sfxprefetch_t *p = &batch[i];
+
+		if (p->samples)
+		{
+			S_UploadSound(p->sfx, &p->info, (byte *)p->samples, &p->stats);
+			free(p->samples);
+		}
+		else if (!p->ogg)
+		{
+			S_UploadSound(p->sfx, &p->info, p->file, &p->stats);
+		}
+
+		/* Broken ogg/vorbis files fall back to wav
+		   in S_LoadSound(), broken wav files don't
+		   need to be loaded twice. */
+		*p->done = (p->samples || !p->ogg);
+
+		FS_FreeFile(p->file);
+	}
+}
+
+/*
+ * Loads all sounds of the registration sequence
+ * in parallel, done is set for those that don't
+ * need to be loaded again. Anything that isn't
+ * done afterwards is loaded the usual way.
+ */
+static void
+S_PrefetchSounds(qboolean *done)
+{
+	sfxprefetch_t batch[MAX_PREFETCH];
+	char filename[MAX_QPATH];
+	sfxprefetch_t *p;
+	int count = 0;
+	int i;
+	sfx_t *sfx;
+
+	if (!Jobs_NumWorkers())
+	{
+		return;
+	}
+
+	for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++)
+	{
+		if (!sfx->name[0] || sfx->cache)
+		{
+			continue;
+		}
+
+		p = &batch[count];
+		memset(p, 0, sizeof(*p));
+
+		if (!S_SoundPath(sfx, p->name, sizeof(p->name)))
+		{
+			continue;
+		}
+
+		/* ogg/vorbis first, like S_LoadSound() */
+		if (S_VorbisName(p->name, filename, sizeof(filename)))
+		{
+			p->filesize = FS_LoadFile(filename, (void **)&p->file);
+			p->ogg = (p->file != NULL);
+		}
+
+		if (!p->file)
+		{
+			p->filesize = FS_LoadFile(p->name, (void **)&p->file);
+
+			if (!p->file)
+			{
+				continue;
+			}
+
+			/* Just the header, the samples are
+			   analyzed on the workers. */
+			p->info = GetWavinfo(sfx->name, p->file, p->filesize);
+		}
+
+		p->sfx = sfx;
+		p->done = &done[i];
+
+		if (++count == MAX_PREFETCH)
+		{
+			S_PrefetchBatch(batch, count);
+			count = 0;
+		}
+	}
+
+	if (count)
+	{
+		S_PrefetchBatch(batch, count);
+	}
+}
+
 /*
  * Called after registering of
  * sound has ended
@@ -845,6 +1076,7 @@ S_HasFreeSpace(void)
 void
 S_EndRegistration(void)
 {
+	qboolean done[MAX_SFX] = {false};
 	int i;
 	sfx_t *sfx;
 
@@ -878,9 +1110,11 @@ S_EndRegistration(void)
 	}
 
 	/* load everything in */
+	S_PrefetchSounds(done);
+
 	for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++)
 	{
-		if (!sfx->name[0])
+		if (!sfx->name[0] || done[i])
 		{
 			continue;
 		}
@@ -1680,6 +1914,7 @@ S_Init(void)
 	Cmd_AddCommand("stopsound", S_StopAllSounds);
 	Cmd_AddCommand("soundlist", S_SoundList);
 	Cmd_AddCommand("soundinfo", S_SoundInfo_f);
+	Cmd_AddCommand("s_mixbench", SDL_MixBench_f);
 
 #if USE_OPENAL
 	cv = Cvar_Get("s_openal", "1", CVAR_ARCHIVE);
@@ -1781,6 +2016,7 @@ S_Shutdown(void)
 
 	Cmd_RemoveCommand("soundlist");
 	Cmd_RemoveCommand("soundinfo");
+	Cmd_RemoveCommand("s_mixbench");
 	Cmd_RemoveCommand("play");
 	Cmd_RemoveCommand("stopsound");
 }
@@ -124,7 +124,7 @@ typedef enum {
 	RESTART_PARTIAL
 } ref_restart_t;
 
-#define	API_VERSION		8
+#define	API_VERSION		9
 #define EXPORT
 #define IMPORT
 
@@ -258,6 +258,11 @@ typedef struct
 	qboolean	(IMPORT *GLimp_GetDesktopMode)(int *pwidth, int *pheight);
 
 	void		(IMPORT *Vid_RequestRestart)(ref_restart_t rs);
+
+	// runs func(data, i) for i in 0..count-1 on the engines worker threads
+	// and returns once all calls are done. see Jobs_Run() in common.h
+	void		(IMPORT *Jobs_Run)(void (*func)(void *data, int index), void *data, int count);
+	int		(IMPORT *Jobs_NumWorkers)(void);
 } refimport_t;
 
 // this is the only function actually exported at the linker level
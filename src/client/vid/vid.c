@@ -452,6 +452,8 @@ VID_LoadRenderer(void)
 	ri.Vid_MenuInit = VID_MenuInit;
 	ri.Vid_WriteScreenshot = VID_WriteScreenshot;
 	ri.Vid_RequestRestart = VID_RequestRestart;
+	ri.Jobs_Run = Jobs_Run;
+	ri.Jobs_NumWorkers = Jobs_NumWorkers;
 
 	// Exchange our export struct with the renderers import struct.
 	re = GetRefAPI(ri);
@@ -164,7 +164,16 @@ Com_VPrintf(int print_level, const char *fmt, va_list argptr)
 
 			if (!logfile)
 			{
-				Com_sprintf(name, sizeof(name), "%s/qconsole.log", FS_Gamedir());
+				int instance = Cvar_VariableValue("sv_instance");
+
+				if (instance)
+				{
+					Com_sprintf(name, sizeof(name), "%s/qconsole%i.log", FS_Gamedir(), instance);
+				}
+				else
+				{
+					Com_sprintf(name, sizeof(name), "%s/qconsole.log", FS_Gamedir());
+				}
 
 				if (logfile_active->value > 2)
 				{
@@ -33,22 +33,31 @@
 #define MAX_ALIAS_NAME 32
 #define ALIAS_LOOP_COUNT 16
 
+/* Commands and aliases are matched case insensitive,
+   so are their hashes. */
+#define CMD_HASH_SIZE 512
+
 typedef struct cmd_function_s
 {
 	struct cmd_function_s *next;
+	struct cmd_function_s *hash_next;
 	const char *name;
 	xcommand_t function;
 } cmd_function_t;
 
 static cmd_function_t *cmd_functions; /* possible commands to execute */
+static cmd_function_t *cmd_hash[CMD_HASH_SIZE];
 
 typedef struct cmdalias_s
 {
 	struct cmdalias_s *next;
+	struct cmdalias_s *hash_next;
 	char name[MAX_ALIAS_NAME];
 	char *value;
 } cmdalias_t;
 
+static cmdalias_t *alias_hash[CMD_HASH_SIZE];
+
 char retval[256];
 int alias_count; /* for detecting runaway loops */
 cmdalias_t *cmd_alias;
@@ -61,6 +70,48 @@ sizebuf_t cmd_text;
 byte cmd_text_buf[32768];
 char defer_text_buf[32768];
 
+/*
+ * Looks up a command. Exact matches are needed to add and
+ * remove commands, execution ignores the case.
+ */
+static cmd_function_t *
+Cmd_FindCommand(const char *cmd_name, qboolean nocase)
+{
+	cmd_function_t *cmd;
+
+	cmd = cmd_hash[Q_strhash(cmd_name) & (CMD_HASH_SIZE - 1)];
+
+	for ( ; cmd; cmd = cmd->hash_next)
+	{
+		if (nocase ? !Q_strcasecmp(cmd_name, cmd->name) :
+			!strcmp(cmd_name, cmd->name))
+		{
+			return cmd;
+		}
+	}
+
+	return NULL;
+}
+
+static cmdalias_t *
+Cmd_FindAlias(const char *alias_name, qboolean nocase)
+{
+	cmdalias_t *a;
+
+	a = alias_hash[Q_strhash(alias_name) & (CMD_HASH_SIZE - 1)];
+
+	for ( ; a; a = a->hash_next)
+	{
+		if (nocase ? !Q_strcasecmp(alias_name, a->name) :
+			!strcmp(alias_name, a->name))
+		{
+			return a;
+		}
+	}
+
+	return NULL;
+}
+
 /*
  * Causes execution of the remainder of the command buffer to be delayed
  * until next frame.  This allows commands like: bind g "impulse 5 ;
@@ -391,6 +442,59 @@ Cmd_Exec_f(void)
 	FS_FreeFile(f);
 }
 
+/*
+ * Benchmark for the command and cvar lookups: Executes
+ * a script file several times in a row and prints how
+ * long it took. The rest of the command buffer is put
+ * aside while the file runs.
+ */
+static void
+Cmd_TimeExec_f(void)
+{
+	char *f;
+	char name[MAX_QPATH];
+	int len, i, count;
+	long long start, time;
+
+	if ((Cmd_Argc() < 2) || (Cmd_Argc() > 3))
+	{
+		Com_Printf("timeexec <filename> [count] : time the execution of a script file\n");
+		return;
+	}
+
+	Q_strlcpy(name, Cmd_Argv(1), sizeof(name));
+	count = (Cmd_Argc() == 3) ? Q_max(atoi(Cmd_Argv(2)), 1) : 1;
+
+	len = FS_LoadFile2(name, (void **)&f, 2);
+
+	if (!f)
+	{
+		Com_Printf("couldn't exec %s\n", name);
+		return;
+	}
+
+	f[len] = '\n';
+	f[len+1] = '\0';
+
+	Cbuf_CopyToDefer();
+
+	start = Sys_Microseconds();
+
+	for (i = 0; i < count; i++)
+	{
+		Cbuf_AddText(f);
+		Cbuf_Execute();
+	}
+
+	time = Sys_Microseconds() - start;
+
+	Cbuf_InsertFromDefer();
+	FS_FreeFile(f);
+
+	Com_Printf("%s: %i runs, %.3f ms, %.3f ms per run\n", name, count,
+			time / 1000.0, time / 1000.0 / count);
+}
+
 /*
  * Inserts the current value of a variable as command text
  */
@@ -457,20 +561,21 @@ Cmd_Alias_f(void)
 	}
 
 	/* if the alias already exists, reuse it */
-	for (a = cmd_alias; a; a = a->next)
+	a = Cmd_FindAlias(s, false);
+
+	if (a)
 	{
-		if (!strcmp(s, a->name))
-		{
-			Z_Free(a->value);
-			break;
-		}
+		Z_Free(a->value);
 	}
-
-	if (!a)
+	else
 	{
+		unsigned int hash = Q_strhash(s) & (CMD_HASH_SIZE - 1);
+
 		a = Z_Malloc(sizeof(cmdalias_t));
 		a->next = cmd_alias;
 		cmd_alias = a;
+		a->hash_next = alias_hash[hash];
+		alias_hash[hash] = a;
 	}
 
 	strcpy(a->name, s);
@@ -704,6 +809,7 @@ Cmd_AddCommand(const char *cmd_name, xcommand_t function)
 {
 	cmd_function_t *cmd;
 	cmd_function_t **pos;
+	unsigned int hash;
 
 	/* fail if the command is a variable name */
 	if (Cvar_VariableString(cmd_name)[0])
@@ -712,19 +818,20 @@ Cmd_AddCommand(const char *cmd_name, xcommand_t function)
 	}
 
 	/* fail if the command already exists */
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
+	if (Cmd_FindCommand(cmd_name, false))
 	{
-		if (!strcmp(cmd_name, cmd->name))
-		{
-			Com_Printf("Cmd_AddCommand: %s already defined\n", cmd_name);
-			return;
-		}
+		Com_Printf("Cmd_AddCommand: %s already defined\n", cmd_name);
+		return;
 	}
 
 	cmd = Z_Malloc(sizeof(cmd_function_t));
 	cmd->name = cmd_name;
 	cmd->function = function;
 
+	hash = Q_strhash(cmd_name) & (CMD_HASH_SIZE - 1);
+	cmd->hash_next = cmd_hash[hash];
+	cmd_hash[hash] = cmd;
+
 	/* link the command in */
 	pos = &cmd_functions;
 	while (*pos && strcmp((*pos)->name, cmd->name) < 0)
@@ -755,28 +862,27 @@ Cmd_RemoveCommand(const char *cmd_name)
 		if (!strcmp(cmd_name, cmd->name))
 		{
 			*back = cmd->next;
-			Z_Free(cmd);
-			return;
+			break;
 		}
 
 		back = &cmd->next;
 	}
-}
 
-qboolean
-Cmd_Exists(const char *cmd_name)
-{
-	cmd_function_t *cmd;
+	back = &cmd_hash[Q_strhash(cmd_name) & (CMD_HASH_SIZE - 1)];
 
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
+	while (*back != cmd)
 	{
-		if (!strcmp(cmd_name, cmd->name))
-		{
-			return true;
-		}
+		back = &(*back)->hash_next;
 	}
 
-	return false;
+	*back = cmd->hash_next;
+	Z_Free(cmd);
+}
+
+qboolean
+Cmd_Exists(const char *cmd_name)
+{
+	return Cmd_FindCommand(cmd_name, false) != NULL;
 }
 
 const char *
@@ -1035,25 +1141,12 @@ Cmd_CompleteMapCommand(const char *partial)
 qboolean
 Cmd_IsComplete(const char *command)
 {
-	cmd_function_t *cmd;
-	cmdalias_t *a;
 	cvar_t *cvar;
 
 	/* check for exact match */
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
-	{
-		if (!strcmp(command, cmd->name))
-		{
-			return true;
-		}
-	}
-
-	for (a = cmd_alias; a; a = a->next)
+	if (Cmd_FindCommand(command, false) || Cmd_FindAlias(command, false))
 	{
-		if (!strcmp(command, a->name))
-		{
-			return true;
-		}
+		return true;
 	}
 
 	for (cvar = cvar_vars; cvar; cvar = cvar->next)
@@ -1094,38 +1187,36 @@ Cmd_ExecuteString(char *text)
 	}
 
 	/* check functions */
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
+	cmd = Cmd_FindCommand(cmd_argv[0], true);
+
+	if (cmd)
 	{
-		if (!Q_strcasecmp(cmd_argv[0], cmd->name))
+		if (!cmd->function)
 		{
-			if (!cmd->function)
-			{
-				/* forward to server command */
-				Cmd_ExecuteString(va("cmd %s", text));
-			}
-			else
-			{
-				cmd->function();
-			}
-
-			return;
+			/* forward to server command */
+			Cmd_ExecuteString(va("cmd %s", text));
+		}
+		else
+		{
+			cmd->function();
 		}
+
+		return;
 	}
 
 	/* check alias */
-	for (a = cmd_alias; a; a = a->next)
+	a = Cmd_FindAlias(cmd_argv[0], true);
+
+	if (a)
 	{
-		if (!Q_strcasecmp(cmd_argv[0], a->name))
+		if (++alias_count == ALIAS_LOOP_COUNT)
 		{
-			if (++alias_count == ALIAS_LOOP_COUNT)
-			{
-				Com_Printf("ALIAS_LOOP_COUNT\n");
-				return;
-			}
-
-			Cbuf_InsertText(a->value);
+			Com_Printf("ALIAS_LOOP_COUNT\n");
 			return;
 		}
+
+		Cbuf_InsertText(a->value);
+		return;
 	}
 
 	/* check cvars */
@@ -1162,6 +1253,7 @@ Cmd_Init(void)
 	/* register our commands */
 	Cmd_AddCommand("cmdlist", Cmd_List_f);
 	Cmd_AddCommand("exec", Cmd_Exec_f);
+	Cmd_AddCommand("timeexec", Cmd_TimeExec_f);
 	Cmd_AddCommand("vstr", Cmd_Vstr_f);
 	Cmd_AddCommand("echo", Cmd_Echo_f);
 	Cmd_AddCommand("alias", Cmd_Alias_f);
@@ -1180,4 +1272,6 @@ Cmd_Shutdown(void)
 		Z_Free(cmd_alias);
 		cmd_alias = next;
 	}
+
+	memset(alias_hash, 0, sizeof(alias_hash));
 }
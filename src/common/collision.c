@@ -25,14 +25,26 @@
  * =======================================================================
  */
 
+#include <float.h>
 #include <stdint.h>
 
 #include "header/common.h"
 
+/* Vectorized brush clipping. It must give the same results as
+   the scalar loop, so floats have to be evaluated as floats. */
+#if (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))) && \
+	(!defined(FLT_EVAL_METHOD) || (FLT_EVAL_METHOD == 0))
+#include <emmintrin.h>
+#define CM_SIDES_SSE2
+#endif
+
+/* Nodes carry a copy of their plane, so walking the tree only
+   touches this array. 32 bytes, two nodes per cache line. */
 typedef struct
 {
-	cplane_t	*plane;
+	cplane_t	plane;
 	int			children[2]; /* negative numbers are leafs */
+	int			pad;
 } cnode_t;
 
 typedef struct
@@ -55,9 +67,26 @@ typedef struct
 	int			contents;
 	unsigned int			numsides;
 	unsigned int			firstbrushside;
-	int			checkcount;	/* to avoid repeated testings */
+	unsigned int			firstsides4;   /* in map_brushsides4 */
 } cbrush_t;
 
+/* The planes of four sides of a brush, for clipping four sides at
+   once. The sides of each brush start a new group, unused lanes
+   are zero. */
+typedef struct
+{
+	float normal[3][4];
+	float dist[4];
+} cbrushsides4_t;
+
+/* what the sides of a brush tell about a move */
+typedef struct
+{
+	float enterfrac, leavefrac;
+	const cbrushside_t *leadside;
+	qboolean getout, startout;
+} brushclip_t;
+
 typedef struct
 {
 	int		numareaportals;
@@ -67,33 +96,36 @@ typedef struct
 } carea_t;
 
 static byte *cmod_base;
-static byte map_visibility[MAX_MAP_VISIBILITY];
+static byte *map_visibility;
 // DG: is casted to int32_t* in SV_FatPVS() so align accordingly
 static YQ2_ALIGNAS_TYPE(int32_t) byte pvsrow[MAX_MAP_LEAFS / 8];
 static byte phsrow[MAX_MAP_LEAFS / 8];
+static YQ2_ALIGNAS_TYPE(int32_t) byte nullrow[MAX_MAP_LEAFS / 8];
 static carea_t	map_areas[MAX_MAP_AREAS];
-static cbrush_t map_brushes[MAX_MAP_BRUSHES];
-static cbrushside_t map_brushsides[MAX_MAP_BRUSHSIDES];
+static cbrush_t *map_brushes;
+static cbrushside_t *map_brushsides;
+static cbrushsides4_t *map_brushsides4;
+static cbrushsides4_t *box_sides4; /* the two groups of the box hull */
+static qboolean cm_simd = true;    /* clip four sides at a time */
+static int numbrushsides4;
 static char map_name[MAX_QPATH];
 static char map_entitystring[MAX_MAP_ENTSTRING];
-static cbrush_t *box_brush;
-static cleaf_t *box_leaf;
-static cleaf_t	map_leafs[MAX_MAP_LEAFS];
-static cmodel_t map_cmodels[MAX_MAP_MODELS];
-static cnode_t	map_nodes[MAX_MAP_NODES+6]; /* extra for box hull */
-static cplane_t *box_planes;
-static cplane_t map_planes[MAX_MAP_PLANES+12]; /* extra for box hull */
+static cleaf_t nullleaf;
+static cleaf_t	*map_leafs = &nullleaf;
+static cmodel_t nullcmodel;
+static cmodel_t *map_cmodels = &nullcmodel;
+static cnode_t	*map_nodes; /* extra 6 for box hull */
+static cplane_t box_planes[12];
+static cplane_t *map_planes;
 static cvar_t *map_noareas;
-static dareaportal_t map_areaportals[MAX_MAP_AREAPORTALS];
-static dvis_t *map_vis = (dvis_t *)map_visibility;
+static cvar_t *cm_viscache;
+static cvar_t *cm_cachemaps;
+static cvar_t *cm_tracecache;
+static dareaportal_t *map_areaportals;
+static dvis_t *map_vis;
 static int box_headnode;
-static int checkcount;
 static int emptyleaf, solidleaf;
 static int floodvalid;
-static float *leaf_mins, *leaf_maxs;
-static int leaf_count, leaf_maxcount;
-static int *leaf_list;
-static int leaf_topnode;
 static int numareaportals;
 static int numareas = 1;
 static int numbrushes;
@@ -107,17 +139,13 @@ static int numnodes;
 static int numplanes;
 int numtexinfo;
 static int numvisibility;
-static int trace_contents;
-mapsurface_t map_surfaces[MAX_MAP_TEXINFO];
+mapsurface_t *map_surfaces;
 static mapsurface_t nullsurface;
 static qboolean portalopen[MAX_MAP_AREAPORTALS];
-static qboolean trace_ispoint; /* optimized case */
-static trace_t trace_trace;
-static unsigned short map_leafbrushes[MAX_MAP_LEAFBRUSHES];
-static vec3_t trace_start, trace_end;
-static vec3_t trace_mins, trace_maxs;
-static vec3_t trace_extents;
+static unsigned short *map_leafbrushes;
 
+/* Statistics for showtrace, only touched by the main thread.
+   Traces count in their context first, see CM_AddTraceStats(). */
 #ifndef DEDICATED_ONLY
 int		c_pointcontents;
 int		c_traces, c_brush_traces;
@@ -126,6 +154,67 @@ int		c_traces, c_brush_traces;
 /* 1/32 epsilon to keep floating point happy */
 #define DIST_EPSILON (0.03125f)
 
+/* Decompressed PVS and PHS rows. Rows are filled the first
+   time a cluster is asked for and stay valid until the next
+   map is loaded. Each row starts on a 16 byte boundary, so
+   callers can process them in int32_t or wider chunks. */
+#define VISCACHE_ALIGN 16
+
+static byte *viscache_base;
+static byte *viscache_rows[2];
+static byte *viscache_valid[2];
+static size_t viscache_rowbytes;
+
+/* Collision models of recently used maps, so going back to
+   a map doesn't parse it again. The hull data of a map sits
+   in one cache line aligned block, which isn't written to
+   after the map was loaded. The statics above point into the
+   block of the map in use. */
+#define CMCACHE_ALIGN 64
+#define CMCACHE_MAX 16
+
+typedef struct
+{
+	char name[MAX_QPATH];
+	int length;          /* of the bsp, to notice changed files */
+	unsigned checksum;   /* of the whole bsp, the same */
+	int lastused;
+
+	byte *base;          /* the block, unaligned */
+	size_t size;
+
+	cplane_t *planes;
+	cnode_t *nodes;
+	cleaf_t *leafs;
+	cbrush_t *brushes;
+	cbrushside_t *brushsides;
+	cbrushsides4_t *brushsides4; /* not in the block, owned by the slot */
+	unsigned short *leafbrushes;
+	cmodel_t *cmodels;
+	mapsurface_t *surfaces;
+	dareaportal_t *areaportals;
+	byte *visibility;
+
+	/* Copied back into map_areas, which is written to.
+	   The entity string isn't kept, an .ent file may
+	   have changed. */
+	carea_t *areas;
+
+	int numplanes, numnodes, numleafs, numbrushes, numbrushsides;
+	int numbrushsides4;
+	int numleafbrushes, numcmodels, numtexinfo, numareas;
+	int numareaportals, numvisibility;
+	int numclusters, emptyleaf;
+
+	byte *viscache_base;
+	byte *viscache_rows[2];
+	byte *viscache_valid[2];
+	size_t viscache_rowbytes;
+} cmcache_t;
+
+static cmcache_t cmcache[CMCACHE_MAX];
+static int cmcache_time;
+
 static void
 FloodArea_r(carea_t *area, int floodnum)
 {
@@ -321,11 +410,12 @@ CM_HeadnodeVisible(int nodenum, const byte *visbits)
 static void
 CM_InitBoxHull(void)
 {
+	cbrush_t *box_brush;
+	cleaf_t *box_leaf;
 	cplane_t *p;
 	int i;
 
 	box_headnode = numnodes;
-	box_planes = &map_planes[numplanes];
 
 	if ((numnodes + 6 > MAX_MAP_NODES) ||
 		(numbrushes + 1 > MAX_MAP_BRUSHES) ||
@@ -339,8 +429,12 @@ CM_InitBoxHull(void)
 	box_brush = &map_brushes[numbrushes];
 	box_brush->numsides = 6;
 	box_brush->firstbrushside = numbrushsides;
+	box_brush->firstsides4 = numbrushsides4 - 2;
 	box_brush->contents = CONTENTS_MONSTER;
 
+	box_sides4 = &map_brushsides4[box_brush->firstsides4];
+	memset(box_sides4, 0, 2 * sizeof(cbrushsides4_t));
+
 	box_leaf = &map_leafs[numleafs];
 	box_leaf->contents = CONTENTS_MONSTER;
 	box_leaf->firstleafbrush = numleafbrushes;
@@ -358,12 +452,11 @@ CM_InitBoxHull(void)
 
 		/* brush sides */
 		s = &map_brushsides[numbrushsides + i];
-		s->plane = map_planes + (numplanes + i * 2 + side);
+		s->plane = box_planes + (i * 2 + side);
 		s->surface = &nullsurface;
 
 		/* nodes */
 		c = &map_nodes[box_headnode + i];
-		c->plane = map_planes + (numplanes + i * 2);
 		c->children[side] = -1 - emptyleaf;
 
 		if (i != 5)
@@ -388,6 +481,17 @@ CM_InitBoxHull(void)
 		p->signbits = 0;
 		VectorClear(p->normal);
 		p->normal[i >> 1] = -1;
+
+		c->plane = box_planes[i * 2];
+	}
+
+	for (i = 0; i < 6; i++)
+	{
+		p = map_brushsides[numbrushsides + i].plane;
+
+		box_sides4[i >> 2].normal[0][i & 3] = p->normal[0];
+		box_sides4[i >> 2].normal[1][i & 3] = p->normal[1];
+		box_sides4[i >> 2].normal[2][i & 3] = p->normal[2];
 	}
 }
 
@@ -411,6 +515,19 @@ CM_HeadnodeForBox(vec3_t mins, vec3_t maxs)
 	box_planes[10].dist = mins[2];
 	box_planes[11].dist = -mins[2];
 
+	/* the nodes and the side groups have copies of the planes */
+	if (box_sides4)
+	{
+		int i;
+
+		for (i = 0; i < 6; i++)
+		{
+			map_nodes[box_headnode + i].plane.dist = box_planes[i * 2].dist;
+			box_sides4[i >> 2].dist[i & 3] =
+				map_brushsides[map_brushes[numbrushes].firstbrushside + i].plane->dist;
+		}
+	}
+
 	return box_headnode;
 }
 
@@ -418,13 +535,13 @@ static int
 CM_PointLeafnum_r(const vec3_t p, int num)
 {
 	float d;
-	cnode_t *node;
-	cplane_t *plane;
+	const cnode_t *node;
+	const cplane_t *plane;
 
 	while (num >= 0)
 	{
 		node = map_nodes + num;
-		plane = node->plane;
+		plane = &node->plane;
 
 		if (plane->type < 3)
 		{
@@ -465,32 +582,52 @@ CM_PointLeafnum(const vec3_t p)
 	return CM_PointLeafnum_r(p, 0);
 }
 
+/* state of CM_BoxLeafnums_r() */
+typedef struct
+{
+	const float *mins, *maxs;
+	int *list;
+	int count, maxcount;
+	int topnode;
+} leafwalk_t;
+
+/* nodes waiting to be walked. Deeper trees fall back to recursion. */
+#define WALKSTACK_SIZE 64
+
 /*
  * Fills in a list of all the leafs touched
  */
 static void
-CM_BoxLeafnums_r(int nodenum)
+CM_BoxLeafnums_r(leafwalk_t *walk, int nodenum)
 {
+	int stack[WALKSTACK_SIZE];
+	int depth = 0;
+
 	while (1)
 	{
-		cplane_t *plane;
-		cnode_t *node;
+		const cplane_t *plane;
+		const cnode_t *node;
 		int s;
 
 		if (nodenum < 0)
 		{
-			if (leaf_count >= leaf_maxcount)
+			if (walk->count < walk->maxcount)
+			{
+				walk->list[walk->count++] = -1 - nodenum;
+			}
+
+			if (!depth)
 			{
 				return;
 			}
 
-			leaf_list[leaf_count++] = -1 - nodenum;
-			return;
+			nodenum = stack[--depth];
+			continue;
 		}
 
 		node = &map_nodes[nodenum];
-		plane = node->plane;
-		s = BOX_ON_PLANE_SIDE(leaf_mins, leaf_maxs, plane);
+		plane = &node->plane;
+		s = BOX_ON_PLANE_SIDE(walk->mins, walk->maxs, plane);
 
 		if (s == 1)
 		{
@@ -504,38 +641,49 @@ CM_BoxLeafnums_r(int nodenum)
 
 		else
 		{
-			/* go down both */
-			if (leaf_topnode == -1)
+			/* go down both, the front first */
+			if (walk->topnode == -1)
 			{
-				leaf_topnode = nodenum;
+				walk->topnode = nodenum;
 			}
 
-			CM_BoxLeafnums_r(node->children[0]);
-			nodenum = node->children[1];
+			if (depth < WALKSTACK_SIZE)
+			{
+				stack[depth++] = node->children[1];
+				nodenum = node->children[0];
+			}
+
+			else
+			{
+				CM_BoxLeafnums_r(walk, node->children[0]);
+				nodenum = node->children[1];
+			}
 		}
 	}
 }
 
 static int
-CM_BoxLeafnums_headnode(vec3_t mins, vec3_t maxs, int *list,
+CM_BoxLeafnums_headnode(const vec3_t mins, const vec3_t maxs, int *list,
 		int listsize, int headnode, int *topnode)
 {
-	leaf_list = list;
-	leaf_count = 0;
-	leaf_maxcount = listsize;
-	leaf_mins = mins;
-	leaf_maxs = maxs;
+	leafwalk_t walk;
 
-	leaf_topnode = -1;
+	walk.list = list;
+	walk.count = 0;
+	walk.maxcount = listsize;
+	walk.mins = mins;
+	walk.maxs = maxs;
 
-	CM_BoxLeafnums_r(headnode);
+	walk.topnode = -1;
+
+	CM_BoxLeafnums_r(&walk, headnode);
 
 	if (topnode)
 	{
-		*topnode = leaf_topnode;
+		*topnode = walk.topnode;
 	}
 
-	return leaf_count;
+	return walk.count;
 }
 
 int
@@ -545,9 +693,106 @@ CM_BoxLeafnums(vec3_t mins, vec3_t maxs, int *list, int listsize, int *topnode)
 			listsize, map_cmodels[0].headnode, topnode);
 }
 
+/* Results of world traces and point contents of the current
+   server frame. The world never changes while a map is loaded,
+   so a query with exactly the same arguments gets exactly the
+   same result. Entries of older frames are just ignored. */
+#define TRACECACHE_SIZE 2048
+#define CONTENTSCACHE_SIZE 1024
+
+typedef struct
+{
+	vec3_t start, end;
+	vec3_t mins, maxs;
+	int brushmask;
+} cmtracekey_t;
+
+typedef struct
+{
+	cmtracekey_t key;
+	unsigned int frame;
+	trace_t trace;
+} cmcachedtrace_t;
+
+typedef struct
+{
+	vec3_t p;
+	unsigned int frame;
+	int contents;
+} cmcachedcontents_t;
+
+static cmcachedtrace_t tracecache[TRACECACHE_SIZE];
+static cmcachedcontents_t contentscache[CONTENTSCACHE_SIZE];
+static unsigned int tracecache_frame = 1;
+
+static struct
+{
+	unsigned int tracehits, tracemisses;
+	unsigned int contentshits, contentsmisses;
+} cachestats;
+
+static unsigned int
+CM_CacheHash(const void *key, size_t size)
+{
+	const byte *b = key;
+	unsigned int hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < size; i++)
+	{
+		hash = (hash ^ b[i]) * 16777619u;
+	}
+
+	return hash ^ (hash >> 15);
+}
+
+/*
+ * Forgets all cached traces and point contents. Called at the start
+ * of each server frame and when the map changes.
+ */
+void
+CM_NewFrame(void)
+{
+	if (++tracecache_frame == 0)
+	{
+		/* wrapped around, old entries could match again */
+		memset(tracecache, 0, sizeof(tracecache));
+		memset(contentscache, 0, sizeof(contentscache));
+		tracecache_frame = 1;
+	}
+}
+
+static void
+CM_CacheStats_f(void)
+{
+	unsigned int traces, contents;
+
+	if ((Cmd_Argc() > 1) && !strcmp(Cmd_Argv(1), "reset"))
+	{
+		memset(&cachestats, 0, sizeof(cachestats));
+		return;
+	}
+
+	traces = cachestats.tracehits + cachestats.tracemisses;
+	contents = cachestats.contentshits + cachestats.contentsmisses;
+
+	Com_Printf("world traces:   %u, %u cached (%.1f%%)\n", traces,
+			cachestats.tracehits,
+			traces ? 100.0 * cachestats.tracehits / traces : 0.0);
+	Com_Printf("point contents: %u, %u cached (%.1f%%)\n", contents,
+			cachestats.contentshits,
+			contents ? 100.0 * cachestats.contentshits / contents : 0.0);
+
+	if (!cm_tracecache->value)
+	{
+		Com_Printf("cm_tracecache is off.\n");
+	}
+}
+
 int
 CM_PointContents(const vec3_t p, int headnode)
 {
+	cmcachedcontents_t *entry;
 	int l;
 
 	if (!numnodes) /* map not loaded */
@@ -555,9 +800,32 @@ CM_PointContents(const vec3_t p, int headnode)
 		return 0;
 	}
 
+	if (headnode || !cm_tracecache || !cm_tracecache->value)
+	{
+		l = CM_PointLeafnum_r(p, headnode);
+
+		return map_leafs[l].contents;
+	}
+
+	entry = &contentscache[CM_CacheHash(p, sizeof(vec3_t)) &
+		(CONTENTSCACHE_SIZE - 1)];
+
+	if ((entry->frame == tracecache_frame) &&
+		!memcmp(entry->p, p, sizeof(vec3_t)))
+	{
+		cachestats.contentshits++;
+		return entry->contents;
+	}
+
+	cachestats.contentsmisses++;
+
 	l = CM_PointLeafnum_r(p, headnode);
 
-	return map_leafs[l].contents;
+	VectorCopy(p, entry->p);
+	entry->frame = tracecache_frame;
+	entry->contents = map_leafs[l].contents;
+
+	return entry->contents;
 }
 
 /*
@@ -593,43 +861,60 @@ CM_TransformedPointContents(const vec3_t p, int headnode,
 	return map_leafs[l].contents;
 }
 
-static void
-CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
-		vec3_t p2, trace_t *trace, const cbrush_t *brush)
+/*
+ * Takes a side the move crosses into account.
+ */
+static inline void
+CM_CrossSide(brushclip_t *clip, const cbrushside_t *side, float d1, float d2)
 {
-	int i, j;
-	cplane_t *plane, *clipplane;
-	float dist;
-	float enterfrac, leavefrac;
-	vec3_t ofs;
-	float d1, d2;
-	qboolean getout, startout;
 	float f;
-	cbrushside_t *side, *leadside;
-
-	enterfrac = -1;
-	leavefrac = 1;
-	clipplane = NULL;
 
-	if (!brush->numsides)
+	if (d1 > d2)
 	{
-		return;
+		/* enter */
+		f = (d1 - DIST_EPSILON) / (d1 - d2);
+
+		if (f > clip->enterfrac)
+		{
+			clip->enterfrac = f;
+			clip->leadside = side;
+		}
 	}
 
-#ifndef DEDICATED_ONLY
-	c_brush_traces++;
-#endif
+	else
+	{
+		/* leave */
+		f = (d1 + DIST_EPSILON) / (d1 - d2);
+
+		if (f < clip->leavefrac)
+		{
+			clip->leavefrac = f;
+		}
+	}
+}
 
-	getout = false;
-	startout = false;
-	leadside = NULL;
+/*
+ * Clips against the sides of a brush one by one. Returns
+ * false if the move is completely in front of a side.
+ */
+static qboolean
+CM_ClipSides(const vec3_t mins, const vec3_t maxs, const vec3_t p1,
+		const vec3_t p2, qboolean ispoint, brushclip_t *clip,
+		const cbrush_t *brush)
+{
+	int i, j;
+	cplane_t *plane;
+	float dist;
+	vec3_t ofs;
+	float d1, d2;
+	cbrushside_t *side;
 
 	for (i = 0; i < brush->numsides; i++)
 	{
 		side = &map_brushsides[brush->firstbrushside + i];
 		plane = side->plane;
 
-		if (!trace_ispoint)
+		if (!ispoint)
 		{
 			/* general box case
 			   push the plane out
@@ -662,18 +947,18 @@ CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 
 		if (d2 > 0)
 		{
-			getout = true; /* endpoint is not in solid */
+			clip->getout = true; /* endpoint is not in solid */
 		}
 
 		if (d1 > 0)
 		{
-			startout = true;
+			clip->startout = true;
 		}
 
 		/* if completely in front of face, no intersection */
 		if ((d1 > 0) && (d2 >= d1))
 		{
-			return;
+			return false;
 		}
 
 		if ((d1 <= 0) && (d2 <= 0))
@@ -681,38 +966,189 @@ CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 			continue;
 		}
 
-		/* crosses face */
-		if (d1 > d2)
+		CM_CrossSide(clip, side, d1, d2);
+	}
+
+	return true;
+}
+
+#ifdef CM_SIDES_SSE2
+
+/* Distances of the points to the pushed out planes of four
+   sides. The operations are the same as in CM_ClipSides(),
+   in the same order, so the results are the same too. */
+#define CM_SIDES4_DIST(sides, mins, maxs, ispoint, dist) \
+	do { \
+		__m128 nx = _mm_loadu_ps((sides)->normal[0]); \
+		__m128 ny = _mm_loadu_ps((sides)->normal[1]); \
+		__m128 nz = _mm_loadu_ps((sides)->normal[2]); \
+		(dist) = _mm_loadu_ps((sides)->dist); \
+		if (!(ispoint)) \
+		{ \
+			__m128 zero = _mm_setzero_ps(); \
+			__m128 mx = _mm_cmplt_ps(nx, zero); \
+			__m128 my = _mm_cmplt_ps(ny, zero); \
+			__m128 mz = _mm_cmplt_ps(nz, zero); \
+			__m128 ox = _mm_or_ps(_mm_and_ps(mx, _mm_set1_ps((maxs)[0])), \
+				_mm_andnot_ps(mx, _mm_set1_ps((mins)[0]))); \
+			__m128 oy = _mm_or_ps(_mm_and_ps(my, _mm_set1_ps((maxs)[1])), \
+				_mm_andnot_ps(my, _mm_set1_ps((mins)[1]))); \
+			__m128 oz = _mm_or_ps(_mm_and_ps(mz, _mm_set1_ps((maxs)[2])), \
+				_mm_andnot_ps(mz, _mm_set1_ps((mins)[2]))); \
+			(dist) = _mm_sub_ps((dist), _mm_add_ps(_mm_add_ps( \
+				_mm_mul_ps(ox, nx), _mm_mul_ps(oy, ny)), _mm_mul_ps(oz, nz))); \
+		} \
+	} while (0)
+
+#define CM_SIDES4_DOT(sides, p, dist) \
+	_mm_sub_ps(_mm_add_ps(_mm_add_ps( \
+		_mm_mul_ps(_mm_set1_ps((p)[0]), _mm_loadu_ps((sides)->normal[0])), \
+		_mm_mul_ps(_mm_set1_ps((p)[1]), _mm_loadu_ps((sides)->normal[1]))), \
+		_mm_mul_ps(_mm_set1_ps((p)[2]), _mm_loadu_ps((sides)->normal[2]))), (dist))
+
+/*
+ * Same as CM_ClipSides(), for four sides at a time.
+ */
+static qboolean
+CM_ClipSides4(const vec3_t mins, const vec3_t maxs, const vec3_t p1,
+		const vec3_t p2, qboolean ispoint, brushclip_t *clip,
+		const cbrush_t *brush)
+{
+	const cbrushsides4_t *sides = &map_brushsides4[brush->firstsides4];
+	const cbrushside_t *side = &map_brushsides[brush->firstbrushside];
+	__m128 zero = _mm_setzero_ps();
+	int i;
+
+	for (i = 0; i < brush->numsides; i += 4, sides++, side += 4)
+	{
+		float d1s[4], d2s[4];
+		__m128 dist, d1, d2;
+		int valid, cross, lane;
+
+		valid = (brush->numsides - i >= 4) ? 15 :
+			(1 << (brush->numsides - i)) - 1;
+
+		CM_SIDES4_DIST(sides, mins, maxs, ispoint, dist);
+		d1 = CM_SIDES4_DOT(sides, p1, dist);
+		d2 = CM_SIDES4_DOT(sides, p2, dist);
+
+		if (_mm_movemask_ps(_mm_cmpgt_ps(d2, zero)) & valid)
+		{
+			clip->getout = true; /* endpoint is not in solid */
+		}
+
+		if (_mm_movemask_ps(_mm_cmpgt_ps(d1, zero)) & valid)
 		{
-			/* enter */
-			f = (d1 - DIST_EPSILON) / (d1 - d2);
+			clip->startout = true;
+		}
 
-			if (f > enterfrac)
-			{
-				enterfrac = f;
-				clipplane = plane;
-				leadside = side;
-			}
+		/* if completely in front of a face, no intersection */
+		if (_mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(d1, zero),
+				_mm_cmpge_ps(d2, d1))) & valid)
+		{
+			return false;
 		}
 
-		else
+		cross = ~_mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(d1, zero),
+				_mm_cmple_ps(d2, zero))) & valid;
+
+		if (!cross)
 		{
-			/* leave */
-			f = (d1 + DIST_EPSILON) / (d1 - d2);
+			continue;
+		}
+
+		_mm_storeu_ps(d1s, d1);
+		_mm_storeu_ps(d2s, d2);
 
-			if (f < leavefrac)
+		/* in the order of the sides, ties
+		   go to the first one like before */
+		for (lane = 0; lane < 4; lane++)
+		{
+			if (cross & (1 << lane))
 			{
-				leavefrac = f;
+				CM_CrossSide(clip, side + lane, d1s[lane], d2s[lane]);
 			}
 		}
 	}
 
-	if (!startout)
+	return true;
+}
+
+/*
+ * Same as CM_TestSides(), for four sides at a time.
+ */
+static qboolean
+CM_TestSides4(const vec3_t mins, const vec3_t maxs, const vec3_t p1,
+		const cbrush_t *brush)
+{
+	const cbrushsides4_t *sides = &map_brushsides4[brush->firstsides4];
+	__m128 zero = _mm_setzero_ps();
+	int i;
+
+	for (i = 0; i < brush->numsides; i += 4, sides++)
+	{
+		__m128 dist, d1;
+		int valid;
+
+		valid = (brush->numsides - i >= 4) ? 15 :
+			(1 << (brush->numsides - i)) - 1;
+
+		CM_SIDES4_DIST(sides, mins, maxs, false, dist);
+		d1 = CM_SIDES4_DOT(sides, p1, dist);
+
+		if (_mm_movemask_ps(_mm_cmpgt_ps(d1, zero)) & valid)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+#endif
+
+static void
+CM_ClipBoxToBrush(const vec3_t mins, const vec3_t maxs, const vec3_t p1,
+		const vec3_t p2, qboolean ispoint, trace_t *trace,
+		const cbrush_t *brush)
+{
+	brushclip_t clip;
+	qboolean hit;
+
+	if (!brush->numsides)
+	{
+		return;
+	}
+
+	clip.enterfrac = -1;
+	clip.leavefrac = 1;
+	clip.leadside = NULL;
+	clip.getout = false;
+	clip.startout = false;
+
+#ifdef CM_SIDES_SSE2
+	if (cm_simd)
+	{
+		hit = CM_ClipSides4(mins, maxs, p1, p2, ispoint, &clip, brush);
+	}
+
+	else
+#endif
+	{
+		hit = CM_ClipSides(mins, maxs, p1, p2, ispoint, &clip, brush);
+	}
+
+	if (!hit)
+	{
+		return;
+	}
+
+	if (!clip.startout)
 	{
 		/* original point was inside brush */
 		trace->startsolid = true;
 
-		if (!getout)
+		if (!clip.getout)
 		{
 			trace->allsolid = true;
 		}
@@ -720,43 +1156,42 @@ CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 		return;
 	}
 
-	if (enterfrac < leavefrac)
+	if (clip.enterfrac < clip.leavefrac)
 	{
-		if ((enterfrac > -1) && (enterfrac < trace->fraction))
+		if ((clip.enterfrac > -1) && (clip.enterfrac < trace->fraction))
 		{
-			if (enterfrac < 0)
+			if (clip.enterfrac < 0)
 			{
-				enterfrac = 0;
+				clip.enterfrac = 0;
 			}
 
-			if (clipplane == NULL)
+			if (clip.leadside == NULL)
 			{
 				Com_Error(ERR_FATAL, "%s: clipplane was NULL!\n", __func__);
 				return;
 			}
 
-			trace->fraction = enterfrac;
-			trace->plane = *clipplane;
-			trace->surface = &(leadside->surface->c);
+			trace->fraction = clip.enterfrac;
+			trace->plane = *clip.leadside->plane;
+			trace->surface = &(clip.leadside->surface->c);
 			trace->contents = brush->contents;
 		}
 	}
 }
 
-static void
-CM_TestBoxInBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
-		trace_t *trace, const cbrush_t *brush)
+/*
+ * Returns true if p1 is in front of a side of the brush,
+ * with the planes pushed out for mins/maxs.
+ */
+static qboolean
+CM_TestSides(const vec3_t mins, const vec3_t maxs, const vec3_t p1,
+		const cbrush_t *brush)
 {
 	int i, j;
 	cplane_t *plane;
 	vec3_t ofs;
 	cbrushside_t *side;
 
-	if (!brush->numsides)
-	{
-		return;
-	}
-
 	for (i = 0; i < brush->numsides; i++)
 	{
 		float d1, dist;
@@ -788,69 +1223,96 @@ CM_TestBoxInBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 		/* if completely in front of face, no intersection */
 		if (d1 > 0)
 		{
-			return;
+			return true;
 		}
 	}
 
-	/* inside this brush */
-	trace->startsolid = trace->allsolid = true;
-	trace->fraction = 0;
-	trace->contents = brush->contents;
+	return false;
 }
 
 static void
-CM_TraceToLeaf(int leafnum)
+CM_TestBoxInBrush(const vec3_t mins, const vec3_t maxs, const vec3_t p1,
+		trace_t *trace, const cbrush_t *brush)
 {
-	const cleaf_t *leaf;
-	int k;
-
-	leaf = &map_leafs[leafnum];
+	qboolean out;
 
-	if (!(leaf->contents & trace_contents))
+	if (!brush->numsides)
 	{
 		return;
 	}
 
-	/* trace line against all brushes in the leaf */
-	for (k = 0; k < leaf->numleafbrushes; k++)
+#ifdef CM_SIDES_SSE2
+	if (cm_simd)
 	{
-		int brushnum;
-		cbrush_t *b;
-
-		brushnum = map_leafbrushes[leaf->firstleafbrush + k];
-		b = &map_brushes[brushnum];
-
-		if (b->checkcount == checkcount)
-		{
-			continue; /* already checked this brush in another leaf */
-		}
-
-		b->checkcount = checkcount;
-
-		if (!(b->contents & trace_contents))
-		{
-			continue;
-		}
+		out = CM_TestSides4(mins, maxs, p1, brush);
+	}
 
-		CM_ClipBoxToBrush(trace_mins, trace_maxs, trace_start,
-				trace_end, &trace_trace, b);
+	else
+#endif
+	{
+		out = CM_TestSides(mins, maxs, p1, brush);
+	}
 
-		if (!trace_trace.fraction)
-		{
-			return;
-		}
+	if (out)
+	{
+		return;
 	}
-}
+
+	/* inside this brush */
+	trace->startsolid = trace->allsolid = true;
+	trace->fraction = 0;
+	trace->contents = brush->contents;
+}
+
+/*
+ * Starts a new trace of ctx, forgetting all tested brushes.
+ */
+static void
+CM_NewTraceGeneration(cmtrace_t *ctx)
+{
+	if (++ctx->generation == 0)
+	{
+		/* wrapped around, the old stamps could match again */
+		memset(ctx->brushgen, 0, sizeof(ctx->brushgen));
+		ctx->generation = 1;
+	}
+}
+
+/*
+ * Marks brushnum as tested by the current trace of
+ * ctx. Returns false if it already was.
+ */
+static qboolean
+CM_MarkBrush(cmtrace_t *ctx, int brushnum)
+{
+	int word = brushnum >> 5;
+	unsigned int bit = 1u << (brushnum & 31);
+
+	if (ctx->brushgen[word] != ctx->generation)
+	{
+		ctx->brushgen[word] = ctx->generation;
+		ctx->brushbits[word] = bit;
+		return true;
+	}
+
+	if (ctx->brushbits[word] & bit)
+	{
+		return false;
+	}
+
+	ctx->brushbits[word] |= bit;
+	return true;
+}
 
 static void
-CM_TestInLeaf(int leafnum)
+CM_TraceToLeaf(cmtrace_t *ctx, int leafnum)
 {
 	const cleaf_t *leaf;
 	int k;
 
 	leaf = &map_leafs[leafnum];
 
-	if (!(leaf->contents & trace_contents))
+	if (!(leaf->contents & ctx->contents))
 	{
 		return;
 	}
@@ -864,185 +1326,289 @@ CM_TestInLeaf(int leafnum)
 		brushnum = map_leafbrushes[leaf->firstleafbrush + k];
 		b = &map_brushes[brushnum];
 
-		if (b->checkcount == checkcount)
+		if (!CM_MarkBrush(ctx, brushnum))
 		{
 			continue; /* already checked this brush in another leaf */
 		}
 
-		b->checkcount = checkcount;
+		if (!(b->contents & ctx->contents))
+		{
+			continue;
+		}
+
+		if (b->numsides)
+		{
+			ctx->numbrushtraces++;
+		}
+
+		CM_ClipBoxToBrush(ctx->mins, ctx->maxs, ctx->start,
+				ctx->end, ctx->ispoint, &ctx->trace, b);
 
-		if (!(b->contents & trace_contents))
+		if (!ctx->trace.fraction)
+		{
+			return;
+		}
+	}
+}
+
+static void
+CM_TestInLeaf(cmtrace_t *ctx, int leafnum)
+{
+	const cleaf_t *leaf;
+	int k;
+
+	leaf = &map_leafs[leafnum];
+
+	if (!(leaf->contents & ctx->contents))
+	{
+		return;
+	}
+
+	/* trace line against all brushes in the leaf */
+	for (k = 0; k < leaf->numleafbrushes; k++)
+	{
+		int brushnum;
+		cbrush_t *b;
+
+		brushnum = map_leafbrushes[leaf->firstleafbrush + k];
+		b = &map_brushes[brushnum];
+
+		if (!CM_MarkBrush(ctx, brushnum))
+		{
+			continue; /* already checked this brush in another leaf */
+		}
+
+		if (!(b->contents & ctx->contents))
 		{
 			continue;
 		}
 
-		CM_TestBoxInBrush(trace_mins, trace_maxs, trace_start, &trace_trace, b);
+		CM_TestBoxInBrush(ctx->mins, ctx->maxs, ctx->start, &ctx->trace, b);
 
-		if (!trace_trace.fraction)
+		if (!ctx->trace.fraction)
 		{
 			return;
 		}
 	}
 }
 
+/* the far side of a node, still to be checked */
+typedef struct
+{
+	int num;
+	float p1f, p2f;
+	vec3_t p1, p2;
+} hullpiece_t;
+
+/*
+ * Walks the tree from p1 to p2, the near side of each node first.
+ * Far sides wait on a stack, only very deep trees need to recurse.
+ */
 static void
-CM_RecursiveHullCheck(int num, float p1f, float p2f, const vec3_t p1, const vec3_t p2)
+CM_RecursiveHullCheck(cmtrace_t *ctx, int num, float p1f, float p2f,
+		const vec3_t start, const vec3_t end)
 {
-	cnode_t *node;
-	cplane_t *plane;
+	hullpiece_t stack[WALKSTACK_SIZE];
+	hullpiece_t *piece;
+	int depth = 0;
+	const cnode_t *node;
+	const cplane_t *plane;
 	float t1, t2, offset;
 	float frac, frac2;
 	float idist;
 	int i;
-	vec3_t mid;
+	vec3_t p1, p2, mid;
 	int side;
 	float midf;
 
-	if (trace_trace.fraction <= p1f)
-	{
-		return; /* already hit something nearer */
-	}
+	VectorCopy(start, p1);
+	VectorCopy(end, p2);
 
-	/* if < 0, we are in a leaf node */
-	if (num < 0)
+	for ( ; ; )
 	{
-		CM_TraceToLeaf(-1 - num);
-		return;
-	}
+		/* if < 0, we are in a leaf node */
+		if ((num < 0) || (ctx->trace.fraction <= p1f))
+		{
+			if ((num < 0) && (ctx->trace.fraction > p1f))
+			{
+				CM_TraceToLeaf(ctx, -1 - num);
+			}
 
-	/* find the point distances to the seperating plane
-	   and the offset for the size of the box */
-	node = map_nodes + num;
-	plane = node->plane;
+			/* else already hit something nearer */
+			if (!depth)
+			{
+				return;
+			}
 
-	if (plane->type < 3)
-	{
-		t1 = p1[plane->type] - plane->dist;
-		t2 = p2[plane->type] - plane->dist;
-		offset = trace_extents[plane->type];
-	}
+			piece = &stack[--depth];
+			num = piece->num;
+			p1f = piece->p1f;
+			p2f = piece->p2f;
+			VectorCopy(piece->p1, p1);
+			VectorCopy(piece->p2, p2);
+			continue;
+		}
 
-	else
-	{
-		t1 = DotProduct(plane->normal, p1) - plane->dist;
-		t2 = DotProduct(plane->normal, p2) - plane->dist;
+		/* find the point distances to the seperating plane
+		   and the offset for the size of the box */
+		node = map_nodes + num;
+		plane = &node->plane;
 
-		if (trace_ispoint)
+		if (plane->type < 3)
 		{
-			offset = 0;
+			t1 = p1[plane->type] - plane->dist;
+			t2 = p2[plane->type] - plane->dist;
+			offset = ctx->extents[plane->type];
 		}
 
 		else
 		{
-			offset = (float)fabs(trace_extents[0] * plane->normal[0]) +
-					 (float)fabs(trace_extents[1] * plane->normal[1]) +
-					 (float)fabs(trace_extents[2] * plane->normal[2]);
+			t1 = DotProduct(plane->normal, p1) - plane->dist;
+			t2 = DotProduct(plane->normal, p2) - plane->dist;
+
+			if (ctx->ispoint)
+			{
+				offset = 0;
+			}
+
+			else
+			{
+				offset = (float)fabs(ctx->extents[0] * plane->normal[0]) +
+						 (float)fabs(ctx->extents[1] * plane->normal[1]) +
+						 (float)fabs(ctx->extents[2] * plane->normal[2]);
+			}
 		}
-	}
 
-	/* see which sides we need to consider */
-	if ((t1 >= offset) && (t2 >= offset))
-	{
-		CM_RecursiveHullCheck(node->children[0], p1f, p2f, p1, p2);
-		return;
-	}
+		/* see which sides we need to consider */
+		if ((t1 >= offset) && (t2 >= offset))
+		{
+			num = node->children[0];
+			continue;
+		}
 
-	if ((t1 < -offset) && (t2 < -offset))
-	{
-		CM_RecursiveHullCheck(node->children[1], p1f, p2f, p1, p2);
-		return;
-	}
+		if ((t1 < -offset) && (t2 < -offset))
+		{
+			num = node->children[1];
+			continue;
+		}
 
-	/* put the crosspoint DIST_EPSILON pixels on the near side */
-	if (t1 < t2)
-	{
-		idist = 1.0f / (t1 - t2);
-		side = 1;
-		frac2 = (t1 + offset + DIST_EPSILON) * idist;
-		frac = (t1 - offset + DIST_EPSILON) * idist;
-	}
+		/* put the crosspoint DIST_EPSILON pixels on the near side */
+		if (t1 < t2)
+		{
+			idist = 1.0f / (t1 - t2);
+			side = 1;
+			frac2 = (t1 + offset + DIST_EPSILON) * idist;
+			frac = (t1 - offset + DIST_EPSILON) * idist;
+		}
 
-	else if (t1 > t2)
-	{
-		idist = 1.0 / (t1 - t2);
-		side = 0;
-		frac2 = (t1 - offset - DIST_EPSILON) * idist;
-		frac = (t1 + offset + DIST_EPSILON) * idist;
-	}
+		else if (t1 > t2)
+		{
+			idist = 1.0 / (t1 - t2);
+			side = 0;
+			frac2 = (t1 - offset - DIST_EPSILON) * idist;
+			frac = (t1 + offset + DIST_EPSILON) * idist;
+		}
 
-	else
-	{
-		side = 0;
-		frac = 1;
-		frac2 = 0;
-	}
+		else
+		{
+			side = 0;
+			frac = 1;
+			frac2 = 0;
+		}
 
-	/* move up to the node */
-	if (frac < 0)
-	{
-		frac = 0;
-	}
+		/* move up to the node */
+		if (frac < 0)
+		{
+			frac = 0;
+		}
 
-	if (frac > 1)
-	{
-		frac = 1;
-	}
+		if (frac > 1)
+		{
+			frac = 1;
+		}
 
-	midf = p1f + (p2f - p1f) * frac;
+		/* go past the node */
+		if (frac2 < 0)
+		{
+			frac2 = 0;
+		}
 
-	for (i = 0; i < 3; i++)
-	{
-		mid[i] = p1[i] + frac * (p2[i] - p1[i]);
-	}
+		if (frac2 > 1)
+		{
+			frac2 = 1;
+		}
 
-	CM_RecursiveHullCheck(node->children[side], p1f, midf, p1, mid);
+		midf = p1f + (p2f - p1f) * frac;
 
-	/* go past the node */
-	if (frac2 < 0)
-	{
-		frac2 = 0;
-	}
+		for (i = 0; i < 3; i++)
+		{
+			mid[i] = p1[i] + frac * (p2[i] - p1[i]);
+		}
 
-	if (frac2 > 1)
-	{
-		frac2 = 1;
-	}
+		if (depth == WALKSTACK_SIZE)
+		{
+			CM_RecursiveHullCheck(ctx, node->children[side], p1f, midf,
+					p1, mid);
 
-	midf = p1f + (p2f - p1f) * frac2;
+			/* continue with the far side */
+			num = node->children[side ^ 1];
+			midf = p1f + (p2f - p1f) * frac2;
 
-	for (i = 0; i < 3; i++)
-	{
-		mid[i] = p1[i] + frac2 * (p2[i] - p1[i]);
-	}
+			for (i = 0; i < 3; i++)
+			{
+				p1[i] = p1[i] + frac2 * (p2[i] - p1[i]);
+			}
 
-	CM_RecursiveHullCheck(node->children[side ^ 1], midf, p2f, mid, p2);
+			p1f = midf;
+			continue;
+		}
+
+		/* the far side waits until the near side is done */
+		piece = &stack[depth++];
+		piece->num = node->children[side ^ 1];
+		piece->p1f = p1f + (p2f - p1f) * frac2;
+		piece->p2f = p2f;
+
+		for (i = 0; i < 3; i++)
+		{
+			piece->p1[i] = p1[i] + frac2 * (p2[i] - p1[i]);
+		}
+
+		VectorCopy(p2, piece->p2);
+
+		num = node->children[side];
+		p2f = midf;
+		VectorCopy(mid, p2);
+	}
 }
 
+/*
+ * Sweeps a box through the map, keeping all state in ctx. Traces
+ * with different contexts don't interfere with each other.
+ */
 trace_t
-CM_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
-		int headnode, int brushmask)
+CM_BoxTraceCtx(cmtrace_t *ctx, const vec3_t start, const vec3_t end,
+		const vec3_t mins, const vec3_t maxs, int headnode, int brushmask)
 {
-	checkcount++; /* for multi-check avoidance */
+	CM_NewTraceGeneration(ctx); /* for multi-check avoidance */
 
-#ifndef DEDICATED_ONLY
-	c_traces++; /* for statistics, may be zeroed */
-#endif
+	ctx->numtraces++; /* for statistics */
 
 	/* fill in a default trace */
-	memset(&trace_trace, 0, sizeof(trace_trace));
-	trace_trace.fraction = 1;
-	trace_trace.surface = &(nullsurface.c);
+	memset(&ctx->trace, 0, sizeof(ctx->trace));
+	ctx->trace.fraction = 1;
+	ctx->trace.surface = &(nullsurface.c);
 
 	if (!numnodes)  /* map not loaded */
 	{
-		return trace_trace;
+		return ctx->trace;
 	}
 
-	trace_contents = brushmask;
-	VectorCopy(start, trace_start);
-	VectorCopy(end, trace_end);
-	VectorCopy(mins, trace_mins);
-	VectorCopy(maxs, trace_maxs);
+	ctx->contents = brushmask;
+	VectorCopy(start, ctx->start);
+	VectorCopy(end, ctx->end);
+	VectorCopy(mins, ctx->mins);
+	VectorCopy(maxs, ctx->maxs);
 
 	/* check for position test special case */
 	if ((start[0] == end[0]) && (start[1] == end[1]) && (start[2] == end[2]))
@@ -1066,40 +1632,40 @@ CM_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_
 
 		for (i = 0; i < numleafs; i++)
 		{
-			CM_TestInLeaf(leafs[i]);
+			CM_TestInLeaf(ctx, leafs[i]);
 
-			if (trace_trace.allsolid)
+			if (ctx->trace.allsolid)
 			{
 				break;
 			}
 		}
 
-		VectorCopy(start, trace_trace.endpos);
-		return trace_trace;
+		VectorCopy(start, ctx->trace.endpos);
+		return ctx->trace;
 	}
 
 	/* check for point special case */
 	if ((mins[0] == 0) && (mins[1] == 0) && (mins[2] == 0) &&
 		(maxs[0] == 0) && (maxs[1] == 0) && (maxs[2] == 0))
 	{
-		trace_ispoint = true;
-		VectorClear(trace_extents);
+		ctx->ispoint = true;
+		VectorClear(ctx->extents);
 	}
 
 	else
 	{
-		trace_ispoint = false;
-		trace_extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
-		trace_extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
-		trace_extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
+		ctx->ispoint = false;
+		ctx->extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
+		ctx->extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
+		ctx->extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
 	}
 
 	/* general sweeping through world */
-	CM_RecursiveHullCheck(headnode, 0, 1, start, end);
+	CM_RecursiveHullCheck(ctx, headnode, 0, 1, start, end);
 
-	if (trace_trace.fraction == 1)
+	if (ctx->trace.fraction == 1)
 	{
-		VectorCopy(end, trace_trace.endpos);
+		VectorCopy(end, ctx->trace.endpos);
 	}
 
 	else
@@ -1108,12 +1674,12 @@ CM_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_
 
 		for (i = 0; i < 3; i++)
 		{
-			trace_trace.endpos[i] = start[i] + trace_trace.fraction *
+			ctx->trace.endpos[i] = start[i] + ctx->trace.fraction *
 									(end[i] - start[i]);
 		}
 	}
 
-	return trace_trace;
+	return ctx->trace;
 }
 
 /*
@@ -1121,9 +1687,9 @@ CM_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_
  * rotating entities
  */
 trace_t
-CM_TransformedBoxTrace(const vec3_t start, const vec3_t end,
-		const vec3_t mins, const vec3_t maxs, int headnode, int brushmask,
-		const vec3_t origin, const vec3_t angles)
+CM_TransformedBoxTraceCtx(cmtrace_t *ctx, const vec3_t start,
+		const vec3_t end, const vec3_t mins, const vec3_t maxs, int headnode,
+		int brushmask, const vec3_t origin, const vec3_t angles)
 {
 	vec3_t forward, right, up;
 	vec3_t start_l, end_l;
@@ -1163,7 +1729,8 @@ CM_TransformedBoxTrace(const vec3_t start, const vec3_t end,
 	}
 
 	/* sweep the box through the model */
-	trace = CM_BoxTrace(start_l, end_l, mins, maxs, headnode, brushmask);
+	trace = CM_BoxTraceCtx(ctx, start_l, end_l, mins, maxs, headnode,
+			brushmask);
 
 	if (rotated && (trace.fraction != 1.0))
 	{
@@ -1178,11 +1745,375 @@ CM_TransformedBoxTrace(const vec3_t start, const vec3_t end,
 		trace.plane.normal[2] = DotProduct(temp, up);
 	}
 
-	trace.endpos[0] = start[0] + trace.fraction * (end[0] - start[0]);
-	trace.endpos[1] = start[1] + trace.fraction * (end[1] - start[1]);
-	trace.endpos[2] = start[2] + trace.fraction * (end[2] - start[2]);
+	trace.endpos[0] = start[0] + trace.fraction * (end[0] - start[0]);
+	trace.endpos[1] = start[1] + trace.fraction * (end[1] - start[1]);
+	trace.endpos[2] = start[2] + trace.fraction * (end[2] - start[2]);
+
+	return trace;
+}
+
+/* the context of the non reentrant traces */
+static cmtrace_t cm_trace;
+
+/*
+ * Moves the trace counters of ctx into the global ones, which
+ * are only touched by the main thread.
+ */
+void
+CM_AddTraceStats(cmtrace_t *ctx)
+{
+#ifndef DEDICATED_ONLY
+	c_traces += ctx->numtraces;
+	c_brush_traces += ctx->numbrushtraces;
+#endif
+
+	ctx->numtraces = 0;
+	ctx->numbrushtraces = 0;
+}
+
+/* A recorded trace, for cm_tracebench */
+typedef struct
+{
+	vec3_t start, end;
+	vec3_t mins, maxs;
+	vec3_t origin, angles;
+	int headnode;
+	int brushmask;
+} cmtracerec_t;
+
+static cmtracerec_t *tracerecs;
+static int numtracerecs, maxtracerecs;
+static char tracerecs_map[MAX_QPATH];
+
+static void
+CM_RecordTrace(const vec3_t start, const vec3_t end, const vec3_t mins,
+		const vec3_t maxs, int headnode, int brushmask,
+		const vec3_t origin, const vec3_t angles)
+{
+	cmtracerec_t *rec;
+
+	/* the box hull changes all the time */
+	if ((numtracerecs >= maxtracerecs) || (headnode == box_headnode))
+	{
+		return;
+	}
+
+	rec = &tracerecs[numtracerecs++];
+
+	VectorCopy(start, rec->start);
+	VectorCopy(end, rec->end);
+	VectorCopy(mins, rec->mins);
+	VectorCopy(maxs, rec->maxs);
+	VectorCopy(origin, rec->origin);
+	VectorCopy(angles, rec->angles);
+	rec->headnode = headnode;
+	rec->brushmask = brushmask;
+
+	if (numtracerecs == maxtracerecs)
+	{
+		Com_Printf("Recorded %i traces on %s.\n", numtracerecs,
+				tracerecs_map);
+	}
+}
+
+trace_t
+CM_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins,
+		const vec3_t maxs, int headnode, int brushmask)
+{
+	trace_t trace;
+
+	if (numtracerecs < maxtracerecs)
+	{
+		CM_RecordTrace(start, end, mins, maxs, headnode, brushmask,
+				vec3_origin, vec3_origin);
+	}
+
+	if (!headnode && numnodes && cm_tracecache && cm_tracecache->value)
+	{
+		cmcachedtrace_t *entry;
+		cmtracekey_t key;
+
+		VectorCopy(start, key.start);
+		VectorCopy(end, key.end);
+		VectorCopy(mins, key.mins);
+		VectorCopy(maxs, key.maxs);
+		key.brushmask = brushmask;
+
+		entry = &tracecache[CM_CacheHash(&key, sizeof(key)) &
+			(TRACECACHE_SIZE - 1)];
+
+		if ((entry->frame == tracecache_frame) &&
+			!memcmp(&entry->key, &key, sizeof(key)))
+		{
+			cachestats.tracehits++;
+			return entry->trace;
+		}
+
+		cachestats.tracemisses++;
+
+		entry->key = key;
+		entry->frame = tracecache_frame;
+		entry->trace = CM_BoxTraceCtx(&cm_trace, start, end, mins, maxs,
+				headnode, brushmask);
+		CM_AddTraceStats(&cm_trace);
+
+		return entry->trace;
+	}
+
+	trace = CM_BoxTraceCtx(&cm_trace, start, end, mins, maxs, headnode,
+			brushmask);
+	CM_AddTraceStats(&cm_trace);
+
+	return trace;
+}
+
+trace_t
+CM_TransformedBoxTrace(const vec3_t start, const vec3_t end,
+		const vec3_t mins, const vec3_t maxs, int headnode, int brushmask,
+		const vec3_t origin, const vec3_t angles)
+{
+	trace_t trace;
+
+	if (numtracerecs < maxtracerecs)
+	{
+		CM_RecordTrace(start, end, mins, maxs, headnode, brushmask,
+				origin, angles);
+	}
+
+	trace = CM_TransformedBoxTraceCtx(&cm_trace, start, end, mins, maxs,
+			headnode, brushmask, origin, angles);
+	CM_AddTraceStats(&cm_trace);
+
+	return trace;
+}
+
+/*
+ * Records the next traces on the current map for cm_tracebench.
+ */
+static void
+CM_TraceRecord_f(void)
+{
+	int count;
+
+	count = (Cmd_Argc() > 1) ? (int)strtol(Cmd_Argv(1), NULL, 10) : 100000;
+
+	if (count < 1)
+	{
+		Com_Printf("Usage: cm_tracerecord [count]\n");
+		return;
+	}
+
+	if (!numnodes)
+	{
+		Com_Printf("No map loaded.\n");
+		return;
+	}
+
+	if (tracerecs)
+	{
+		Z_Free(tracerecs);
+	}
+
+	/* stop recording while the buffer changes */
+	maxtracerecs = 0;
+	numtracerecs = 0;
+
+	tracerecs = Z_Malloc(count * sizeof(cmtracerec_t));
+	Q_strlcpy(tracerecs_map, map_name, sizeof(tracerecs_map));
+	maxtracerecs = count;
+
+	Com_Printf("Recording %i traces on %s.\n", count, tracerecs_map);
+}
+
+/*
+ * Fills recs with traces of random boxes between random
+ * points of the world and the inline models.
+ */
+static void
+CM_RandomTraces(cmtracerec_t *recs, int count)
+{
+	static const vec3_t boxes[][2] = {
+		{{0, 0, 0}, {0, 0, 0}},
+		{{-16, -16, -24}, {16, 16, 32}},
+		{{-16, -16, -24}, {16, 16, 4}},
+		{{-4, -4, -4}, {4, 4, 4}}
+	};
+	int i, j;
+
+	for (i = 0; i < count; i++)
+	{
+		cmtracerec_t *rec = &recs[i];
+		const cmodel_t *model = &map_cmodels[0];
+		int box = randk() % (sizeof(boxes) / sizeof(boxes[0]));
+
+		memset(rec, 0, sizeof(*rec));
+
+		if ((numcmodels > 1) && !(randk() & 3))
+		{
+			model = &map_cmodels[1 + randk() % (numcmodels - 1)];
+		}
+
+		for (j = 0; j < 3; j++)
+		{
+			float size = model->maxs[j] - model->mins[j];
+
+			rec->start[j] = model->mins[j] + frandk() * size;
+
+			/* short moves like the player, long ones like bullets */
+			if (randk() & 1)
+			{
+				rec->end[j] = rec->start[j] + crandk() * 64;
+			}
+
+			else
+			{
+				rec->end[j] = model->mins[j] + frandk() * size;
+			}
+		}
+
+		if (!(randk() & 7))
+		{
+			VectorCopy(rec->start, rec->end);
+		}
+
+		VectorCopy(boxes[box][0], rec->mins);
+		VectorCopy(boxes[box][1], rec->maxs);
+		rec->headnode = model->headnode;
+		rec->brushmask = (randk() & 1) ? MASK_PLAYERSOLID : MASK_SHOT;
+	}
+}
+
+/*
+ * Runs the recorded traces, or random ones if there are none
+ * for the current map, once clipping against four brush sides
+ * at a time and once side by side. Prints how long it took and
+ * checks that both give the same results.
+ */
+static void
+CM_TraceBench_f(void)
+{
+	static cmtrace_t ctx;
+	cmtracerec_t *recs;
+	trace_t *results[2];
+	long long start, times[2];
+	qboolean simd;
+	int count, mismatches, runs;
+	int i, run, pass;
+
+	runs = (Cmd_Argc() > 1) ? (int)strtol(Cmd_Argv(1), NULL, 10) : 10;
+
+	if (runs < 1)
+	{
+		Com_Printf("Usage: cm_tracebench [runs]\n");
+		return;
+	}
+
+	if (!numnodes)
+	{
+		Com_Printf("No map loaded.\n");
+		return;
+	}
+
+	if (numtracerecs && !strcmp(tracerecs_map, map_name))
+	{
+		recs = tracerecs;
+		count = numtracerecs;
+		Com_Printf("%i recorded traces", count);
+	}
+
+	else
+	{
+		count = 100000;
+		recs = Z_Malloc(count * sizeof(cmtracerec_t));
+		CM_RandomTraces(recs, count);
+		Com_Printf("%i random traces", count);
+	}
+
+	Com_Printf(", %i runs.\n", runs);
+
+	results[0] = Z_Malloc(count * sizeof(trace_t));
+	results[1] = Z_Malloc(count * sizeof(trace_t));
+	times[0] = times[1] = 0;
+	simd = cm_simd;
+
+	for (run = 0; run < runs; run++)
+	{
+		for (pass = 0; pass < 2; pass++)
+		{
+			cm_simd = pass;
+			start = Sys_Microseconds();
+
+			for (i = 0; i < count; i++)
+			{
+				const cmtracerec_t *rec = &recs[i];
+
+				results[pass][i] = CM_TransformedBoxTraceCtx(&ctx,
+						rec->start, rec->end, rec->mins, rec->maxs,
+						rec->headnode, rec->brushmask, rec->origin,
+						rec->angles);
+			}
+
+			times[pass] += Sys_Microseconds() - start;
+		}
+	}
+
+	cm_simd = simd;
+	mismatches = 0;
+
+	/* not real traces */
+	ctx.numtraces = 0;
+	ctx.numbrushtraces = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		const trace_t *a = &results[0][i], *b = &results[1][i];
+
+		if (memcmp(&a->fraction, &b->fraction, sizeof(a->fraction)) ||
+			memcmp(a->endpos, b->endpos, sizeof(a->endpos)) ||
+			memcmp(&a->plane, &b->plane, sizeof(a->plane)) ||
+			(a->surface != b->surface) || (a->ent != b->ent) ||
+			(a->contents != b->contents) || (a->allsolid != b->allsolid) ||
+			(a->startsolid != b->startsolid))
+		{
+			mismatches++;
+		}
+	}
+
+#ifdef CM_SIDES_SSE2
+	Com_Printf("side by side: %.3f ms, four sides at a time: %.3f ms\n",
+			times[0] / (1000.0 * runs), times[1] / (1000.0 * runs));
+#else
+	Com_Printf("side by side: %.3f ms (no vectorized clipping in this build)\n",
+			times[0] / (1000.0 * runs));
+#endif
+
+	if (mismatches)
+	{
+		Com_Printf("%i traces differ!\n", mismatches);
+	}
+
+	else
+	{
+		Com_Printf("All traces are the same.\n");
+	}
+
+	Z_Free(results[1]);
+	Z_Free(results[0]);
+
+	if (recs != tracerecs)
+	{
+		Z_Free(recs);
+	}
+}
+
+void
+CM_Init(void)
+{
+	cm_tracecache = Cvar_Get("cm_tracecache", "1", 0);
 
-	return trace;
+	Cmd_AddCommand("cm_cachestats", CM_CacheStats_f);
+	Cmd_AddCommand("cm_tracerecord", CM_TraceRecord_f);
+	Cmd_AddCommand("cm_tracebench", CM_TraceBench_f);
 }
 
 static void
@@ -1272,6 +2203,105 @@ CMod_LoadSurfaces(lump_t *l)
 	}
 }
 
+/*
+ * Puts the nodes of each model in depth first order, so the
+ * front child follows its parent and walks down the tree go
+ * mostly forward in memory. qbsp already writes them like that,
+ * other compilers may not. Nodes no model uses go last.
+ */
+static void
+CMod_SortNodes(void)
+{
+	cnode_t *sorted;
+	int *newnum, *stack;
+	int i, j, count, depth;
+
+	newnum = Z_Malloc(numnodes * sizeof(int));
+	stack = Z_Malloc(numnodes * sizeof(int));
+	sorted = Z_Malloc(numnodes * sizeof(cnode_t));
+
+	for (i = 0; i < numnodes; i++)
+	{
+		newnum[i] = -1;
+	}
+
+	count = 0;
+
+	for (i = 0; i < numcmodels; i++)
+	{
+		int headnode = map_cmodels[i].headnode;
+
+		if ((headnode < 0) || (headnode >= numnodes))
+		{
+			continue;
+		}
+
+		depth = 0;
+		stack[depth++] = headnode;
+
+		while (depth)
+		{
+			int num = stack[--depth];
+
+			if (newnum[num] != -1)
+			{
+				continue; /* shared with another model */
+			}
+
+			newnum[num] = count;
+			sorted[count++] = map_nodes[num];
+
+			/* the front child comes out first. Every
+			   node is pushed once, by its first parent */
+			for (j = 1; j >= 0; j--)
+			{
+				int child = map_nodes[num].children[j];
+
+				if ((child >= 0) && (newnum[child] == -1) &&
+					(depth < numnodes))
+				{
+					stack[depth++] = child;
+				}
+			}
+		}
+	}
+
+	for (i = 0; i < numnodes; i++)
+	{
+		if (newnum[i] == -1)
+		{
+			newnum[i] = count;
+			sorted[count++] = map_nodes[i];
+		}
+	}
+
+	for (i = 0; i < numnodes; i++)
+	{
+		for (j = 0; j < 2; j++)
+		{
+			if (sorted[i].children[j] >= 0)
+			{
+				sorted[i].children[j] = newnum[sorted[i].children[j]];
+			}
+		}
+	}
+
+	for (i = 0; i < numcmodels; i++)
+	{
+		if ((map_cmodels[i].headnode >= 0) &&
+			(map_cmodels[i].headnode < numnodes))
+		{
+			map_cmodels[i].headnode = newnum[map_cmodels[i].headnode];
+		}
+	}
+
+	memcpy(map_nodes, sorted, numnodes * sizeof(cnode_t));
+
+	Z_Free(sorted);
+	Z_Free(stack);
+	Z_Free(newnum);
+}
+
 static void
 CMod_LoadNodes(const char *name, lump_t *l)
 {
@@ -1308,14 +2338,32 @@ CMod_LoadNodes(const char *name, lump_t *l)
 
 	for (i = 0; i < count; i++, out++, in++)
 	{
-		out->plane = map_planes + LittleLong(in->planenum);
+		j = LittleLong(in->planenum);
+
+		if ((j < 0) || (j >= numplanes))
+		{
+			Com_Error(ERR_DROP, "%s: Map %s has a bad plane number",
+				__func__, name);
+		}
+
+		out->plane = map_planes[j];
+		out->pad = 0;
 
 		for (j = 0; j < 2; j++)
 		{
 			child = LittleLong(in->children[j]);
+
+			if ((child >= count) || (-1 - child >= numleafs))
+			{
+				Com_Error(ERR_DROP, "%s: Map %s has a bad node child",
+					__func__, name);
+			}
+
 			out->children[j] = child;
 		}
 	}
+
+	CMod_SortNodes();
 }
 
 static void
@@ -1513,6 +2561,57 @@ CMod_LoadLeafBrushes(const char *name, lump_t *l)
 	}
 }
 
+/*
+ * Lays out the sides of all brushes in groups of four for
+ * CM_ClipBoxToBrush(). The last two groups are left for
+ * the box hull.
+ */
+static void
+CMod_LoadBrushSides4(void)
+{
+	cbrushsides4_t *out;
+	int i, j, count;
+
+	count = 2;
+
+	for (i = 0; i < numbrushes; i++)
+	{
+		const cbrush_t *brush = &map_brushes[i];
+
+		if ((brush->firstbrushside > numbrushsides) ||
+			(brush->numsides > numbrushsides - brush->firstbrushside))
+		{
+			Com_Error(ERR_DROP, "%s: bad sides of brush %i", __func__, i);
+		}
+
+		count += (brush->numsides + 3) / 4;
+	}
+
+	map_brushsides4 = Z_Malloc(count * sizeof(cbrushsides4_t));
+	numbrushsides4 = count;
+	out = map_brushsides4;
+
+	for (i = 0; i < numbrushes; i++)
+	{
+		cbrush_t *brush = &map_brushes[i];
+
+		brush->firstsides4 = out - map_brushsides4;
+
+		for (j = 0; j < brush->numsides; j++)
+		{
+			const cplane_t *plane =
+				map_brushsides[brush->firstbrushside + j].plane;
+
+			out[j >> 2].normal[0][j & 3] = plane->normal[0];
+			out[j >> 2].normal[1][j & 3] = plane->normal[1];
+			out[j >> 2].normal[2][j & 3] = plane->normal[2];
+			out[j >> 2].dist[j & 3] = plane->dist;
+		}
+
+		out += (brush->numsides + 3) / 4;
+	}
+}
+
 void
 CMod_LoadBrushSides(lump_t *l)
 {
@@ -1553,6 +2652,8 @@ CMod_LoadBrushSides(lump_t *l)
 
 		out->surface = (j >= 0) ? &map_surfaces[j] : &nullsurface;
 	}
+
+	CMod_LoadBrushSides4();
 }
 
 static void
@@ -1626,6 +2727,11 @@ CMod_LoadVisibility(lump_t *l)
 		Com_Error(ERR_DROP, "Map has too large visibility lump");
 	}
 
+	if (!numvisibility)
+	{
+		return;
+	}
+
 	memcpy(map_visibility, cmod_base + l->fileofs, l->filelen);
 
 	map_vis->numclusters = LittleLong(map_vis->numclusters);
@@ -1711,6 +2817,324 @@ CMod_LoadEntityString(const lump_t *l, const char *name)
 	map_entitystring[numentitychars] = 0;
 }
 
+/*
+ * Allocates the decompressed vis table for the current map,
+ * as long as it fits into the budget given by cm_viscache
+ * (in megabytes, 0 disables the cache).
+ */
+static void
+CM_InitVisCache(void)
+{
+	size_t rowbytes, tablesize;
+
+	if (!numvisibility || (numclusters < 1) || (cm_viscache->value <= 0))
+	{
+		return;
+	}
+
+	rowbytes = (((numclusters + 7) >> 3) + VISCACHE_ALIGN - 1) &
+		~(size_t)(VISCACHE_ALIGN - 1);
+	tablesize = rowbytes * numclusters;
+
+	if (2 * tablesize > (size_t)(cm_viscache->value * 1024 * 1024))
+	{
+		Com_DPrintf("%s: %i clusters need " YQ2_COM_PRIdS
+			" bytes, over budget\n", __func__, numclusters, 2 * tablesize);
+		return;
+	}
+
+	viscache_base = Z_Malloc(2 * tablesize + 2 * numclusters +
+		VISCACHE_ALIGN);
+	viscache_rowbytes = rowbytes;
+
+	viscache_rows[DVIS_PVS] = (byte *)(((uintptr_t)viscache_base +
+		VISCACHE_ALIGN - 1) & ~(uintptr_t)(VISCACHE_ALIGN - 1));
+	viscache_rows[DVIS_PHS] = viscache_rows[DVIS_PVS] + tablesize;
+	viscache_valid[DVIS_PVS] = viscache_rows[DVIS_PHS] + tablesize;
+	viscache_valid[DVIS_PHS] = viscache_valid[DVIS_PVS] + numclusters;
+}
+
+/*
+ * Hands out the next CMCACHE_ALIGN aligned piece of a
+ * collision model block. With base NULL only the size
+ * of the block is counted.
+ */
+static void *
+CM_CarveBlock(byte *base, size_t *size, size_t bytes)
+{
+	size_t offset = *size;
+
+	*size += (bytes + CMCACHE_ALIGN - 1) & ~(size_t)(CMCACHE_ALIGN - 1);
+
+	return base ? base + offset : NULL;
+}
+
+static int
+CM_LumpCount(const dheader_t *header, int lump, size_t size, int length)
+{
+	const lump_t *l = &header->lumps[lump];
+
+	if ((l->fileofs < 0) || (l->filelen < 0) ||
+		(l->fileofs > length) || (l->filelen > length - l->fileofs))
+	{
+		Com_Error(ERR_DROP, "%s: lump %i out of bounds", __func__, lump);
+	}
+
+	return l->filelen / size;
+}
+
+/*
+ * Splits the block of a collision model into the arrays
+ * the loaders fill. The box hull takes a few extra nodes,
+ * leafs, brushes, brushsides and leafbrushes.
+ */
+static size_t
+CM_LayoutBlock(const dheader_t *header, int length, byte *base)
+{
+	size_t size = 0;
+
+	map_planes = CM_CarveBlock(base, &size, sizeof(cplane_t) *
+		CM_LumpCount(header, LUMP_PLANES, sizeof(dplane_t), length));
+	map_nodes = CM_CarveBlock(base, &size, sizeof(cnode_t) *
+		(CM_LumpCount(header, LUMP_NODES, sizeof(dnode_t), length) + 6));
+	map_leafs = CM_CarveBlock(base, &size, sizeof(cleaf_t) *
+		(CM_LumpCount(header, LUMP_LEAFS, sizeof(dleaf_t), length) + 1));
+	map_brushes = CM_CarveBlock(base, &size, sizeof(cbrush_t) *
+		(CM_LumpCount(header, LUMP_BRUSHES, sizeof(dbrush_t), length) + 1));
+	map_brushsides = CM_CarveBlock(base, &size, sizeof(cbrushside_t) *
+		(CM_LumpCount(header, LUMP_BRUSHSIDES, sizeof(dbrushside_t), length) + 6));
+	map_leafbrushes = CM_CarveBlock(base, &size, sizeof(unsigned short) *
+		(CM_LumpCount(header, LUMP_LEAFBRUSHES, sizeof(unsigned short), length) + 1));
+	map_cmodels = CM_CarveBlock(base, &size, sizeof(cmodel_t) *
+		CM_LumpCount(header, LUMP_MODELS, sizeof(dmodel_t), length));
+	map_surfaces = CM_CarveBlock(base, &size, sizeof(mapsurface_t) *
+		CM_LumpCount(header, LUMP_TEXINFO, sizeof(texinfo_t), length));
+	map_areaportals = CM_CarveBlock(base, &size, sizeof(dareaportal_t) *
+		CM_LumpCount(header, LUMP_AREAPORTALS, sizeof(dareaportal_t), length));
+	map_visibility = CM_CarveBlock(base, &size,
+		CM_LumpCount(header, LUMP_VISIBILITY, 1, length));
+	map_vis = (dvis_t *)map_visibility;
+
+	return size;
+}
+
+static void
+CM_FreeCached(cmcache_t *cm)
+{
+	if (cm->base)
+	{
+		Z_Free(cm->base);
+	}
+
+	if (cm->areas)
+	{
+		Z_Free(cm->areas);
+	}
+
+	if (cm->brushsides4)
+	{
+		Z_Free(cm->brushsides4);
+	}
+
+	if (cm->viscache_base)
+	{
+		Z_Free(cm->viscache_base);
+	}
+
+	memset(cm, 0, sizeof(*cm));
+}
+
+/*
+ * Remembers the freshly loaded map in the cache.
+ */
+static void
+CM_StoreCached(cmcache_t *cm, const char *name, int length,
+		unsigned checksum)
+{
+	Q_strlcpy(cm->name, name, sizeof(cm->name));
+	cm->length = length;
+	cm->checksum = checksum;
+	cm->lastused = ++cmcache_time;
+
+	cm->planes = map_planes;
+	cm->nodes = map_nodes;
+	cm->leafs = map_leafs;
+	cm->brushes = map_brushes;
+	cm->brushsides = map_brushsides;
+	cm->leafbrushes = map_leafbrushes;
+	cm->cmodels = map_cmodels;
+	cm->surfaces = map_surfaces;
+	cm->areaportals = map_areaportals;
+	cm->visibility = map_visibility;
+
+	cm->areas = Z_Malloc(numareas * sizeof(carea_t));
+	memcpy(cm->areas, map_areas, numareas * sizeof(carea_t));
+
+	cm->numplanes = numplanes;
+	cm->numnodes = numnodes;
+	cm->numleafs = numleafs;
+	cm->numbrushes = numbrushes;
+	cm->numbrushsides = numbrushsides;
+	cm->numbrushsides4 = numbrushsides4;
+	cm->numleafbrushes = numleafbrushes;
+	cm->numcmodels = numcmodels;
+	cm->numtexinfo = numtexinfo;
+	cm->numareas = numareas;
+	cm->numareaportals = numareaportals;
+	cm->numvisibility = numvisibility;
+	cm->numclusters = numclusters;
+	cm->emptyleaf = emptyleaf;
+
+	cm->viscache_base = viscache_base;
+	cm->viscache_rows[0] = viscache_rows[0];
+	cm->viscache_rows[1] = viscache_rows[1];
+	cm->viscache_valid[0] = viscache_valid[0];
+	cm->viscache_valid[1] = viscache_valid[1];
+	cm->viscache_rowbytes = viscache_rowbytes;
+}
+
+/*
+ * Makes a cached map the one in use.
+ */
+static void
+CM_UseCached(cmcache_t *cm)
+{
+	cm->lastused = ++cmcache_time;
+
+	map_planes = cm->planes;
+	map_nodes = cm->nodes;
+	map_leafs = cm->leafs;
+	map_brushes = cm->brushes;
+	map_brushsides = cm->brushsides;
+	map_brushsides4 = cm->brushsides4;
+	map_leafbrushes = cm->leafbrushes;
+	map_cmodels = cm->cmodels;
+	map_surfaces = cm->surfaces;
+	map_areaportals = cm->areaportals;
+	map_visibility = cm->visibility;
+	map_vis = (dvis_t *)map_visibility;
+
+	numplanes = cm->numplanes;
+	numnodes = cm->numnodes;
+	numleafs = cm->numleafs;
+	numbrushes = cm->numbrushes;
+	numbrushsides = cm->numbrushsides;
+	numbrushsides4 = cm->numbrushsides4;
+	numleafbrushes = cm->numleafbrushes;
+	numcmodels = cm->numcmodels;
+	numtexinfo = cm->numtexinfo;
+	numareas = cm->numareas;
+	numareaportals = cm->numareaportals;
+	numvisibility = cm->numvisibility;
+	numclusters = cm->numclusters;
+	emptyleaf = cm->emptyleaf;
+
+	memcpy(map_areas, cm->areas, numareas * sizeof(carea_t));
+
+	viscache_base = cm->viscache_base;
+	viscache_rows[0] = cm->viscache_rows[0];
+	viscache_rows[1] = cm->viscache_rows[1];
+	viscache_valid[0] = cm->viscache_valid[0];
+	viscache_valid[1] = cm->viscache_valid[1];
+	viscache_rowbytes = cm->viscache_rowbytes;
+
+	box_headnode = numnodes;
+	box_sides4 = &map_brushsides4[map_brushes[numbrushes].firstsides4];
+
+	Q_strlcpy(map_name, cm->name, sizeof(map_name));
+}
+
+/*
+ * Throws out the least recently used maps until at
+ * most keep are left. Returns a free slot. Must not
+ * be called while a cached map is in use.
+ */
+static cmcache_t *
+CM_TrimCache(int keep)
+{
+	cmcache_t *oldest, *free;
+	int i, used;
+
+	for ( ; ; )
+	{
+		oldest = NULL;
+		free = NULL;
+		used = 0;
+
+		for (i = 0; i < CMCACHE_MAX; i++)
+		{
+			cmcache_t *cm = &cmcache[i];
+
+			if (!cm->base)
+			{
+				free = cm;
+				continue;
+			}
+
+			used++;
+
+			if (!oldest || (cm->lastused < oldest->lastused))
+			{
+				oldest = cm;
+			}
+		}
+
+		if (used <= keep)
+		{
+			return free;
+		}
+
+		CM_FreeCached(oldest);
+	}
+}
+
+/*
+ * Forgets the map in use, leaving just enough for
+ * the leaf functions to work.
+ */
+static void
+CM_ClearMap(void)
+{
+	map_planes = NULL;
+	map_nodes = NULL;
+	map_leafs = &nullleaf;
+	map_brushes = NULL;
+	map_brushsides = NULL;
+	map_brushsides4 = NULL;
+	box_sides4 = NULL;
+
+	/* a recording belongs to one map */
+	maxtracerecs = numtracerecs;
+
+	CM_NewFrame();
+	map_leafbrushes = NULL;
+	map_cmodels = &nullcmodel;
+	map_surfaces = NULL;
+	map_areaportals = NULL;
+	map_visibility = NULL;
+	map_vis = NULL;
+
+	numplanes = 0;
+	numnodes = 0;
+	numleafs = 1;
+	numbrushes = 0;
+	numbrushsides = 0;
+	numbrushsides4 = 0;
+	numleafbrushes = 0;
+	numcmodels = 0;
+	numtexinfo = 0;
+	numareas = 1;
+	numareaportals = 0;
+	numvisibility = 0;
+	numentitychars = 0;
+	numclusters = 1;
+
+	map_entitystring[0] = 0;
+	map_name[0] = 0;
+
+	viscache_base = NULL;
+}
+
 /*
  * Loads in the map and all submodels
  */
@@ -1722,11 +3146,19 @@ CM_LoadMap(const char *name, qboolean clientload, unsigned *checksum)
 	dheader_t header;
 	int length;
 	static unsigned last_checksum;
+	qboolean flush;
+	cmcache_t *cm;
+	byte *block;
+	size_t size;
+	int maxcached;
 
 	map_noareas = Cvar_Get("map_noareas", "0", 0);
+	cm_viscache = Cvar_Get("cm_viscache", "32", 0);
+	cm_cachemaps = Cvar_Get("cm_cachemaps", "4", 0);
+
+	flush = !clientload && Cvar_VariableValue("flushmap");
 
-	if (strcmp(map_name, name) == 0
-		&& (clientload || !Cvar_VariableValue("flushmap")))
+	if (strcmp(map_name, name) == 0 && !flush)
 	{
 		*checksum = last_checksum;
 
@@ -1740,20 +3172,10 @@ CM_LoadMap(const char *name, qboolean clientload, unsigned *checksum)
 	}
 
 	/* free old stuff */
-	numplanes = 0;
-	numnodes = 0;
-	numleafs = 0;
-	numcmodels = 0;
-	numvisibility = 0;
-	numentitychars = 0;
-	map_entitystring[0] = 0;
-	map_name[0] = 0;
+	CM_ClearMap();
 
 	if (!name[0])
 	{
-		numleafs = 1;
-		numclusters = 1;
-		numareas = 1;
 		*checksum = 0;
 		return &map_cmodels[0]; /* cinematic servers won't have anything at all */
 	}
@@ -1777,13 +3199,60 @@ CM_LoadMap(const char *name, qboolean clientload, unsigned *checksum)
 
 	if (header.version != BSPVERSION)
 	{
+		FS_FreeFile(buf);
 		Com_Error(ERR_DROP,
 				"CMod_LoadBrushModel: %s has wrong version number (%i should be %i)",
 				name, header.version, BSPVERSION);
 	}
 
+	maxcached = Q_min(Q_max((int)cm_cachemaps->value, 1), CMCACHE_MAX);
+	CM_TrimCache(maxcached);
+
+	/* a map parsed before, if the file didn't change */
+	for (i = 0; i < CMCACHE_MAX; i++)
+	{
+		cm = &cmcache[i];
+
+		if (!cm->base || strcmp(cm->name, name))
+		{
+			continue;
+		}
+
+		if (flush || (cm->length != length) ||
+			(cm->checksum != last_checksum))
+		{
+			CM_FreeCached(cm);
+			continue;
+		}
+
+		Com_DPrintf("%s: using cached collision model\n", name);
+		CM_UseCached(cm);
+
+		/* always read again, the .ent file may have changed */
+		cmod_base = (byte *)buf;
+		CMod_LoadEntityString(&header.lumps[LUMP_ENTITIES], name);
+		FS_FreeFile(buf);
+
+		memset(portalopen, 0, sizeof(portalopen));
+		FloodAreaConnections();
+
+		return &map_cmodels[0];
+	}
+
 	cmod_base = (byte *)buf;
 
+	/* The slot owns the block from here on, even
+	   if loading fails. It's only found by name
+	   after everything was loaded. */
+	cm = CM_TrimCache(maxcached - 1);
+	size = CM_LayoutBlock(&header, length, NULL);
+	cm->base = Z_Malloc(size + CMCACHE_ALIGN);
+	cm->size = size;
+
+	block = (byte *)(((uintptr_t)cm->base + CMCACHE_ALIGN - 1) &
+		~(uintptr_t)(CMCACHE_ALIGN - 1));
+	CM_LayoutBlock(&header, length, block);
+
 	/* load into heap */
 	CMod_LoadSurfaces(&header.lumps[LUMP_TEXINFO]);
 	CMod_LoadLeafs(&header.lumps[LUMP_LEAFS]);
@@ -1791,6 +3260,7 @@ CM_LoadMap(const char *name, qboolean clientload, unsigned *checksum)
 	CMod_LoadPlanes(&header.lumps[LUMP_PLANES]);
 	CMod_LoadBrushes(name, &header.lumps[LUMP_BRUSHES]);
 	CMod_LoadBrushSides(&header.lumps[LUMP_BRUSHSIDES]);
+	cm->brushsides4 = map_brushsides4;
 	CMod_LoadSubmodels(name, &header.lumps[LUMP_MODELS]);
 	CMod_LoadNodes(name, &header.lumps[LUMP_NODES]);
 	CMod_LoadAreas(&header.lumps[LUMP_AREAS]);
@@ -1802,6 +3272,11 @@ CM_LoadMap(const char *name, qboolean clientload, unsigned *checksum)
 	FS_FreeFile(buf);
 
 	CM_InitBoxHull();
+	CM_InitVisCache();
+
+	CM_StoreCached(cm, name, length, last_checksum);
+	Com_DPrintf("%s: collision model takes " YQ2_COM_PRIdS " bytes\n",
+			name, size);
 
 	memset(portalopen, 0, sizeof(portalopen));
 	FloodAreaConnections();
@@ -1932,36 +3407,55 @@ CM_DecompressVis(byte *in, byte *out)
 	while (out_p - out < row);
 }
 
-byte *
-CM_ClusterPVS(int cluster)
+static const byte *
+CM_ClusterVis(int cluster, int type, byte *scratch)
 {
+	byte *row;
+
 	if (cluster == -1)
 	{
-		memset(pvsrow, 0, (numclusters + 7) >> 3);
+		return nullrow;
 	}
-	else
+
+	if (!numvisibility)
 	{
-		CM_DecompressVis(map_visibility +
-				LittleLong(map_vis->bitofs[cluster][DVIS_PVS]), pvsrow);
-	}
+		CM_DecompressVis(NULL, scratch);
 
-	return pvsrow;
-}
+		return scratch;
+	}
 
-byte *
-CM_ClusterPHS(int cluster)
-{
-	if (cluster == -1)
+	if (!viscache_base)
 	{
-		memset(phsrow, 0, (numclusters + 7) >> 3);
+		CM_DecompressVis(map_visibility +
+				LittleLong(map_vis->bitofs[cluster][type]), scratch);
+
+		return scratch;
 	}
 
-	else
+	row = viscache_rows[type] + viscache_rowbytes * cluster;
+
+	if (!viscache_valid[type][cluster])
 	{
 		CM_DecompressVis(map_visibility +
-				LittleLong(map_vis->bitofs[cluster][DVIS_PHS]), phsrow);
+				LittleLong(map_vis->bitofs[cluster][type]), row);
+		viscache_valid[type][cluster] = 1;
 	}
 
-	return phsrow;
+	return row;
+}
+
+/*
+ * The returned rows are owned by the collision model. They
+ * may point into the vis cache and must not be written to.
+ */
+const byte *
+CM_ClusterPVS(int cluster)
+{
+	return CM_ClusterVis(cluster, DVIS_PVS, pvsrow);
 }
 
+const byte *
+CM_ClusterPHS(int cluster)
+{
+	return CM_ClusterVis(cluster, DVIS_PHS, phsrow);
+}
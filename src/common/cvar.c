@@ -28,6 +28,9 @@
 
 cvar_t *cvar_vars;
 
+/* Lookup table, the list above stays sorted for cvarlist */
+#define CVAR_HASH_SIZE 1024
+static cvar_t *cvar_hash[CVAR_HASH_SIZE];
 
 typedef struct
 {
@@ -171,7 +174,9 @@ Cvar_FindVar(const char *var_name)
 {
 	cvar_t *var;
 
-	for (var = cvar_vars; var; var = var->next)
+	var = cvar_hash[Q_strhash(var_name) & (CVAR_HASH_SIZE - 1)];
+
+	for ( ; var; var = var->hash_next)
 	{
 		if (!strcmp(var_name, var->name))
 		{
@@ -249,6 +254,7 @@ Cvar_AddToList(const char *var_name, const char *var_value, int flags)
 {
 	cvar_t *var;
 	cvar_t **pos;
+	unsigned int hash;
 
 	var = Z_Malloc(sizeof(*var));
 
@@ -269,6 +275,10 @@ Cvar_AddToList(const char *var_name, const char *var_value, int flags)
 	var->next = *pos;
 	*pos = var;
 
+	hash = Q_strhash(var->name) & (CVAR_HASH_SIZE - 1);
+	var->hash_next = cvar_hash[hash];
+	cvar_hash[hash] = var;
+
 	return var;
 }
 
@@ -918,6 +928,7 @@ void
 Cvar_Init(void)
 {
 	cvar_vars = NULL;
+	memset(cvar_hash, 0, sizeof(cvar_hash));
 
 	Cmd_AddCommand("cvarlist", Cvar_List_f);
 	Cmd_AddCommand("dec", Cvar_Inc_f);
@@ -951,6 +962,7 @@ Cvar_FreeList(void)
 	}
 
 	cvar_vars = NULL;
+	memset(cvar_hash, 0, sizeof(cvar_hash));
 }
 
 void
@@ -32,6 +32,8 @@
 #include "header/common.h"
 #include "header/glob.h"
 
+#include <limits.h>
+
 #ifdef USE_SYSTEM_MINIZIP
 #include <minizip/unzip.h>
 #else
@@ -43,6 +45,11 @@
 #define MAX_HANDLES 512
 #define MAX_MODS 32
 #define MAX_PAKS 100
+#define MAPPING_BUCKETS 64
+
+/* Files smaller than this are always copied,
+   mapping them costs more than it saves. */
+#define MAP_MINSIZE (16 * 1024)
 
 #ifdef SYSTEMWIDE
  #ifndef SYSTEMDIR
@@ -56,8 +63,18 @@ typedef struct
 	fsMode_t mode;
 	FILE *file;           /* Only one will be used. */
 	unzFile *zip;        /* (file or zip) */
+	struct fsPack_s *pack; /* Set if zip is borrowed from the pack. */
+	qboolean packed;       /* file points into a PAK or PK3. */
 } fsHandle_t;
 
+typedef struct fsMapping_s
+{
+	void *data;     /* What FS_LoadFile() returned. */
+	void *base;     /* What Sys_MapFile() mapped. */
+	size_t size;
+	struct fsMapping_s *next;
+} fsMapping_t;
+
 typedef struct fsLink_s
 {
 	char *from;
@@ -70,15 +87,18 @@ typedef struct
 {
 	char name[MAX_QPATH];
 	int size;
-	int offset;     /* Ignored in PK3 files. */
+	int offset;     /* PK3: start of stored data, -1 if not yet known. */
+	unz_file_pos zippos; /* Only used in PK3 files. */
+	qboolean stored; /* Uncompressed PK3 entry. */
 } fsPackFile_t;
 
-typedef struct
+typedef struct fsPack_s
 {
 	char name[MAX_OSPATH];
 	int numFiles;
 	FILE *pak;
 	unzFile *pk3;
+	qboolean pk3InUse; /* pk3 is lent to a file handle. */
 	qboolean isProtectedPak;
 	fsPackFile_t *files;
 } fsPack_t;
@@ -90,6 +110,26 @@ typedef struct fsSearchPath_s
 	struct fsSearchPath_s *next;
 } fsSearchPath_t;
 
+/*
+ * Index of all files visible in the search path, so
+ * FS_FOpenFile() doesn't need to search every pack and
+ * probe every directory. Loose files are indexed, too.
+ * Only the game directory is written to at runtime, it's
+ * the only directory that's always probed.
+ *
+ * One hash lookup finds all copies of a file, linked in
+ * search path order by nextSame.
+ */
+typedef struct
+{
+	unsigned int hash;
+	int next;                     /* Next in bucket, -1 ends the chain. */
+	int nextSame;                 /* Same file further down the path, or -1. */
+	const fsSearchPath_t *search; /* Where the file was found. */
+	fsPackFile_t *file;           /* NULL for loose files. */
+	char *name;                   /* Owned by the index for loose files. */
+} fsIndexEntry_t;
+
 typedef enum
 {
 	PAK,
@@ -103,6 +143,7 @@ typedef struct
 } fsPackTypes_t;
 
 fsHandle_t fs_handles[MAX_HANDLES];
+static fsMapping_t *fs_mappings[MAPPING_BUCKETS];
 fsLink_t *fs_links = NULL;
 fsSearchPath_t *fs_searchPaths = NULL;
 fsSearchPath_t *fs_baseSearchPaths = NULL;
@@ -124,6 +165,21 @@ cvar_t *fs_basedir;
 cvar_t *fs_cddir;
 cvar_t *fs_gamedirvar;
 cvar_t *fs_debug;
+cvar_t *fs_mmap;
+cvar_t *fs_index;
+
+static fsIndexEntry_t *fs_indexEntries;
+static int fs_numIndexEntries;
+static int fs_maxIndexEntries;
+static int *fs_indexBuckets;
+static unsigned int fs_indexMask;
+static const fsSearchPath_t *fs_indexGamedir;
+
+/* Statistics, printed by fs_stats. */
+static int fs_lookups;
+static int fs_lookupsFound;
+static int fs_dirProbes;
+static long long fs_lookupTime;
 
 fsHandle_t *FS_GetFileByHandle(fileHandle_t f);
 
@@ -361,7 +417,16 @@ FS_FCloseFile(fileHandle_t f)
 	else if (handle->zip)
 	{
 		unzCloseCurrentFile(handle->zip);
-		unzClose(handle->zip);
+
+		if (handle->pack)
+		{
+			/* Borrowed from the pack, just give it back. */
+			handle->pack->pk3InUse = false;
+		}
+		else
+		{
+			unzClose(handle->zip);
+		}
 	}
 
 	memset(handle, 0, sizeof(*handle));
@@ -415,87 +480,303 @@ FS_PackQuickSearch(const fsPack_t *pak, const char *name)
 	return -1;
 }
 
+static void
+FS_FreeIndex(void)
+{
+	int i;
+
+	for (i = 0; i < fs_numIndexEntries; i++)
+	{
+		if (!fs_indexEntries[i].file)
+		{
+			Z_Free(fs_indexEntries[i].name);
+		}
+	}
+
+	if (fs_indexEntries)
+	{
+		Z_Free(fs_indexEntries);
+	}
+
+	if (fs_indexBuckets)
+	{
+		Z_Free(fs_indexBuckets);
+	}
+
+	fs_indexEntries = NULL;
+	fs_indexBuckets = NULL;
+	fs_numIndexEntries = 0;
+	fs_maxIndexEntries = 0;
+	fs_indexMask = 0;
+	fs_indexGamedir = NULL;
+}
+
+static void
+FS_AddIndexEntry(const fsSearchPath_t *search, fsPackFile_t *file, char *name)
+{
+	fsIndexEntry_t *entry;
+
+	if (fs_numIndexEntries == fs_maxIndexEntries)
+	{
+		fs_maxIndexEntries = fs_maxIndexEntries ? fs_maxIndexEntries * 2 : 4096;
+		fs_indexEntries = Z_Realloc(fs_indexEntries,
+			fs_maxIndexEntries * sizeof(fsIndexEntry_t));
+	}
+
+	entry = &fs_indexEntries[fs_numIndexEntries++];
+	entry->search = search;
+	entry->file = file;
+	entry->name = name;
+	entry->hash = Q_strhash(name);
+}
+
 /*
- * Finds the file in the search path. Returns filesize and an open FILE *. Used
- * for streaming data out of either a pak file or a seperate file.
+ * Adds all files below the given directory. prefixlen is
+ * the length of the search path, it's cut from the names.
  */
-int
-FS_FOpenFile(const char *rawname, fileHandle_t *f, qboolean gamedir_only)
+static void
+FS_IndexDirectory(const fsSearchPath_t *search, const char *dir,
+		size_t prefixlen, int depth)
+{
+	char findname[MAX_OSPATH];
+	strlist_t list;
+	int i;
+
+	if (depth > 16)
+	{
+		return;
+	}
+
+	Com_sprintf(findname, sizeof(findname), "%s/*", dir);
+	list = FS_ListFiles(findname, 0, 0);
+
+	for (i = 0; i < list.num; i++)
+	{
+		if (Sys_IsDir(list.data[i]))
+		{
+			FS_IndexDirectory(search, list.data[i], prefixlen, depth + 1);
+		}
+		else if (strlen(list.data[i]) > prefixlen + 1)
+		{
+			FS_AddIndexEntry(search, NULL, CopyString(list.data[i] + prefixlen + 1));
+		}
+	}
+
+	StrList_Free(&list);
+}
+
+/*
+ * (Re)builds the index. Must be called whenever the search
+ * path changes.
+ */
+static void
+FS_BuildIndex(void)
 {
-	char path[MAX_OSPATH], lwrName[MAX_OSPATH];
-	fsHandle_t *handle;
-	fsPack_t *pack;
 	fsSearchPath_t *search;
-	int input, output;
+	unsigned int size;
+	int i;
 
-	*f = 0;
+	FS_FreeIndex();
 
-	// Remove self references and empty dirs from the requested path.
-	// ZIPs and PAKs don't support them, but they may be hardcoded in
-	// some custom maps or models.
-	char name[MAX_OSPATH] = {0};
-	size_t namelen = strlen(rawname);
-	if (namelen > sizeof(name) - 1)
+	if (!fs_index->value)
 	{
-		Com_Printf("%s: used unexpectly long name: %s\n", __func__, rawname);
-		return -1;
+		return;
 	}
 
-	for (input = 0, output = 0; input < namelen; input++)
+	for (search = fs_searchPaths; search; search = search->next)
 	{
-		// Remove self reference.
-		if (rawname[input] == '.')
+		if (search->pack)
 		{
-			if (output > 0)
+			for (i = 0; i < search->pack->numFiles; i++)
 			{
-				// Inside the path.
-				if (name[output - 1] == '/' && rawname[input + 1] == '/')
-				{
-					input++;
-					continue;
-				}
+				FS_AddIndexEntry(search, &search->pack->files[i],
+					search->pack->files[i].name);
 			}
-			else
+		}
+		else
+		{
+			FS_IndexDirectory(search, search->path, strlen(search->path), 0);
+
+			if (!strcmp(search->path, fs_gamedir))
 			{
-				// At the beginning. Note: This is save because the Quake II
-				// VFS doesn't have a current working dir. Paths are always
-				// absolute.
-				if (rawname[input + 1] == '/')
-				{
-					continue;
-				}
+				fs_indexGamedir = search;
 			}
 		}
+	}
 
-		// Empty dir.
-		if (rawname[input] == '/')
+	/* At least twice as many buckets as entries. */
+	for (size = 1024; size < 2 * (unsigned int)fs_numIndexEntries; size <<= 1)
+	{
+	}
+
+	fs_indexBuckets = Z_Malloc(size * sizeof(int));
+	fs_indexMask = size - 1;
+
+	for (i = 0; i < size; i++)
+	{
+		fs_indexBuckets[i] = -1;
+	}
+
+	/* Backwards, so the chains are in search path order. */
+	for (i = fs_numIndexEntries - 1; i >= 0; i--)
+	{
+		unsigned int bucket = fs_indexEntries[i].hash & fs_indexMask;
+
+		fs_indexEntries[i].next = fs_indexBuckets[bucket];
+		fs_indexBuckets[bucket] = i;
+	}
+
+	for (i = 0; i < fs_numIndexEntries; i++)
+	{
+		fsIndexEntry_t *entry = &fs_indexEntries[i];
+		int j;
+
+		entry->nextSame = -1;
+
+		for (j = entry->next; j != -1; j = fs_indexEntries[j].next)
 		{
-			if (rawname[input + 1] == '/')
+			if ((fs_indexEntries[j].hash == entry->hash) &&
+				!Q_stricmp(fs_indexEntries[j].name, entry->name))
 			{
-				continue;
+				entry->nextSame = j;
+				break;
 			}
 		}
+	}
 
-		// Paths starting with a /. I'm not sure if this is
-		// a problem. It shouldn't hurt to remove the leading
-		// slash, though.
-		if (rawname[input] == '/' && output == 0)
+	FS_DPrintf("%s: %i files, %u buckets.\n", __func__, fs_numIndexEntries, size);
+}
+
+/*
+ * Returns the index entry for name from the first search path
+ * element that has it, NULL if none has. The others follow by
+ * nextSame. hash is Q_strhash(name).
+ */
+static fsIndexEntry_t *
+FS_IndexFind(const char *name, unsigned int hash)
+{
+	int i;
+
+	for (i = fs_indexBuckets[hash & fs_indexMask]; i != -1; i = fs_indexEntries[i].next)
+	{
+		fsIndexEntry_t *entry = &fs_indexEntries[i];
+
+		if ((entry->hash == hash) && !Q_stricmp(entry->name, name))
 		{
-			continue;
+			return entry;
 		}
+	}
 
-		name[output] = rawname[input];
-		output++;
+	return NULL;
+}
+
+/*
+ * Returns the copy of the file in search, if the search path
+ * element has one. entry is advanced past it, the search path
+ * has to be walked in order.
+ */
+static fsIndexEntry_t *
+FS_IndexMatch(fsIndexEntry_t **entry, const fsSearchPath_t *search)
+{
+	fsIndexEntry_t *match = *entry;
+
+	if (!match || (match->search != search))
+	{
+		return NULL;
 	}
 
-	file_from_protected_pak = false;
-	handle = FS_HandleForFile(name, f);
-	Q_strlcpy(handle->name, name, sizeof(handle->name));
-	handle->mode = FS_READ;
+	*entry = (match->nextSame != -1) ? &fs_indexEntries[match->nextSame] : NULL;
+
+	return match;
+}
+
+/*
+ * Returns the offset of a stored (uncompressed) PK3 entry's data
+ * inside the archive, or -1 if the entry must go through unzip.
+ * The offset is looked up once through the packs own archive
+ * handle and remembered afterwards.
+ */
+static int
+FS_PK3DataOffset(fsPack_t *pack, fsPackFile_t *entry)
+{
+	ZPOS64_T pos;
+
+	if (!entry->stored)
+	{
+		return -1;
+	}
+
+	if ((entry->offset >= 0) || pack->pk3InUse)
+	{
+		return entry->offset;
+	}
+
+	if (unzGoToFilePos(pack->pk3, &entry->zippos) != UNZ_OK)
+	{
+		return -1;
+	}
+
+	if (unzOpenCurrentFile(pack->pk3) != UNZ_OK)
+	{
+		return -1;
+	}
+
+	pos = unzGetCurrentFileZStreamPos64(pack->pk3);
+	unzCloseCurrentFile(pack->pk3);
+
+	if ((pos == 0) || (pos > INT_MAX))
+	{
+		entry->stored = false;
+		return -1;
+	}
+
+	entry->offset = (int)pos;
+
+	return entry->offset;
+}
+
+/*
+ * Opens the file given by handle->name from the first search
+ * path element that has it. Returns the size, -1 if the file
+ * wasn't found.
+ */
+static int
+FS_SearchFile(fsHandle_t *handle, unsigned int hash, qboolean gamedir_only)
+{
+	char path[MAX_OSPATH], lwrName[MAX_OSPATH];
+	fsIndexEntry_t *entry, *next = NULL;
+	fsSearchPath_t *search;
+	fsPack_t *pack;
+
+	/* All copies of the file at once. Without any the
+	   file can still be in the game dir, but nowhere
+	   else. */
+	if (fs_indexBuckets)
+	{
+		next = FS_IndexFind(handle->name, hash);
+
+		if (!next && !fs_indexGamedir)
+		{
+			return -1;
+		}
+	}
 
 	/* Search through the path, one element at a time. */
 	for (search = fs_searchPaths; search; search = search->next)
 	{
+		/* Only a pointer compare per element with the index. */
+		entry = fs_indexBuckets ? FS_IndexMatch(&next, search) : NULL;
+
+		if (fs_indexBuckets && !entry && (search != fs_indexGamedir))
+		{
+			if (!next && !fs_indexGamedir)
+			{
+				break;
+			}
+
+			continue;
+		}
+
 		if (gamedir_only)
 		{
 			if (strstr(search->path, FS_Gamedir()) == NULL)
@@ -508,9 +789,9 @@ FS_FOpenFile(const char *rawname, fileHandle_t *f, qboolean gamedir_only)
 		// TODO: A flag to ignore paks would be better
 		if ((strcmp(fs_gamedirvar->string, "") == 0) && search->pack)
 		{
-			if ((!strcmp(name, "maps.lst")) || (!strncmp(name, "players/", 8)))
+			if ((!strcmp(handle->name, "maps.lst")) || (!strncmp(handle->name, "players/", 8)))
 			{
-				if (FS_FileInGamedir(name))
+				if (FS_FileInGamedir(handle->name))
 				{
 					continue;
 				}
@@ -523,7 +804,15 @@ FS_FOpenFile(const char *rawname, fileHandle_t *f, qboolean gamedir_only)
 			int i;
 
 			pack = search->pack;
-			i = FS_PackQuickSearch(pack, handle->name);
+
+			if (fs_indexBuckets)
+			{
+				i = (int)(entry->file - pack->files);
+			}
+			else
+			{
+				i = FS_PackQuickSearch(pack, handle->name);
+			}
 
 			if (i >= 0)
 			{
@@ -551,6 +840,7 @@ FS_FOpenFile(const char *rawname, fileHandle_t *f, qboolean gamedir_only)
 
 					if (handle->file)
 					{
+						handle->packed = true;
 						fseek(handle->file, pack->files[i].offset, SEEK_SET);
 						return pack->files[i].size;
 					}
@@ -558,28 +848,72 @@ FS_FOpenFile(const char *rawname, fileHandle_t *f, qboolean gamedir_only)
 				else if (pack->pk3)
 				{
 					/* PK3 */
+					fsPackFile_t *entry;
+					int offset;
+
+					entry = &pack->files[i];
+
 					if (pack->isProtectedPak)
 					{
 						file_from_protected_pak = true;
 					}
 
+					/* Stored files are read like files in
+					   PAKs, unzip isn't needed for them. */
+					offset = FS_PK3DataOffset(pack, entry);
+
+					if (offset >= 0)
+					{
+						handle->file = Q_fopen(pack->name, "rb");
+
+						if (handle->file)
+						{
+							handle->packed = true;
+							fseek(handle->file, offset, SEEK_SET);
+							return entry->size;
+						}
+					}
+
+					/* Use the packs archive handle if it's free,
+					   open a second one if it's not. */
+					if (!pack->pk3InUse)
+					{
+						handle->zip = pack->pk3;
+						handle->pack = pack;
+						pack->pk3InUse = true;
+					}
+					else
+					{
 #ifdef _WIN32
-					handle->zip = unzOpen2(pack->name, &zlib_file_api);
+						handle->zip = unzOpen2(pack->name, &zlib_file_api);
 #else
-					handle->zip = unzOpen(pack->name);
+						handle->zip = unzOpen(pack->name);
 #endif
+					}
 
 					if (handle->zip)
 					{
-						if (unzLocateFile(handle->zip, handle->name, 2) == UNZ_OK)
+						/* Jump straight to the central directory
+						   entry recorded by FS_LoadPK3(). */
+						if (unzGoToFilePos(handle->zip, &entry->zippos) == UNZ_OK)
 						{
 							if (unzOpenCurrentFile(handle->zip) == UNZ_OK)
 							{
-								return pack->files[i].size;
+								return entry->size;
 							}
 						}
 
-						unzClose(handle->zip);
+						if (handle->pack)
+						{
+							pack->pk3InUse = false;
+						}
+						else
+						{
+							unzClose(handle->zip);
+						}
+
+						handle->zip = NULL;
+						handle->pack = NULL;
 					}
 				}
 
@@ -589,6 +923,8 @@ FS_FOpenFile(const char *rawname, fileHandle_t *f, qboolean gamedir_only)
 		}
 		else
 		{
+			fs_dirProbes++;
+
 			/* Search in a directory tree. */
 			Com_sprintf(path, sizeof(path), "%s/%s", search->path, handle->name);
 
@@ -614,6 +950,107 @@ FS_FOpenFile(const char *rawname, fileHandle_t *f, qboolean gamedir_only)
 			}
 		}
 	}
+
+	return -1;
+}
+
+/*
+ * Finds the file in the search path. Returns filesize and an open FILE *. Used
+ * for streaming data out of either a pak file or a seperate file.
+ */
+int
+FS_FOpenFile(const char *rawname, fileHandle_t *f, qboolean gamedir_only)
+{
+	fsHandle_t *handle;
+	int input, output;
+	unsigned int hash;
+	long long start;
+	int size;
+
+	*f = 0;
+
+	// Remove self references and empty dirs from the requested path.
+	// ZIPs and PAKs don't support them, but they may be hardcoded in
+	// some custom maps or models.
+	char name[MAX_OSPATH] = {0};
+	size_t namelen = strlen(rawname);
+	if (namelen > sizeof(name) - 1)
+	{
+		Com_Printf("%s: used unexpectly long name: %s\n", __func__, rawname);
+		return -1;
+	}
+
+	for (input = 0, output = 0; input < namelen; input++)
+	{
+		// Remove self reference.
+		if (rawname[input] == '.')
+		{
+			if (output > 0)
+			{
+				// Inside the path.
+				if (name[output - 1] == '/' && rawname[input + 1] == '/')
+				{
+					input++;
+					continue;
+				}
+			}
+			else
+			{
+				// At the beginning. Note: This is save because the Quake II
+				// VFS doesn't have a current working dir. Paths are always
+				// absolute.
+				if (rawname[input + 1] == '/')
+				{
+					continue;
+				}
+			}
+		}
+
+		// Empty dir.
+		if (rawname[input] == '/')
+		{
+			if (rawname[input + 1] == '/')
+			{
+				continue;
+			}
+		}
+
+		// Paths starting with a /. I'm not sure if this is
+		// a problem. It shouldn't hurt to remove the leading
+		// slash, though.
+		if (rawname[input] == '/' && output == 0)
+		{
+			continue;
+		}
+
+		name[output] = rawname[input];
+		output++;
+	}
+
+	file_from_protected_pak = false;
+	handle = FS_HandleForFile(name, f);
+	Q_strlcpy(handle->name, name, sizeof(handle->name));
+	handle->mode = FS_READ;
+
+	if (fs_index->modified)
+	{
+		fs_index->modified = false;
+		FS_BuildIndex();
+	}
+
+	start = Sys_Microseconds();
+	hash = Q_strhash(name);
+	size = FS_SearchFile(handle, hash, gamedir_only);
+
+	fs_lookups++;
+	fs_lookupTime += Sys_Microseconds() - start;
+
+	if (size >= 0)
+	{
+		fs_lookupsFound++;
+		return size;
+	}
+
 	if (fs_debug->value)
 	{
 		Com_Printf("%s: couldn't find '%s'.\n", __func__, handle->name);
@@ -757,11 +1194,75 @@ FS_FRead(void *buffer, int size, int count, fileHandle_t f)
 	return size;
 }
 
+static unsigned int
+FS_MappingBucket(const void *data)
+{
+	return (unsigned int)(((size_t)data >> 12) & (MAPPING_BUCKETS - 1));
+}
+
+/*
+ * Maps the remainder of the given PAK entry or stored PK3
+ * entry into memory instead of reading it. Loose files are
+ * always read, they may be changed or truncated while they
+ * are mapped. Packs don't change while they are mounted.
+ * The mapping is copy-on-write, so callers can treat it
+ * like any other buffer. Only pages that are written to get
+ * copied. Returns NULL if the file must be read.
+ */
+static void *
+FS_MapFile(fsHandle_t *handle, int size, int pad)
+{
+	fsMapping_t *mapping;
+	unsigned int bucket;
+	void *base;
+	size_t mapsize;
+	byte *data;
+	long offset;
+
+	if (!fs_mmap->value || !handle->file || !handle->packed ||
+		(size < MAP_MINSIZE))
+	{
+		return NULL;
+	}
+
+	/* The loaders cast into the buffer, keep
+	   the same alignment a copy would have. */
+	offset = ftell(handle->file);
+
+	if ((offset < 0) || (offset & 3))
+	{
+		return NULL;
+	}
+
+	data = Sys_MapFile(handle->file, offset, size + pad, &base, &mapsize);
+
+	if (!data)
+	{
+		return NULL;
+	}
+
+	/* The padding is taken from whatever follows
+	   the file, clear it like Z_Malloc() would. */
+	memset(data + size, 0, pad);
+
+	mapping = Z_Malloc(sizeof(*mapping));
+	mapping->data = data;
+	mapping->base = base;
+	mapping->size = mapsize;
+
+	bucket = FS_MappingBucket(data);
+	mapping->next = fs_mappings[bucket];
+	fs_mappings[bucket] = mapping;
+
+	return data;
+}
+
 /*
  * Filename is reletive to the quake search path
  * A null buffer will just return the file length
  * pad adds bytes at the end of the buffer
  * The buffer must be freed by the caller with FS_FreeFile
+ * The buffer may be mapped from disk, see FS_MapFile()
  */
 int
 FS_LoadFile2(const char *path, void **buffer, int pad)
@@ -788,8 +1289,13 @@ FS_LoadFile2(const char *path, void **buffer, int pad)
 
 	if (buffer)
 	{
-		*buffer = Z_Malloc(size + (pad < 0 ? 0 : pad));
-		FS_Read(*buffer, size, f);
+		*buffer = FS_MapFile(FS_GetFileByHandle(f), size, (pad < 0 ? 0 : pad));
+
+		if (!*buffer)
+		{
+			*buffer = Z_Malloc(size + (pad < 0 ? 0 : pad));
+			FS_Read(*buffer, size, f);
+		}
 	}
 
 	FS_FCloseFile(f);
@@ -806,12 +1312,27 @@ FS_LoadFile(const char *path, void **buffer)
 void
 FS_FreeFile(void *buffer)
 {
+	fsMapping_t **link, *mapping;
+
 	if (buffer == NULL)
 	{
 		FS_DPrintf("FS_FreeFile: NULL buffer.\n");
 		return;
 	}
 
+	for (link = &fs_mappings[FS_MappingBucket(buffer)]; *link; link = &(*link)->next)
+	{
+		mapping = *link;
+
+		if (mapping->data == buffer)
+		{
+			*link = mapping->next;
+			Sys_UnmapFile(mapping->base, mapping->size);
+			Z_Free(mapping);
+			return;
+		}
+	}
+
 	Z_Free(buffer);
 }
 
@@ -837,6 +1358,9 @@ FS_FreeSearchPaths(fsSearchPath_t *start, fsSearchPath_t *end)
 	fsSearchPath_t *cur = start;
 	fsSearchPath_t *next;
 
+	/* The index points into the packs. */
+	FS_FreeIndex();
+
 	while (cur != end)
 	{
 		if (cur->pack)
@@ -846,7 +1370,21 @@ FS_FreeSearchPaths(fsSearchPath_t *start, fsSearchPath_t *end)
 				fclose(cur->pack->pak);
 			}
 
-			if (cur->pack->pk3)
+			if (cur->pack->pk3InUse)
+			{
+				int i;
+
+				/* A file handle still reads through the packs
+				   archive handle. Hand it over to the file. */
+				for (i = 0; i < MAX_HANDLES; i++)
+				{
+					if (fs_handles[i].pack == cur->pack)
+					{
+						fs_handles[i].pack = NULL;
+					}
+				}
+			}
+			else if (cur->pack->pk3)
 			{
 				unzClose(cur->pack->pk3);
 			}
@@ -1009,8 +1547,11 @@ FS_LoadPK3(const char *packPath)
 		unzGetCurrentFileInfo(handle, &info, fileName, sizeof(fileName),
 				NULL, 0, NULL, 0);
 		Q_strlcpy(files[i].name, fileName, sizeof(files[i].name));
-		files[i].offset = -1; /* Not used in ZIP files */
+		files[i].offset = -1; /* Resolved on first open. */
 		files[i].size = info.uncompressed_size;
+		files[i].stored = (info.compression_method == 0) &&
+			!(info.flag & 1) && (info.compressed_size == info.uncompressed_size);
+		unzGetFilePos(handle, &files[i].zippos);
 		i++;
 		status = unzGoToNextFile(handle);
 	}
@@ -1112,6 +1653,40 @@ FS_Path_f(void)
 	Com_Printf("----------------------\n");
 
 	Com_Printf("%i files in PAK/PK2/PK3/ZIP files.\n", totalFiles);
+
+	if (fs_indexBuckets)
+	{
+		Com_Printf("%i files in the index.\n", fs_numIndexEntries);
+	}
+}
+
+static void
+FS_Stats_f(void)
+{
+	if ((Cmd_Argc() > 1) && !strcmp(Cmd_Argv(1), "reset"))
+	{
+		fs_lookups = 0;
+		fs_lookupsFound = 0;
+		fs_dirProbes = 0;
+		fs_lookupTime = 0;
+
+		return;
+	}
+
+	Com_Printf("%i lookups, %i found, %i not found.\n", fs_lookups,
+		fs_lookupsFound, fs_lookups - fs_lookupsFound);
+	Com_Printf("%i directory probes.\n", fs_dirProbes);
+	Com_Printf("%lld usec spent in lookups.\n", fs_lookupTime);
+
+	if (fs_indexBuckets)
+	{
+		Com_Printf("Index: %i files in %u buckets.\n",
+			fs_numIndexEntries, fs_indexMask + 1);
+	}
+	else
+	{
+		Com_Printf("Index: disabled.\n");
+	}
 }
 
 /*
@@ -1594,6 +2169,8 @@ FS_AddPAKFromGamedir(const char *pak)
 			search->next = fs_searchPaths;
 			fs_searchPaths = search;
 
+			FS_BuildIndex();
+
 			return true;
 		}
 	}
@@ -1821,6 +2398,8 @@ FS_BuildGenericSearchPath(void)
 	// We need to create the game directory.
 	Sys_Mkdir(fs_gamedir);
 
+	FS_BuildIndex();
+
 	// We need to create the screenshot directory since the
 	// render dll doesn't link the filesystem stuff.
 	Com_sprintf(path, sizeof(path), "%s/scrnshot", fs_gamedir);
@@ -1921,6 +2500,9 @@ FS_BuildGameSpecificSearchPath(const char *dir)
 	Com_sprintf(path, sizeof(path), "%s/scrnshot", fs_gamedir);
 	Sys_Mkdir(path);
 
+	// The search path has changed.
+	FS_BuildIndex();
+
 	// the gamedir has changed, so read in the corresponding configs
 	Qcommon_ExecConfigs(false);
 
@@ -2066,12 +2648,16 @@ FS_InitFilesystem(void)
 	Cmd_AddCommand("path", FS_Path_f);
 	Cmd_AddCommand("link", FS_Link_f);
 	Cmd_AddCommand("dir", FS_Dir_f);
+	Cmd_AddCommand("fs_stats", FS_Stats_f);
 
 	// Register cvars
 	fs_basedir = Cvar_Get("basedir", ".", CVAR_NOSET);
 	fs_cddir = Cvar_Get("cddir", "", CVAR_NOSET);
 	fs_gamedirvar = Cvar_Get("game", "", CVAR_LATCH | CVAR_SERVERINFO);
 	fs_debug = Cvar_Get("fs_debug", "0", 0);
+	fs_mmap = Cvar_Get("fs_mmap", "1", 0);
+	fs_index = Cvar_Get("fs_index", "1", 0);
+	fs_index->modified = false;
 
 	// Deprecation warning, can be removed at a later time.
 	if (strcmp(fs_basedir->string, ".") != 0)
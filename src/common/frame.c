@@ -202,7 +202,12 @@ Qcommon_Mainloop(void)
 			}
 		}
 #else
-		Sys_Nanosleep(850000);
+		/* A running server waits for packets and its
+		   next frame in NET_Sleep(), no need to poll. */
+		if (!Com_ServerState())
+		{
+			Sys_Nanosleep(850000);
+		}
 #endif
 
 		newtime = Sys_Microseconds();
@@ -390,6 +395,8 @@ Qcommon_Init(int argc, char **argv)
 
 	// Start late subsystem.
 	Sys_Init();
+	Jobs_Init();
+	CM_Init();
 	NET_Init();
 	Netchan_Init();
 	SV_Init();
@@ -420,6 +427,8 @@ Qcommon_Init(int argc, char **argv)
 		   so drop the loading plaque */
 		SCR_EndLoadingPlaque();
 	}
+#else
+	SV_StartInstances();
 #endif
 
 	Com_Printf("==== Yamagi Quake II Initialized ====\n\n");
@@ -740,6 +749,9 @@ Qcommon_Frame(int usec)
 	// Accumulated time since last server run.
 	static int servertimedelta = 0;
 
+	// Waited for packets since the last packetframe.
+	static qboolean netslept = false;
+
 	/* A packetframe runs the server and the client,
 	   but not the renderer. The minimal interval of
 	   packetframes is about 10.000 microsec. If run
@@ -748,6 +760,14 @@ Qcommon_Frame(int usec)
 	   125hz bug. */
 	qboolean packetframe = true;
 
+	/* The server also runs when the next game frame is
+	   due, even between two packetframes. Otherwise the
+	   frame starts up to a packetframe late. */
+	qboolean serverframe;
+
+	// Time left until the next packetframe or game frame.
+	int left;
+
 
 	/* Tells the client to shutdown.
 	   Used by the signal handlers. */
@@ -805,19 +825,49 @@ Qcommon_Frame(int usec)
 
 
 	// Run the serverframe.
-	if (packetframe) {
+	serverframe = packetframe;
+
+	if (!serverframe && Com_ServerState()) {
+		serverframe = (servertimedelta >= SV_FrameDelay());
+	}
+
+	if (serverframe) {
 		SV_Frame(servertimedelta);
 		servertimedelta = 0;
+		netslept = false;
+	}
 
-		// Reset deltas if necessary.
+	// Reset deltas if necessary.
+	if (packetframe) {
 		packetdelta = 0;
 	}
+
+	if (Com_ServerState()) {
+		// Nothing to do until the next packetframe or game
+		// frame. Sockets stay readable until SV_Frame() reads
+		// them, so only the first sleep of an interval may
+		// end early.
+		left = (int)(1000000.0f / pfps) - packetdelta;
+		left = Q_min(left, SV_FrameDelay() - servertimedelta);
+
+		if (left <= 0) {
+			return;
+		}
+
+		if (!netslept) {
+			NET_Sleep(left);
+			netslept = true;
+		} else {
+			Sys_Nanosleep(left * 1000);
+		}
+	}
 }
 #endif
 
 void
 Qcommon_Shutdown(void)
 {
+	Jobs_Shutdown();
 	FS_ShutdownFilesystem();
 	Cvar_Fini();
 
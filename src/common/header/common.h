@@ -91,6 +91,7 @@ typedef struct sizebuf_s
 {
 	qboolean allowoverflow;     /* if false, do a Com_Error */
 	qboolean overflowed;        /* set to true if the buffer size failed */
+	qboolean quietoverflow;     /* the owner reports overflows itself */
 	byte *data;
 	int maxsize;
 	int cursize;
@@ -556,13 +557,15 @@ void NET_Config(qboolean multiplayer);
 qboolean NET_GetPacket(netsrc_t sock, netadr_t *net_from,
 		sizebuf_t *net_message);
 void NET_SendPacket(netsrc_t sock, int length, void *data, netadr_t to);
+void NET_BatchPackets(netsrc_t sock);
+void NET_FlushPackets(netsrc_t sock);
 
 qboolean NET_CompareAdr(netadr_t a, netadr_t b);
 qboolean NET_CompareBaseAdr(netadr_t a, netadr_t b);
 qboolean NET_IsLocalAddress(netadr_t adr);
 char *NET_AdrToString(netadr_t a);
 qboolean NET_StringToAdr(const char *s, netadr_t *a);
-void NET_Sleep(int msec);
+void NET_Sleep(int usec);
 
 /*=================================================================== */
 
@@ -622,6 +625,8 @@ qboolean Netchan_CanReliable(netchan_t *chan);
 
 #include "files.h"
 
+void CM_Init(void);
+void CM_NewFrame(void);
 cmodel_t *CM_LoadMap(const char *name, qboolean clientload, unsigned *checksum);
 cmodel_t *CM_InlineModel(const char *name);       /* *1, *2, etc */
 
@@ -632,19 +637,51 @@ char *CM_EntityString(void);
 /* creates a clipping hull for an arbitrary box */
 int CM_HeadnodeForBox(vec3_t mins, vec3_t maxs);
 
-/* returns an ORed contents mask */
+/* returns an ORed contents mask. With headnode 0 the result
+   may come from the cache of the frame, like CM_BoxTrace() it
+   must only be called from one thread */
 int CM_PointContents(const vec3_t p, int headnode);
 int CM_TransformedPointContents(const vec3_t p, int headnode,
 		vec3_t origin, vec3_t angles);
 
+/* The state of a trace. Traces with different contexts can run
+   at the same time, as long as the map and the box hull of
+   CM_HeadnodeForBox() don't change. Zero it before the first use. */
+typedef struct
+{
+	trace_t trace;
+	vec3_t start, end;
+	vec3_t mins, maxs;
+	vec3_t extents;
+	int contents;
+	qboolean ispoint;
+
+	/* brushes already tested by the current trace. A word
+	   of brushbits is only valid if its brushgen matches. */
+	unsigned int generation;
+	unsigned int brushgen[MAX_MAP_BRUSHES / 32];
+	unsigned int brushbits[MAX_MAP_BRUSHES / 32];
+
+	/* statistics, see CM_AddTraceStats() */
+	int numtraces, numbrushtraces;
+} cmtrace_t;
+
 trace_t CM_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins,
 		const vec3_t maxs, int headnode, int brushmask);
 trace_t CM_TransformedBoxTrace(const vec3_t start, const vec3_t end,
 		const vec3_t mins, const vec3_t maxs, int headnode,
 		int brushmask, const vec3_t origin, const vec3_t angles);
+trace_t CM_BoxTraceCtx(cmtrace_t *ctx, const vec3_t start, const vec3_t end,
+		const vec3_t mins, const vec3_t maxs, int headnode, int brushmask);
+trace_t CM_TransformedBoxTraceCtx(cmtrace_t *ctx, const vec3_t start,
+		const vec3_t end, const vec3_t mins, const vec3_t maxs, int headnode,
+		int brushmask, const vec3_t origin, const vec3_t angles);
+
+/* main thread only, for contexts used by other threads */
+void CM_AddTraceStats(cmtrace_t *ctx);
 
-byte *CM_ClusterPVS(int cluster);
-byte *CM_ClusterPHS(int cluster);
+const byte *CM_ClusterPVS(int cluster);
+const byte *CM_ClusterPHS(int cluster);
 
 int CM_PointLeafnum(const vec3_t p);
 
@@ -823,6 +860,20 @@ extern vec3_t bytedirs[NUMVERTEXNORMALS];
 /* this is in the client code, but can be used for debugging from server */
 void SCR_DebugGraph(float value, int color);
 
+/* JOBS */
+
+/* called once for every index in [0, count) */
+typedef void (*jobfunc_t)(void *data, int index);
+
+void Jobs_Init(void);
+void Jobs_Shutdown(void);
+int Jobs_NumWorkers(void);
+
+/* runs func for all indices on the worker threads and the calling
+   thread, returns when all of them are done. Jobs must not touch the
+   zone allocator, the filesystem, cvars or commands. */
+void Jobs_Run(jobfunc_t func, void *data, int count);
+
 /* CLIENT / SERVER SYSTEMS */
 
 void CL_Init(void);
@@ -833,8 +884,10 @@ void Con_Print(char *text);
 void SCR_BeginLoadingPlaque(void);
 
 void SV_Init(void);
+void SV_StartInstances(void);
 void SV_Shutdown(char *finalmsg, qboolean reconnect);
 void SV_Frame(int usec);
+int SV_FrameDelay(void);
 
 /* ======================================================================= */
 
@@ -846,6 +899,7 @@ void Sys_ConsoleOutput(char *string);
 YQ2_ATTR_NORETURN void Sys_Error(const char *error, ...);
 YQ2_ATTR_NORETURN void Sys_Quit(void);
 void Sys_Init(void);
+int Sys_ForkInstances(int count);
 char *Sys_GetHomeDir(void);
 void Sys_Remove(const char *path);
 int Sys_Rename(const char *from, const char *to);
@@ -856,10 +910,13 @@ void *Sys_GetProcAddress(void *handle, const char *sym);
 void Sys_FreeLibrary(void *handle);
 void *Sys_LoadLibrary(const char *path, const char *sym, void **handle);
 void *Sys_GetGameAPI(void *parms);
+void *Sys_GetGameProc(const char *sym);
 void Sys_UnloadGame(void);
 void Sys_GetWorkDir(char *buffer, size_t len);
 qboolean Sys_SetWorkDir(char *path);
 qboolean Sys_Realpath(const char *in, char *out, size_t size);
+void *Sys_MapFile(FILE *f, size_t offset, size_t size, void **base, size_t *mapsize);
+void Sys_UnmapFile(void *base, size_t mapsize);
 
 // Windows only (system.c)
 #ifdef _WIN32
@@ -350,6 +350,9 @@ char *Q_strcasestr(const char *s1, const char *s2);
 void Q_strlwr(char *s);
 void Q_strupr(char *s);
 
+/* case insensitive string hash */
+unsigned int Q_strhash(const char *s);
+
 /* portable safe string copy/concatenate */
 int Q_strlcpy(char *dst, const char *src, int size);
 int Q_strlcat(char *dst, const char *src, int size);
@@ -450,6 +453,24 @@ YQ2_ATTR_MALLOC void *Hunk_Alloc(int size);
 void Hunk_Free(void *buf);
 int Hunk_End(void);
 
+/* threads and locks */
+typedef struct qthread_s qthread_t;
+typedef struct qmutex_s qmutex_t;
+typedef struct qcond_s qcond_t;
+
+qthread_t *Thread_Create(void (*func)(void *data), void *data);
+void Thread_Join(qthread_t *thread);
+int Thread_NumCPUs(void);
+qmutex_t *Mutex_Create(void);
+void Mutex_Destroy(qmutex_t *mutex);
+void Mutex_Lock(qmutex_t *mutex);
+void Mutex_Unlock(qmutex_t *mutex);
+qcond_t *Cond_Create(void);
+void Cond_Destroy(qcond_t *cond);
+void Cond_Wait(qcond_t *cond, qmutex_t *mutex);
+void Cond_Signal(qcond_t *cond);
+void Cond_Broadcast(qcond_t *cond);
+
 /* directory searching */
 #define SFF_ARCH 0x01
 #define SFF_HIDDEN 0x02
@@ -497,6 +518,7 @@ typedef struct cvar_s
 
 	/* Added by YQ2. Must be at the end to preserve ABI. */
 	char *default_string;
+	struct cvar_s *hash_next; /* next cvar in the same hash bucket */
 } cvar_t;
 
 #endif /* CVAR */
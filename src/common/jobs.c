@@ -0,0 +1,259 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * A small pool of worker threads. Work is handed out as a parallel for
+ * loop: Jobs_Run() calls a function for every index of a range, spread
+ * over the workers and the calling thread, and returns once all calls
+ * are done. Only one loop runs at a time; Jobs_Run() called from inside
+ * a job (or from another thread while a loop runs) just runs serially.
+ *
+ * =======================================================================
+ */
+
+#include "header/common.h"
+
+#define MAX_WORKERS 32
+
+static cvar_t *sys_threads;
+
+static qthread_t *workers[MAX_WORKERS];
+static int numworkers;
+
+static qmutex_t *jobs_lock;
+static qcond_t *jobs_wake;     /* signaled when a new loop starts */
+static qcond_t *jobs_finished; /* signaled when the last index is done */
+
+/* The running loop. Everything is protected by jobs_lock. */
+static jobfunc_t job_func;
+static void *job_data;
+static int job_count;
+static int job_next;
+static int job_done;
+static unsigned int job_generation;
+static qboolean jobs_busy;
+static qboolean jobs_quit;
+
+/*
+ * Works on the current loop until all indices are handed out.
+ * Must be called with jobs_lock held, returns with it held.
+ */
+static void
+Jobs_Work(void)
+{
+	while (job_next < job_count)
+	{
+		jobfunc_t func = job_func;
+		void *data = job_data;
+		int index = job_next++;
+
+		Mutex_Unlock(jobs_lock);
+		func(data, index);
+		Mutex_Lock(jobs_lock);
+
+		if (++job_done == job_count)
+		{
+			Cond_Signal(jobs_finished);
+		}
+	}
+}
+
+static void
+Jobs_Worker(void *unused)
+{
+	unsigned int generation;
+
+	Mutex_Lock(jobs_lock);
+
+	generation = job_generation;
+
+	for ( ; ; )
+	{
+		while (!jobs_quit && (generation == job_generation))
+		{
+			Cond_Wait(jobs_wake, jobs_lock);
+		}
+
+		if (jobs_quit)
+		{
+			break;
+		}
+
+		generation = job_generation;
+		Jobs_Work();
+	}
+
+	Mutex_Unlock(jobs_lock);
+}
+
+static void
+Jobs_StopWorkers(void)
+{
+	int i;
+
+	if (!numworkers)
+	{
+		return;
+	}
+
+	Mutex_Lock(jobs_lock);
+	jobs_quit = true;
+	Cond_Broadcast(jobs_wake);
+	Mutex_Unlock(jobs_lock);
+
+	for (i = 0; i < numworkers; i++)
+	{
+		Thread_Join(workers[i]);
+		workers[i] = NULL;
+	}
+
+	numworkers = 0;
+	jobs_quit = false;
+}
+
+static void
+Jobs_StartWorkers(void)
+{
+	int wanted;
+
+	sys_threads->modified = false;
+
+	if (!jobs_lock || !jobs_wake || !jobs_finished)
+	{
+		return;
+	}
+
+	wanted = sys_threads->value;
+
+	if (wanted < 0)
+	{
+		/* Leave one core to the main thread. */
+		wanted = Thread_NumCPUs() - 1;
+	}
+
+	wanted = Q_min(wanted, MAX_WORKERS);
+
+	while (numworkers < wanted)
+	{
+		workers[numworkers] = Thread_Create(Jobs_Worker, NULL);
+
+		if (!workers[numworkers])
+		{
+			Com_Printf("Couldn't create worker thread %i.\n", numworkers);
+			break;
+		}
+
+		numworkers++;
+	}
+
+	if (numworkers)
+	{
+		Com_Printf("Started %i worker thread%s.\n", numworkers,
+				(numworkers == 1) ? "" : "s");
+	}
+}
+
+int
+Jobs_NumWorkers(void)
+{
+	return numworkers;
+}
+
+void
+Jobs_Run(jobfunc_t func, void *data, int count)
+{
+	int i;
+
+	if (count <= 0)
+	{
+		return;
+	}
+
+	if (sys_threads && sys_threads->modified && !jobs_busy)
+	{
+		Jobs_StopWorkers();
+		Jobs_StartWorkers();
+	}
+
+	if (numworkers && (count > 1))
+	{
+		Mutex_Lock(jobs_lock);
+
+		if (!jobs_busy)
+		{
+			jobs_busy = true;
+
+			job_func = func;
+			job_data = data;
+			job_count = count;
+			job_next = 0;
+			job_done = 0;
+			job_generation++;
+
+			Cond_Broadcast(jobs_wake);
+			Jobs_Work();
+
+			while (job_done < job_count)
+			{
+				Cond_Wait(jobs_finished, jobs_lock);
+			}
+
+			job_func = NULL;
+			job_data = NULL;
+			job_count = 0;
+			job_next = 0;
+			jobs_busy = false;
+
+			Mutex_Unlock(jobs_lock);
+			return;
+		}
+
+		Mutex_Unlock(jobs_lock);
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		func(data, i);
+	}
+}
+
+void
+Jobs_Init(void)
+{
+	sys_threads = Cvar_Get("sys_threads", "-1", CVAR_ARCHIVE);
+
+	jobs_lock = Mutex_Create();
+	jobs_wake = Cond_Create();
+	jobs_finished = Cond_Create();
+
+	Jobs_StartWorkers();
+}
+
+void
+Jobs_Shutdown(void)
+{
+	Jobs_StopWorkers();
+
+	Cond_Destroy(jobs_finished);
+	Cond_Destroy(jobs_wake);
+	Mutex_Destroy(jobs_lock);
+
+	jobs_finished = NULL;
+	jobs_wake = NULL;
+	jobs_lock = NULL;
+}
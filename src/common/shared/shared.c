@@ -1274,6 +1274,24 @@ Q_strupr(char *s)
 	}
 }
 
+/*
+ * Case insensitive FNV-1a hash. Strings comparing
+ * equal with Q_stricmp() have the same hash.
+ */
+unsigned int
+Q_strhash(const char *s)
+{
+	unsigned int hash = 2166136261u;
+
+	for (; *s != '\0'; s++)
+	{
+		hash ^= (unsigned char)tolower((unsigned char)*s);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
 int
 Q_strlcpy(char *dst, const char *src, int size)
 {
@@ -19,7 +19,10 @@
  *
  * =======================================================================
  *
- * Zone malloc. It's just a normal malloc with tags.
+ * Zone malloc. A normal malloc with tags. Every tag has its own arena:
+ * small blocks are cut from pooled chunks and recycled through size
+ * class free lists, bigger blocks come straight from libc. Freeing a
+ * tag releases its chunks at once instead of every block on its own.
  *
  * =======================================================================
  */
@@ -30,33 +33,132 @@
 
 #define Z_MAGIC 0x1d1d
 
+#define ZONE_CHUNK_SIZE (64 * 1024)
+#define ZONE_SMALL_MAX 2048     /* biggest pooled block, header included */
+#define ZONE_LARGE 0xff         /* size class of blocks from libc */
+#define ZONE_ARENA_HASH 64
+#define ZONE_SPARE_CHUNKS 64    /* chunks kept for reuse after Z_FreeTags() */
+
 typedef struct zhead_s
 {
-	struct zhead_s *prev, *next;
+	struct zhead_s *prev, *next; /* large blocks, next is the free list link */
 	size_t size;
 	unsigned short magic;
 	unsigned short tag; /* for group free */
+	byte sizeclass;
 } zhead_t;
 
-static zhead_t z_chain;
+typedef struct zchunk_s
+{
+	struct zchunk_s *next;
+	size_t pad; /* keeps the blocks 16 byte aligned */
+} zchunk_t;
+
+/* Block sizes of the pools, header included */
+static const unsigned short z_classsizes[] = {
+	48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448,
+	512, 640, 768, 896, 1024, 1280, 1536, 1792, 2048
+};
+
+#define ZONE_CLASSES (sizeof(z_classsizes) / sizeof(z_classsizes[0]))
+
+typedef struct zarena_s
+{
+	struct zarena_s *hash_next;
+	unsigned short tag;
+
+	zhead_t large;                  /* chain of blocks from libc */
+	zchunk_t *chunks;
+	byte *top, *end;                /* unused space of the newest chunk */
+	zhead_t *freelist[ZONE_CLASSES];
+
+	size_t count, bytes;            /* live blocks and bytes */
+	size_t pooledbytes;             /* live bytes in pooled blocks */
+	size_t numchunks;
+} zarena_t;
+
+static zarena_t *z_arenas[ZONE_ARENA_HASH];
+static zarena_t *z_lastarena;
+static zchunk_t *z_sparechunks;
+static int z_numsparechunks;
+static byte z_classindex[(ZONE_SMALL_MAX >> 4) + 1]; /* class + 1 */
 static size_t z_count, z_bytes;
 
 void
 Z_Init(void)
 {
-	memset(&z_chain, 0, sizeof(z_chain));
+	int i, c;
 
-	z_chain.prev = &z_chain;
-	z_chain.next = &z_chain;
+	memset(z_arenas, 0, sizeof(z_arenas));
+	z_lastarena = NULL;
+
+	for (i = 0, c = 0; i < sizeof(z_classindex); i++)
+	{
+		while ((i << 4) > z_classsizes[c])
+		{
+			c++;
+		}
+
+		z_classindex[i] = c + 1;
+	}
 
 	z_count = 0;
 	z_bytes = 0;
 }
 
+static zarena_t *
+Z_FindArena(unsigned short tag, qboolean create)
+{
+	zarena_t *arena;
+	int hash;
+
+	if (z_lastarena && (z_lastarena->tag == tag))
+	{
+		return z_lastarena;
+	}
+
+	hash = tag & (ZONE_ARENA_HASH - 1);
+
+	for (arena = z_arenas[hash]; arena; arena = arena->hash_next)
+	{
+		if (arena->tag == tag)
+		{
+			z_lastarena = arena;
+			return arena;
+		}
+	}
+
+	if (!create)
+	{
+		return NULL;
+	}
+
+	arena = calloc(1, sizeof(*arena));
+
+	if (!arena)
+	{
+		Com_Error(ERR_FATAL, "%s: failed to allocate arena for tag %i",
+			__func__, tag);
+		return NULL;
+	}
+
+	arena->tag = tag;
+	arena->large.prev = &arena->large;
+	arena->large.next = &arena->large;
+
+	arena->hash_next = z_arenas[hash];
+	z_arenas[hash] = arena;
+
+	z_lastarena = arena;
+
+	return arena;
+}
+
 void
 Z_Free(void *ptr)
 {
 	zhead_t *z;
+	zarena_t *arena;
 
 	if (!ptr)
 	{
@@ -71,19 +173,66 @@ Z_Free(void *ptr)
 		return;
 	}
 
-	z->prev->next = z->next;
-	z->next->prev = z->prev;
+	arena = Z_FindArena(z->tag, false);
+
+	if (!arena)
+	{
+		Com_Error(ERR_FATAL, "%s: no arena for tag %i", __func__, z->tag);
+		return;
+	}
 
 	z_count--;
 	z_bytes -= z->size;
+	arena->count--;
+	arena->bytes -= z->size;
 
 	z->magic = 0; /* can avoid possible double free with check above */
-	free(z);
+
+	if (z->sizeclass == ZONE_LARGE)
+	{
+		z->prev->next = z->next;
+		z->next->prev = z->prev;
+
+		free(z);
+	}
+	else
+	{
+		arena->pooledbytes -= z->size;
+
+		z->next = arena->freelist[z->sizeclass];
+		arena->freelist[z->sizeclass] = z;
+	}
 }
 
 void
 Z_Stats_f(void)
 {
+	zarena_t *arena;
+	size_t pooled, used;
+	int i;
+
+	for (i = 0; i < ZONE_ARENA_HASH; i++)
+	{
+		for (arena = z_arenas[i]; arena; arena = arena->hash_next)
+		{
+			if (!arena->count && !arena->numchunks)
+			{
+				continue;
+			}
+
+			/* fragmentation is the part of the chunks that's
+			   handed out but not covered by live pooled blocks */
+			pooled = arena->numchunks * (ZONE_CHUNK_SIZE - sizeof(zchunk_t)) -
+				(arena->end - arena->top);
+			used = arena->pooledbytes;
+
+			Com_Printf("tag %5i: " YQ2_COM_PRIdS " bytes in " YQ2_COM_PRIdS
+				" blocks, " YQ2_COM_PRIdS " chunks, %i%% fragmented\n",
+				arena->tag, arena->bytes, arena->count, arena->numchunks,
+				pooled ? (int)(100 - (100 * used) / pooled) : 0);
+		}
+	}
+
 	Com_Printf(YQ2_COM_PRIdS " bytes in " YQ2_COM_PRIdS " blocks\n",
 		z_bytes, z_count);
 }
@@ -91,23 +240,117 @@ Z_Stats_f(void)
 void
 Z_FreeTags(unsigned short tag)
 {
+	zarena_t *arena;
 	zhead_t *z, *next;
+	zchunk_t *chunk, *nextchunk;
+
+	arena = Z_FindArena(tag, false);
+
+	if (!arena)
+	{
+		return;
+	}
 
-	for (z = z_chain.next; z != &z_chain; z = next)
+	for (z = arena->large.next; z != &arena->large; z = next)
 	{
 		next = z->next;
 
-		if (z->tag == tag)
+		z->magic = 0;
+		free(z);
+	}
+
+	for (chunk = arena->chunks; chunk; chunk = nextchunk)
+	{
+		nextchunk = chunk->next;
+
+		if (z_numsparechunks < ZONE_SPARE_CHUNKS)
+		{
+			chunk->next = z_sparechunks;
+			z_sparechunks = chunk;
+			z_numsparechunks++;
+		}
+		else
 		{
-			Z_Free((void *)(z + 1));
+			free(chunk);
+		}
+	}
+
+	z_count -= arena->count;
+	z_bytes -= arena->bytes;
+
+	arena->large.prev = &arena->large;
+	arena->large.next = &arena->large;
+	arena->chunks = NULL;
+	arena->top = arena->end = NULL;
+	memset(arena->freelist, 0, sizeof(arena->freelist));
+
+	arena->count = 0;
+	arena->bytes = 0;
+	arena->pooledbytes = 0;
+	arena->numchunks = 0;
+}
+
+/*
+ * Takes a block of the given size class from the
+ * arena, either recycled or cut from a chunk.
+ */
+static zhead_t *
+Z_PoolAlloc(zarena_t *arena, int sizeclass)
+{
+	size_t size = z_classsizes[sizeclass];
+	zchunk_t *chunk;
+	zhead_t *z;
+
+	z = arena->freelist[sizeclass];
+
+	if (z)
+	{
+		arena->freelist[sizeclass] = z->next;
+		memset(z, 0, size);
+
+		return z;
+	}
+
+	if ((size_t)(arena->end - arena->top) < size)
+	{
+		if (z_sparechunks)
+		{
+			chunk = z_sparechunks;
+			z_sparechunks = chunk->next;
+			z_numsparechunks--;
+		}
+		else
+		{
+			chunk = malloc(ZONE_CHUNK_SIZE);
+
+			if (!chunk)
+			{
+				return NULL;
+			}
 		}
+
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+		arena->numchunks++;
+
+		arena->top = (byte *)(chunk + 1);
+		arena->end = (byte *)chunk + ZONE_CHUNK_SIZE;
 	}
+
+	z = (zhead_t *)arena->top;
+	arena->top += size;
+
+	memset(z, 0, size);
+
+	return z;
 }
 
 void *
 Z_TagMalloc(size_t size, unsigned short tag)
 {
 	zhead_t *z;
+	zarena_t *arena;
+	int sizeclass;
 
 	if (!size || ((SIZE_MAX - size) < sizeof(zhead_t)))
 	{
@@ -117,7 +360,19 @@ Z_TagMalloc(size_t size, unsigned short tag)
 	}
 
 	size = size + sizeof(zhead_t);
-	z = calloc(1, size);
+	arena = Z_FindArena(tag, true);
+
+	sizeclass = (size <= ZONE_SMALL_MAX) ?
+		z_classindex[(size + 15) >> 4] - 1 : -1;
+
+	if (sizeclass >= 0)
+	{
+		z = Z_PoolAlloc(arena, sizeclass);
+	}
+	else
+	{
+		z = calloc(1, size);
+	}
 
 	if (!z)
 	{
@@ -128,14 +383,27 @@ Z_TagMalloc(size_t size, unsigned short tag)
 
 	z_count++;
 	z_bytes += size;
+	arena->count++;
+	arena->bytes += size;
+
 	z->magic = Z_MAGIC;
 	z->tag = tag;
 	z->size = size;
 
-	z->next = z_chain.next;
-	z->prev = &z_chain;
-	z_chain.next->prev = z;
-	z_chain.next = z;
+	if (sizeclass >= 0)
+	{
+		z->sizeclass = sizeclass;
+		arena->pooledbytes += size;
+	}
+	else
+	{
+		z->sizeclass = ZONE_LARGE;
+
+		z->next = arena->large.next;
+		z->prev = &arena->large;
+		arena->large.next->prev = z;
+		arena->large.next = z;
+	}
 
 	return (void *)(z + 1);
 }
@@ -150,6 +418,8 @@ void *
 Z_TagRealloc(void *ptr, size_t size, unsigned short tag)
 {
 	zhead_t *z, *zr;
+	zarena_t *arena;
+	void *newptr;
 
 	if (!size || ((SIZE_MAX - size) < sizeof(zhead_t)))
 	{
@@ -172,6 +442,40 @@ Z_TagRealloc(void *ptr, size_t size, unsigned short tag)
 	}
 
 	size = size + sizeof(zhead_t);
+
+	/* pooled blocks and blocks changing their
+	   arena are moved to a new block */
+	if ((z->sizeclass != ZONE_LARGE) || (z->tag != tag) ||
+		(size <= ZONE_SMALL_MAX))
+	{
+		if ((z->sizeclass != ZONE_LARGE) && (z->tag == tag) &&
+			(size <= z_classsizes[z->sizeclass]))
+		{
+			/* still fits */
+			arena = Z_FindArena(tag, false);
+
+			if (size > z->size)
+			{
+				memset((byte *)z + z->size, 0, size - z->size);
+			}
+
+			z_bytes += size - z->size;
+			arena->bytes += size - z->size;
+			arena->pooledbytes += size - z->size;
+			z->size = size;
+
+			return ptr;
+		}
+
+		newptr = Z_TagMalloc(size - sizeof(zhead_t), tag);
+		memcpy(newptr, ptr, Q_min(size, z->size) - sizeof(zhead_t));
+		Z_Free(ptr);
+
+		return newptr;
+	}
+
+	arena = Z_FindArena(tag, false);
+
 	zr = Q_realloc0(z, z->size, size);
 
 	if (!zr)
@@ -183,8 +487,9 @@ Z_TagRealloc(void *ptr, size_t size, unsigned short tag)
 
 	z_bytes -= zr->size;
 	z_bytes += size;
+	arena->bytes -= zr->size;
+	arena->bytes += size;
 
-	zr->tag = tag;
 	zr->size = size;
 	zr->prev->next = zr;
 	zr->next->prev = zr;
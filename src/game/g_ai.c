@@ -482,7 +482,7 @@ FoundTarget(edict_t *self)
 	self->monsterinfo.pausetime = 0;
 
 	/* clear the targetname, that point is ours! */
-	combatpoint->targetname = NULL;
+	G_SetTargetname(combatpoint, NULL);
 	self->goalentity = self->movetarget = combatpoint;
 
 	/* run for it */
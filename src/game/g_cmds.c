@@ -358,7 +358,7 @@ Cmd_Give_f(edict_t *ent)
 		if (it)
 		{
 			it_ent = G_Spawn();
-			it_ent->classname = it->classname;
+			G_SetClassname(it_ent, it->classname);
 			SpawnItem(it_ent, it);
 			Touch_Item(it_ent, ent, NULL, NULL);
 
@@ -432,7 +432,7 @@ Cmd_Give_f(edict_t *ent)
 	else
 	{
 		it_ent = G_Spawn();
-		it_ent->classname = it->classname;
+		G_SetClassname(it_ent, it->classname);
 		SpawnItem(it_ent, it);
 		Touch_Item(it_ent, ent, NULL, NULL);
 
@@ -1415,7 +1415,7 @@ Cmd_SpawnEntity_f(edict_t *ent)
 		ent->spawnflags = atoi(gi.argv(8));
 	}
 
-	ent->classname = G_CopyString(gi.argv(1));
+	G_SetClassname(ent, G_CopyString(gi.argv(1)));
 
 	ED_CallSpawn(ent);
 }
@@ -1430,7 +1430,7 @@ Cmd_SpawnOnStartByClass(const char *classname, const vec3_t origin)
 	opponent->s.origin[1] = origin[1];
 	opponent->s.origin[2] = origin[2];
 	// and class
-	opponent->classname = G_CopyString(classname);
+	G_SetClassname(opponent, G_CopyString(classname));
 
 	ED_CallSpawn(opponent);
 
@@ -118,6 +118,9 @@ CanDamage(edict_t *targ, edict_t *inflictor)
 	return false;
 }
 
+/* bumped by every kill, kills may change the world */
+static int killcount;
+
 static void
 Killed(edict_t *targ, edict_t *inflictor, edict_t *attacker,
 		int damage, vec3_t point)
@@ -127,6 +130,8 @@ Killed(edict_t *targ, edict_t *inflictor, edict_t *attacker,
 		return;
 	}
 
+	killcount++;
+
 	targ->enemy = attacker;
 
 	if ((targ->svflags & SVF_MONSTER) && (targ->deadflag != DEAD_DEAD))
@@ -711,51 +716,196 @@ T_Damage(edict_t *targ, edict_t *inflictor, edict_t *attacker, vec3_t dir,
 	}
 }
 
+#define MAX_RADIUSBATCH 32
+
+/*
+ * CanDamage() for all targets at once. All first traces run
+ * in one batch, the four corner traces of the targets whose
+ * origin is blocked in a second one.
+ */
+static void
+CanDamageBatch(edict_t **targs, int count, edict_t *inflictor,
+		qboolean *candamage)
+{
+	static const float corners[4][2] = {
+		{15, 15}, {15, -15}, {-15, 15}, {-15, -15}
+	};
+	tracerequest_t requests[MAX_RADIUSBATCH * 4];
+	trace_t results[MAX_RADIUSBATCH * 4];
+	int blocked[MAX_RADIUSBATCH];
+	int i, j, numblocked;
+
+	memset(requests, 0, count * sizeof(tracerequest_t));
+
+	for (i = 0; i < count; i++)
+	{
+		tracerequest_t *req = &requests[i];
+
+		VectorCopy(inflictor->s.origin, req->start);
+		req->passent = inflictor;
+		req->contentmask = MASK_SOLID;
+
+		/* bmodels need special checking because their origin is 0,0,0 */
+		if (targs[i]->movetype == MOVETYPE_PUSH)
+		{
+			VectorAdd(targs[i]->absmin, targs[i]->absmax, req->end);
+			VectorScale(req->end, 0.5, req->end);
+		}
+		else
+		{
+			VectorCopy(targs[i]->s.origin, req->end);
+		}
+	}
+
+	gix->TraceBatch(requests, results, count);
+
+	numblocked = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		candamage[i] = (results[i].fraction == 1.0);
+
+		if (targs[i]->movetype == MOVETYPE_PUSH)
+		{
+			candamage[i] |= (results[i].ent == targs[i]);
+		}
+		else if (!candamage[i])
+		{
+			blocked[numblocked++] = i;
+		}
+	}
+
+	if (!numblocked)
+	{
+		return;
+	}
+
+	memset(requests, 0, numblocked * 4 * sizeof(tracerequest_t));
+
+	for (i = 0; i < numblocked; i++)
+	{
+		for (j = 0; j < 4; j++)
+		{
+			tracerequest_t *req = &requests[i * 4 + j];
+
+			VectorCopy(inflictor->s.origin, req->start);
+			VectorCopy(targs[blocked[i]]->s.origin, req->end);
+			req->end[0] += corners[j][0];
+			req->end[1] += corners[j][1];
+			req->passent = inflictor;
+			req->contentmask = MASK_SOLID;
+		}
+	}
+
+	gix->TraceBatch(requests, results, numblocked * 4);
+
+	for (i = 0; i < numblocked; i++)
+	{
+		for (j = 0; j < 4; j++)
+		{
+			if (results[i * 4 + j].fraction == 1.0)
+			{
+				candamage[blocked[i]] = true;
+				break;
+			}
+		}
+	}
+}
+
 void
 T_RadiusDamage(edict_t *inflictor, edict_t *attacker, float damage,
 		const edict_t *ignore, float radius, int mod)
 {
-	float points;
+	edict_t *targs[MAX_RADIUSBATCH];
+	float points[MAX_RADIUSBATCH];
+	qboolean candamage[MAX_RADIUSBATCH];
+	qboolean batch;
 	edict_t *ent = NULL;
 	vec3_t v;
 	vec3_t dir;
+	int i, count;
 
 	if (!inflictor || !attacker)
 	{
 		return;
 	}
 
-	while ((ent = findradius(ent, inflictor->s.origin, radius)) != NULL)
+	/* With a server that can batch the traces the targets are
+	   collected first and checked all at once. Damage doesn't
+	   move walls until something dies, so the checks stay valid
+	   up to the first kill. From there on it's done again. */
+	batch = (gix_version >= 2);
+
+	do
 	{
-		if (ent == ignore)
+		count = 0;
+
+		while ((ent = findradius(ent, inflictor->s.origin, radius)) != NULL)
 		{
-			continue;
+			if (ent == ignore)
+			{
+				continue;
+			}
+
+			if (!ent->takedamage)
+			{
+				continue;
+			}
+
+			VectorAdd(ent->mins, ent->maxs, v);
+			VectorMA(ent->s.origin, 0.5, v, v);
+			VectorSubtract(inflictor->s.origin, v, v);
+			points[count] = damage - 0.5 * VectorLength(v);
+
+			if (ent == attacker)
+			{
+				points[count] = points[count] * 0.5;
+			}
+
+			if (points[count] > 0)
+			{
+				targs[count++] = ent;
+
+				if (!batch || (count == MAX_RADIUSBATCH))
+				{
+					break;
+				}
+			}
 		}
 
-		if (!ent->takedamage)
+		if (!count)
 		{
-			continue;
+			break;
 		}
 
-		VectorAdd(ent->mins, ent->maxs, v);
-		VectorMA(ent->s.origin, 0.5, v, v);
-		VectorSubtract(inflictor->s.origin, v, v);
-		points = damage - 0.5 * VectorLength(v);
-
-		if (ent == attacker)
+		if (batch)
+		{
+			CanDamageBatch(targs, count, inflictor, candamage);
+		}
+		else
 		{
-			points = points * 0.5;
+			candamage[0] = CanDamage(targs[0], inflictor);
 		}
 
-		if (points > 0)
+		for (i = 0; i < count; i++)
 		{
-			if (CanDamage(ent, inflictor))
+			int kills = killcount;
+
+			if (candamage[i])
 			{
-				VectorSubtract(ent->s.origin, inflictor->s.origin, dir);
-				T_Damage(ent, inflictor, attacker, dir, inflictor->s.origin,
-						vec3_origin, (int)points, (int)points, DAMAGE_RADIUS,
+				VectorSubtract(targs[i]->s.origin, inflictor->s.origin, dir);
+				T_Damage(targs[i], inflictor, attacker, dir, inflictor->s.origin,
+						vec3_origin, (int)points[i], (int)points[i], DAMAGE_RADIUS,
 						mod);
 			}
+
+			if (killcount != kills)
+			{
+				/* continue the search after this target */
+				ent = targs[i];
+				break;
+			}
 		}
 	}
+	while (ent);
 }
@@ -93,6 +93,10 @@ cvar_t *g_swap_speed;
 
 static void G_RunFrame(void);
 
+/* extended imports, only valid up to gix_version */
+const game_ext_import_t *gix;
+int gix_version;
+
 /* =================================================================== */
 
 static void
@@ -143,6 +147,19 @@ GetGameAPI(const game_import_t *import)
 	return &globals;
 }
 
+/*
+ * Called by servers that know about the
+ * extensions, right after GetGameAPI()
+ */
+Q2_DLL_EXPORTED int
+GetGameExtension(const game_ext_import_t *import)
+{
+	gix = import;
+	gix_version = Q_min(import->apiversion, GAME_EXT_API_VERSION);
+
+	return GAME_EXT_API_VERSION;
+}
+
 /*
  * this is only here so the functions
  * in shared source files can link
@@ -211,7 +228,7 @@ CreateTargetChangeLevel(char *map)
 	}
 
 	ent = G_Spawn();
-	ent->classname = "target_changelevel";
+	G_SetClassname(ent, "target_changelevel");
 	Com_sprintf(level.nextmap, sizeof(level.nextmap), "%s", map);
 	ent->map = level.nextmap;
 	return ent;
@@ -419,6 +436,7 @@ G_RunFrame(void)
 {
 	int i;
 	edict_t *ent;
+	qboolean profile;
 
 	level.framenum++;
 	level.time = level.framenum * FRAMETIME;
@@ -436,6 +454,17 @@ G_RunFrame(void)
 		return;
 	}
 
+	/* report the think times if the server wants them. Servers
+	   before version 3 can't tell, they always get them */
+	if (gix_version >= 3)
+	{
+		profile = gix->ProfileThinkWanted();
+	}
+	else
+	{
+		profile = (gix_version >= 1);
+	}
+
 	/* treat each object in turn
 	   even the world gets a chance
 	   to think */
@@ -443,11 +472,22 @@ G_RunFrame(void)
 
 	for (i = 0; i < globals.num_edicts; i++, ent++)
 	{
+		const char *classname;
+		long long start = 0;
+
 		if (!ent->inuse)
 		{
 			continue;
 		}
 
+		/* taken now, freed entities are renamed */
+		classname = ent->classname;
+
+		if (profile)
+		{
+			start = gix->Microseconds();
+		}
+
 		level.current_entity = ent;
 
 		VectorCopy(ent->s.origin, ent->s.old_origin);
@@ -468,10 +508,17 @@ G_RunFrame(void)
 		if ((i > 0) && (i <= maxclients->value))
 		{
 			ClientBeginServerFrame(ent);
-			continue;
+		}
+		else
+		{
+			G_RunEntity(ent);
 		}
 
-		G_RunEntity(ent);
+		if (profile)
+		{
+			gix->ProfileThink(classname,
+					(int)(gix->Microseconds() - start));
+		}
 	}
 
 	/* see if it is time to end a deathmatch */
@@ -275,7 +275,7 @@ ThrowHead(edict_t *self, const char *gibname, int damage, gibtype_t type)
 	self->flags |= FL_NO_KNOCKBACK;
 	self->svflags &= ~SVF_MONSTER;
 	self->takedamage = DAMAGE_YES;
-	self->targetname = NULL;
+	G_SetTargetname(self, NULL);
 	self->die = gib_die;
 
 	// The entity still has the monsters clipmaks.
@@ -418,7 +418,7 @@ ThrowDebris(edict_t *self, char *modelname, float speed, vec3_t origin)
 	chunk->nextthink = level.time + 5 + random() * 5;
 	chunk->s.frame = 0;
 	chunk->flags = 0;
-	chunk->classname = "debris";
+	G_SetClassname(chunk, "debris");
 	chunk->takedamage = DAMAGE_YES;
 	chunk->die = debris_die;
 	chunk->health = 250;
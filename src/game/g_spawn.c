@@ -382,6 +382,7 @@ SpawnEntities(const char *mapname, char *entities, const char *spawnpoint)
 	gi.FreeTags(TAG_LEVEL);
 
 	memset(&level, 0, sizeof(level));
+	G_InvalidateNameHash();
 	memset(g_edicts, 0, game.maxentities * sizeof(g_edicts[0]));
 
 	Q_strlcpy(level.mapname, mapname, sizeof(level.mapname));
@@ -479,6 +480,8 @@ SpawnEntities(const char *mapname, char *entities, const char *spawnpoint)
 	G_FindTeams();
 
 	PlayerTrail_Init();
+
+	G_BuildNameHash();
 }
 
 /* =================================================================== */
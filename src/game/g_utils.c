@@ -38,6 +38,186 @@ G_ProjectSource(const vec3_t point, const vec3_t distance, const vec3_t forward,
 				distance[2];
 }
 
+/*
+ * Hashes over the classname and targetname of all
+ * edicts, so that G_Find() doesn't need to walk
+ * all of them. Both fields must be changed through
+ * G_SetClassname() and G_SetTargetname() to keep the
+ * hashes up to date. The chains are sorted by edict
+ * number, G_Find() returns the entities in the same
+ * order as a linear search would.
+ */
+#define NAMEHASH_SIZE 1024
+
+typedef struct
+{
+	int fieldofs;
+	int heads[NAMEHASH_SIZE]; /* edict number + 1, 0 ends a chain */
+	int *next;                /* per edict, same encoding as heads */
+	int *bucket;              /* per edict, bucket + 1, 0 if not hashed */
+} namehash_t;
+
+static namehash_t namehashes[2];
+static qboolean namehash_valid;
+
+static void
+G_NameHashUnlink(namehash_t *hash, int num)
+{
+	int *link;
+
+	if (!hash->bucket[num])
+	{
+		return;
+	}
+
+	link = &hash->heads[hash->bucket[num] - 1];
+
+	while (*link && (*link != num + 1))
+	{
+		link = &hash->next[*link - 1];
+	}
+
+	if (*link)
+	{
+		*link = hash->next[num];
+	}
+
+	hash->next[num] = 0;
+	hash->bucket[num] = 0;
+}
+
+static void
+G_NameHashLink(namehash_t *hash, int num)
+{
+	const char *name;
+	unsigned int bucket;
+	int *link;
+
+	name = *(const char **)((byte *)&g_edicts[num] + hash->fieldofs);
+
+	if (!name)
+	{
+		return;
+	}
+
+	bucket = Q_strhash(name) & (NAMEHASH_SIZE - 1);
+	link = &hash->heads[bucket];
+
+	while (*link && (*link < num + 1))
+	{
+		link = &hash->next[*link - 1];
+	}
+
+	hash->next[num] = *link;
+	hash->bucket[num] = bucket + 1;
+	*link = num + 1;
+}
+
+static void
+G_SetName(edict_t *ent, int which, const char *name)
+{
+	namehash_t *hash = &namehashes[which];
+	int num = ent - g_edicts;
+
+	if (namehash_valid)
+	{
+		G_NameHashUnlink(hash, num);
+	}
+
+	*(const char **)((byte *)ent + hash->fieldofs) = name;
+
+	if (namehash_valid)
+	{
+		G_NameHashLink(hash, num);
+	}
+}
+
+void
+G_SetClassname(edict_t *ent, const char *classname)
+{
+	if (!ent)
+	{
+		return;
+	}
+
+	G_SetName(ent, 0, classname);
+}
+
+void
+G_SetTargetname(edict_t *ent, const char *targetname)
+{
+	if (!ent)
+	{
+		return;
+	}
+
+	G_SetName(ent, 1, targetname);
+}
+
+/*
+ * Allocates the name hashes,
+ * called by InitAllocations().
+ */
+void
+G_InitNameHash(void)
+{
+	int i;
+
+	namehashes[0].fieldofs = FOFS(classname);
+	namehashes[1].fieldofs = FOFS(targetname);
+
+	for (i = 0; i < 2; i++)
+	{
+		namehashes[i].next = gi.TagMalloc(game.maxentities * sizeof(int), TAG_GAME);
+		namehashes[i].bucket = gi.TagMalloc(game.maxentities * sizeof(int), TAG_GAME);
+	}
+
+	namehash_valid = false;
+}
+
+/*
+ * Drops the name hashes. Used while a level is
+ * spawned or loaded, since the fields are written
+ * directly in that case. G_Find() falls back to
+ * a linear search until G_BuildNameHash() is called.
+ */
+void
+G_InvalidateNameHash(void)
+{
+	namehash_valid = false;
+}
+
+/*
+ * Rebuilds the name hashes from scratch.
+ */
+void
+G_BuildNameHash(void)
+{
+	int i, j;
+
+	for (i = 0; i < 2; i++)
+	{
+		if (!namehashes[i].next)
+		{
+			return;
+		}
+
+		memset(namehashes[i].heads, 0, sizeof(namehashes[i].heads));
+		memset(namehashes[i].next, 0, game.maxentities * sizeof(int));
+		memset(namehashes[i].bucket, 0, game.maxentities * sizeof(int));
+
+		for (j = 0; j < globals.num_edicts; j++)
+		{
+			if (g_edicts[j].inuse)
+			{
+				G_NameHashLink(&namehashes[i], j);
+			}
+		}
+	}
+
+	namehash_valid = true;
+}
+
 /*
  * Searches all active entities for the next
  * one that holds the matching string at fieldofs
@@ -50,13 +230,51 @@ G_ProjectSource(const vec3_t point, const vec3_t distance, const vec3_t forward,
 edict_t *
 G_Find(edict_t *from, int fieldofs, const char *match)
 {
+	namehash_t *hash = NULL;
 	char *s;
+	int i;
 
 	if (!match)
 	{
 		return NULL;
 	}
 
+	if (namehash_valid)
+	{
+		for (i = 0; i < 2; i++)
+		{
+			if (namehashes[i].fieldofs == fieldofs)
+			{
+				hash = &namehashes[i];
+				break;
+			}
+		}
+	}
+
+	if (hash)
+	{
+		i = hash->heads[Q_strhash(match) & (NAMEHASH_SIZE - 1)];
+
+		for ( ; i; i = hash->next[i - 1])
+		{
+			edict_t *ent = &g_edicts[i - 1];
+
+			if ((from && (ent <= from)) || !ent->inuse)
+			{
+				continue;
+			}
+
+			s = *(char **)((byte *)ent + fieldofs);
+
+			if (s && !Q_stricmp(s, match))
+			{
+				return ent;
+			}
+		}
+
+		return NULL;
+	}
+
 	if (!from)
 	{
 		from = g_edicts;
@@ -89,9 +307,63 @@ G_Find(edict_t *from, int fieldofs, const char *match)
 	return NULL;
 }
 
+/* Candidates of the last findradius() query. */
+static edict_t *radius_list[MAX_EDICTS];
+static int radius_count;
+static int radius_pos;
+static vec3_t radius_org;
+static float radius_rad;
+static edict_t *radius_last;
+
+static int
+RadiusCompare(const void *a, const void *b)
+{
+	const edict_t *ea = *(const edict_t **)a;
+	const edict_t *eb = *(const edict_t **)b;
+
+	return (ea > eb) - (ea < eb);
+}
+
+/*
+ * Collects the world and all entities whose
+ * bounding box touches the cube around the
+ * sphere from the servers area nodes, sorted
+ * by number.
+ */
+static void
+RadiusQuery(const vec3_t org, float rad)
+{
+	vec3_t mins, maxs;
+	int i;
+
+	for (i = 0; i < 3; i++)
+	{
+		mins[i] = org[i] - rad;
+		maxs[i] = org[i] + rad;
+	}
+
+	/* the world is never linked */
+	radius_list[0] = g_edicts;
+	radius_count = 1;
+
+	radius_count += gi.BoxEdicts(mins, maxs, radius_list + radius_count,
+			MAX_EDICTS - radius_count, AREA_SOLID);
+	radius_count += gi.BoxEdicts(mins, maxs, radius_list + radius_count,
+			MAX_EDICTS - radius_count, AREA_TRIGGERS);
+
+	qsort(radius_list + 1, radius_count - 1, sizeof(radius_list[0]),
+			RadiusCompare);
+
+	VectorCopy(org, radius_org);
+	radius_rad = rad;
+	radius_pos = 0;
+}
+
 /*
  * Returns entities that have origins
- * within a spherical area
+ * within a spherical area. Only entities
+ * linked into the world are found, the
+ * candidates come from the area nodes.
  */
 edict_t *
 findradius(edict_t *from, const vec3_t org, float rad)
@@ -99,31 +371,39 @@ findradius(edict_t *from, const vec3_t org, float rad)
 	vec3_t eorg;
 	int j;
 
-	if (!from)
-	{
-		from = g_edicts;
-	}
-	else
+	/* continue the last query if this is the
+	   next call of the same loop, else start
+	   a new query behind from. */
+	if (!from || (from != radius_last) || (rad != radius_rad) ||
+		!VectorCompare(org, radius_org))
 	{
-		from++;
+		RadiusQuery(org, rad);
+
+		while (from && (radius_pos < radius_count) &&
+			   (radius_list[radius_pos] <= from))
+		{
+			radius_pos++;
+		}
 	}
 
-	for ( ; from < &g_edicts[globals.num_edicts]; from++)
+	while (radius_pos < radius_count)
 	{
-		if (!from->inuse)
+		edict_t *ent = radius_list[radius_pos++];
+
+		if (!ent->inuse)
 		{
 			continue;
 		}
 
-		if (from->solid == SOLID_NOT)
+		if (ent->solid == SOLID_NOT)
 		{
 			continue;
 		}
 
 		for (j = 0; j < 3; j++)
 		{
-			eorg[j] = org[j] - (from->s.origin[j] +
-					   (from->mins[j] + from->maxs[j]) * 0.5);
+			eorg[j] = org[j] - (ent->s.origin[j] +
+					   (ent->mins[j] + ent->maxs[j]) * 0.5);
 		}
 
 		if (VectorLength(eorg) > rad)
@@ -131,9 +411,11 @@ findradius(edict_t *from, const vec3_t org, float rad)
 			continue;
 		}
 
-		return from;
+		radius_last = ent;
+		return ent;
 	}
 
+	radius_last = NULL;
 	return NULL;
 }
 
@@ -226,7 +508,7 @@ G_UseTargets(edict_t *ent, edict_t *activator)
 	{
 		/* create a temp object to fire at a later time */
 		t = G_Spawn();
-		t->classname = "DelayedUse";
+		G_SetClassname(t, "DelayedUse");
 		t->nextthink = level.time + ent->delay;
 		t->think = Think_Delay;
 		t->activator = activator;
@@ -504,7 +786,7 @@ G_InitEdict(edict_t *e)
 	}
 
 	e->inuse = true;
-	e->classname = "noclass";
+	G_SetClassname(e, "noclass");
 	e->gravity = 1.0;
 	e->s.number = e - g_edicts;
 }
@@ -603,6 +885,9 @@ G_FreeEdict(edict_t *ed)
 		}
 	}
 
+	G_SetClassname(ed, NULL);
+	G_SetTargetname(ed, NULL);
+
 	memset(ed, 0, sizeof(*ed));
 	ed->classname = "freed";
 	ed->freetime = level.time;
@@ -235,3 +235,44 @@ typedef struct
 	int num_edicts;             /* current number, <= max_edicts */
 	int max_edicts;
 } game_export_t;
+
+/* Optional extensions. A game that exports GetGameExtension()
+   gets it called right after GetGameAPI() with the highest
+   version the server knows in apiversion. It returns the highest
+   version it knows itself. Neither side may touch fields above
+   the lower of both versions, so old games and old servers keep
+   working as before. */
+#define GAME_EXT_API_VERSION 3
+
+/* a single trace of TraceBatch() */
+typedef struct
+{
+	vec3_t start, end;
+	vec3_t mins, maxs;
+	const edict_t *passent;
+	int contentmask;
+} tracerequest_t;
+
+typedef struct
+{
+	int apiversion;
+
+	/* version 1 */
+	long long (*Microseconds)(void);
+
+	/* adds usec to the think time profile of classname */
+	void (*ProfileThink)(const char *classname, int usec);
+
+	/* version 2 */
+	/* runs count independent traces, results[i] is what trace()
+	   would return for requests[i], but the traces are faster */
+	void (*TraceBatch)(const tracerequest_t *requests, trace_t *results,
+			int count);
+
+	/* version 3 */
+	/* true if ProfileThink() should be called this frame. Timing
+	   every entity isn't free, games skip it when nobody looks */
+	qboolean (*ProfileThinkWanted)(void);
+} game_ext_import_t;
+
+typedef int (*game_ext_t)(const game_ext_import_t *import);
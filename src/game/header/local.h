@@ -448,6 +448,8 @@ extern game_locals_t game;
 extern level_locals_t level;
 extern game_import_t gi;
 extern game_export_t globals;
+extern const game_ext_import_t *gix;
+extern int gix_version;
 extern spawn_temp_t st;
 
 extern int sm_meat_index;
@@ -644,6 +646,11 @@ void G_ProjectSource(const vec3_t point, const vec3_t distance, const vec3_t for
 edict_t *G_Find(edict_t *from, int fieldofs, const char *match);
 edict_t *findradius(edict_t *from, const vec3_t org, float rad);
 edict_t *G_PickTarget(char *targetname);
+void G_SetClassname(edict_t *ent, const char *classname);
+void G_SetTargetname(edict_t *ent, const char *targetname);
+void G_InitNameHash(void);
+void G_InvalidateNameHash(void);
+void G_BuildNameHash(void);
 void G_UseTargets(edict_t *ent, edict_t *activator);
 void G_SetMovedir(vec3_t angles, vec3_t movedir);
 
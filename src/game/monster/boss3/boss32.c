@@ -1261,7 +1261,7 @@ MakronToss(edict_t *self)
 	}
 
 	ent = G_Spawn();
-	ent->classname = "monster_makron";
+	G_SetClassname(ent, "monster_makron");
 	ent->nextthink = level.time + 0.8;
 	ent->think = MakronSpawn;
 	ent->target = self->target;
@@ -73,7 +73,7 @@ SP_FixCoopSpots(edict_t *self)
 		{
 			if ((!self->targetname) || (Q_stricmp(self->targetname, spot->targetname) != 0))
 			{
-				self->targetname = spot->targetname;
+				G_SetTargetname(self, spot->targetname);
 			}
 
 			return;
@@ -100,27 +100,27 @@ SP_CreateCoopSpots(edict_t *self)
 	if (Q_stricmp(level.mapname, "security") == 0)
 	{
 		spot = G_Spawn();
-		spot->classname = "info_player_coop";
+		G_SetClassname(spot, "info_player_coop");
 		spot->s.origin[0] = 188 - 64;
 		spot->s.origin[1] = -164;
 		spot->s.origin[2] = 80;
-		spot->targetname = "jail3";
+		G_SetTargetname(spot, "jail3");
 		spot->s.angles[1] = 90;
 
 		spot = G_Spawn();
-		spot->classname = "info_player_coop";
+		G_SetClassname(spot, "info_player_coop");
 		spot->s.origin[0] = 188 + 64;
 		spot->s.origin[1] = -164;
 		spot->s.origin[2] = 80;
-		spot->targetname = "jail3";
+		G_SetTargetname(spot, "jail3");
 		spot->s.angles[1] = 90;
 
 		spot = G_Spawn();
-		spot->classname = "info_player_coop";
+		G_SetClassname(spot, "info_player_coop");
 		spot->s.origin[0] = 188 + 128;
 		spot->s.origin[1] = -164;
 		spot->s.origin[2] = 80;
-		spot->targetname = "jail3";
+		G_SetTargetname(spot, "jail3");
 		spot->s.angles[1] = 90;
 
 		return;
@@ -158,7 +158,7 @@ CreateUnnamedSpawnpoint(const edict_t *self, const char *mapname, const char *sp
 		return;
 	}
 
-	spot->classname = "info_player_start";
+	G_SetClassname(spot, "info_player_start");
 
 	VectorCopy(self->s.origin, spot->s.origin);
 	spot->s.angles[1] = self->s.angles[1];
@@ -1314,7 +1314,7 @@ InitBodyQue(void)
 		for (i = 0; i < BODY_QUEUE_SIZE; i++)
 		{
 			ent = G_Spawn();
-			ent->classname = "bodyque";
+			G_SetClassname(ent, "bodyque");
 		}
 	}
 }
@@ -1610,7 +1610,7 @@ PutClientInServer(edict_t *ent)
 	ent->movetype = MOVETYPE_WALK;
 	ent->viewheight = 22;
 	ent->inuse = true;
-	ent->classname = "player";
+	G_SetClassname(ent, "player");
 	ent->mass = 200;
 	ent->solid = SOLID_BBOX;
 	ent->deadflag = DEAD_NO;
@@ -1794,7 +1794,7 @@ ClientBegin(edict_t *ent)
 		   except for the persistant data that was initialized at
 		   ClientConnect() time */
 		G_InitEdict(ent);
-		ent->classname = "player";
+		G_SetClassname(ent, "player");
 		InitClientResp(ent->client);
 		PutClientInServer(ent);
 	}
@@ -2032,7 +2032,7 @@ ClientDisconnect(edict_t *ent)
 	ent->s.modelindex = 0;
 	ent->solid = SOLID_NOT;
 	ent->inuse = false;
-	ent->classname = "disconnected";
+	G_SetClassname(ent, "disconnected");
 	ent->client->pers.connected = false;
 
 	playernum = ent - g_edicts - 1;
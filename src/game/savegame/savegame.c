@@ -318,6 +318,8 @@ InitAllocations(void)
 
 	game.clients = gi.TagMalloc (num_c * sizeof(game.clients[0]), TAG_GAME);
 	game.maxclients = num_c;
+
+	G_InitNameHash();
 }
 
 /*
@@ -1334,6 +1336,7 @@ ReadLevel(const char *filename)
 	gi.FreeTags(TAG_LEVEL);
 
 	/* wipe all the entities */
+	G_InvalidateNameHash();
 	memset(g_edicts, 0, game.maxentities * sizeof(g_edicts[0]));
 	globals.num_edicts = maxclients->value + 1;
 
@@ -1399,6 +1402,8 @@ ReadLevel(const char *filename)
 		ent->client->pers.connected = false;
 	}
 
+	G_BuildNameHash();
+
 	/* do any load time things at this point */
 	for (i = 0; i < globals.num_edicts; i++)
 	{
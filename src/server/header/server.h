@@ -46,6 +46,9 @@
 #define MAX_SAVE_TOKEN_CHARS 128
 
 
+/* Size of each clients slice of svs.client_entities. */
+#define ENTITIES_PER_CLIENT (UPDATE_BACKUP * 64)
+
 #define SV_OUTPUTBUF_LENGTH (MAX_MSGLEN - 16)
 #define EDICT_NUM(n) ((edict_t *)((byte *)ge->edicts + ge->edict_size * (n)))
 #define CL_EDICT(cl) EDICT_NUM(1 + ((cl) - svs.clients))
@@ -105,7 +108,7 @@ typedef struct
 	byte areabits[MAX_MAP_AREAS / 8];       /* portalarea visibility bits */
 	player_state_t ps;
 	int num_entities;
-	int first_entity;                       /* into the circular sv_packet_entities[] */
+	unsigned int first_entity;              /* into the clients slice of svs.client_entities[] */
 	int senttime;                           /* for ping calculations */
 } client_frame_t;
 
@@ -136,6 +139,7 @@ typedef struct client_s
 	byte datagram_buf[MAX_MSGLEN];
 
 	client_frame_t frames[UPDATE_BACKUP];     /* updates can be delta'd from here */
+	unsigned int next_entity;           /* next entry of the clients slice */
 
 	byte *download;                     /* file being downloaded */
 	int downloadsize;                   /* total bytes (can't use EOF because of paks) */
@@ -154,8 +158,31 @@ typedef struct client_s
 	int cached_area;
 	int cached_cluster;
 	int cached_framenum;
+
+	/* lookup by address and qport */
+	struct client_s *hash_next;
+	int hash_bucket;                    /* bucket + 1, 0 if not hashed */
 } client_t;
 
+/* The clients point of view for SV_BuildClientEntities(). */
+typedef struct
+{
+	vec3_t org;
+	int area;
+	int32_t fatpvs[65536 / 32];
+	int32_t phs[65536 / 32];
+} clientview_t;
+
+/* Scratch space for sending a client
+   its frame from a worker thread. */
+typedef struct
+{
+	client_t *client;
+	clientview_t view;
+	sizebuf_t msg;
+	byte msg_buf[MAX_MSGLEN];
+} clientsend_t;
+
 typedef struct
 {
 	netadr_t adr;
@@ -163,10 +190,13 @@ typedef struct
 	int time;
 } challenge_t;
 
+#define CLIENT_HASH_SIZE 256
+
 typedef struct
 {
 	qboolean initialized;               /* sv_init has completed */
 	int realtime;                       /* always increasing, no clamping, etc */
+	int realtime_usec;                  /* microseconds not yet added to realtime */
 
 	char mapcmd[MAX_SAVE_TOKEN_CHARS];  /* ie: *intro.cin+base */
 
@@ -174,9 +204,10 @@ typedef struct
 										/* used to check late spawns */
 
 	client_t *clients;                  /* [maxclients->value]; */
-	int num_client_entities;            /* maxclients->value*UPDATE_BACKUP*MAX_PACKET_ENTITIES */
-	int next_client_entities;           /* next client_entity to use */
+	int num_client_entities;            /* maxclients->value*ENTITIES_PER_CLIENT */
 	entity_state_t *client_entities;    /* [num_client_entities] */
+	clientsend_t *sends;                /* [maxclients->value], allocated on demand */
+	client_t *client_hash[CLIENT_HASH_SIZE]; /* by base address and qport */
 
 	int last_heartbeat;
 
@@ -215,6 +246,9 @@ extern edict_t *sv_player;
 
 void SV_FinalMessage(char *message, qboolean reconnect);
 void SV_DropClient(client_t *drop);
+void SV_TickStats_f(void);
+void SV_HashClient(client_t *cl);
+void SV_UnhashClient(client_t *cl);
 
 int SV_ModelIndex(const char *name);
 int SV_SoundIndex(const char *name);
@@ -260,14 +294,42 @@ void SV_ReadLevelFile(void);
 
 void SV_WriteFrameToClient(client_t *client, sizebuf_t *msg);
 void SV_RecordDemoMessage(void);
+void SV_IndexEntities(void);
+void SV_FreeEntityIndex(void);
+qboolean SV_SetupClientView(client_t *client, clientview_t *view);
+void SV_BuildClientEntities(client_t *client, const clientview_t *view);
 void SV_BuildClientFrame(client_t *client);
 
 extern game_export_t *ge;
+extern int ge_extversion;
 
 void SV_InitGameProgs(void);
 void SV_ShutdownGameProgs(void);
 void SV_InitEdict(edict_t *e);
 
+/* frame profiler */
+typedef enum
+{
+	PROF_TIMEOUTS,
+	PROF_PACKETS,
+	PROF_PINGS,
+	PROF_GAME,
+	PROF_SEND,
+	PROF_DEMO,
+	PROF_HEARTBEAT,
+	PROF_TOTAL,
+
+	PROF_NUMPHASES
+} profphase_t;
+
+void SV_InitProfile(void);
+void SV_ProfileBeginFrame(void);
+void SV_ProfileMark(profphase_t phase);
+void SV_ProfileEndFrame(void);
+void SV_ProfileThink(const char *classname, int usec);
+qboolean SV_ProfileThinkWanted(void);
+void SV_Profile_f(void);
+
 /* server side savegame stuff */
 void SV_WipeSavegame(char *savename);
 void SV_CopySaveGame(char *src, char *dst);
@@ -297,6 +359,8 @@ int SV_PointContents(const vec3_t p);
 
 trace_t SV_Trace(const vec3_t start, const vec3_t mins, const vec3_t maxs,
 		const vec3_t end, const edict_t *passedict, int contentmask);
+void SV_TraceBatch(const tracerequest_t *requests, trace_t *results,
+		int count);
 
 /* loadtime optimizations */
 
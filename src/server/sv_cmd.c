@@ -768,6 +768,8 @@ SV_InitOperatorCommands(void)
 	Cmd_AddCommand("heartbeat", SV_Heartbeat_f);
 	Cmd_AddCommand("kick", SV_Kick_f);
 	Cmd_AddCommand("status", SV_Status_f);
+	Cmd_AddCommand("tickstats", SV_TickStats_f);
+	Cmd_AddCommand("sv_profile", SV_Profile_f);
 	Cmd_AddCommand("serverinfo", SV_Serverinfo_f);
 	Cmd_AddCommand("dumpuser", SV_DumpUser_f);
 
@@ -270,6 +270,7 @@ gotnewcl:
 
 	/* build a new connection  accept the new client this
 	   is the only place a client_t is ever initialized */
+	SV_UnhashClient(newcl);
 	*newcl = temp;
 	sv_client = newcl;
 	ent = CL_EDICT(newcl);
@@ -311,6 +312,7 @@ gotnewcl:
 	Netchan_Setup(NS_SERVER, &newcl->netchan, adr, qport);
 
 	newcl->state = cs_connected;
+	SV_HashClient(newcl);
 
 	SZ_Init(&newcl->datagram, newcl->datagram_buf, sizeof(newcl->datagram_buf));
 	newcl->datagram.allowoverflow = true;
@@ -30,14 +30,28 @@
 
 #include "header/server.h"
 
-// DG: is casted to int32_t* in SV_FatPVS() so align accordingly
-static YQ2_ALIGNAS_TYPE(int32_t) byte fatpvs[65536 / 8];
+/* Used by SV_BuildClientFrame() */
+static clientview_t clientview;
+
+/*
+ * Returns an entry of the clients slice of the
+ * svs.client_entities ring. Each client owns its
+ * slice, so frames of different clients can be
+ * built at the same time.
+ */
+static entity_state_t *
+SV_ClientEntity(const client_t *client, unsigned int index)
+{
+	return &svs.client_entities[(client - svs.clients) * ENTITIES_PER_CLIENT +
+		index % ENTITIES_PER_CLIENT];
+}
 
 /*
  * Writes a delta update of an entity_state_t list to the message.
  */
 static void
-SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
+SV_EmitPacketEntities(const client_t *client, client_frame_t *from,
+		client_frame_t *to, sizebuf_t *msg)
 {
 	entity_state_t *oldent, *newent;
 	int oldindex, newindex;
@@ -75,8 +89,7 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 		}
 		else
 		{
-			newent = &svs.client_entities[(to->first_entity +
-					 newindex) % svs.num_client_entities];
+			newent = SV_ClientEntity(client, to->first_entity + newindex);
 			newnum = newent->number;
 		}
 
@@ -86,8 +99,7 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 		}
 		else
 		{
-			oldent = &svs.client_entities[(from->first_entity +
-					 oldindex) % svs.num_client_entities];
+			oldent = SV_ClientEntity(client, from->first_entity + oldindex);
 			oldnum = oldent->number;
 		}
 
@@ -415,6 +427,14 @@ SV_WriteFrameToClient(client_t *client, sizebuf_t *msg)
 		oldframe = NULL;
 		lastframe = -1;
 	}
+	else if (client->next_entity -
+			client->frames[client->lastframe & UPDATE_MASK].first_entity >
+			ENTITIES_PER_CLIENT)
+	{
+		/* the entities of the old frame were overwritten */
+		oldframe = NULL;
+		lastframe = -1;
+	}
 	else
 	{
 		/* we have a valid message to delta from */
@@ -436,7 +456,7 @@ SV_WriteFrameToClient(client_t *client, sizebuf_t *msg)
 	SV_WritePlayerstateToClient(oldframe, frame, msg);
 
 	/* delta encode the entities */
-	SV_EmitPacketEntities(oldframe, frame, msg);
+	SV_EmitPacketEntities(client, oldframe, frame, msg);
 }
 
 /*
@@ -444,13 +464,13 @@ SV_WriteFrameToClient(client_t *client, sizebuf_t *msg)
  * so we can't use a single PVS point
  */
 static void
-SV_FatPVS(vec3_t org)
+SV_FatPVS(vec3_t org, int32_t *fatpvs)
 {
 	int leafs[64];
 	int i, j, count;
 	// DG: used to be called "longs" and long was used which isn't really correct on 64bit
 	int32_t numInt32s;
-	byte *src;
+	const byte *src;
 	vec3_t mins, maxs;
 
 	for (i = 0; i < 3; i++)
@@ -496,35 +516,231 @@ SV_FatPVS(vec3_t org)
 
 		for (j = 0; j < numInt32s; j++)
 		{
-			((int32_t *)fatpvs)[j] |= ((int32_t *)src)[j];
+			fatpvs[j] |= ((const int32_t *)src)[j];
 		}
 	}
 }
 
 /*
- * Decides which entities are going to be visible to the client, and
- * copies off the playerstat and areabits.
+ * Index of the entities that can be sent to clients.
+ * Built once per server frame by SV_IndexEntities(),
+ * bits are indexed by edict number. A client frame
+ * ORs the rows of all clusters in the clients PVS
+ * and ANDs the result with the entities in areas
+ * connected to the clients area, instead of testing
+ * every edict on its own.
  */
+#define ENTITY_WORDS (MAX_EDICTS / 32)
+
+typedef struct
+{
+	uint32_t bits[ENTITY_WORDS];
+} entitybits_t;
+
+static struct
+{
+	int numwords;                       /* words covering ge->num_edicts */
+	entitybits_t sendable;              /* entities that may be sent at all */
+	entitybits_t special;               /* beams and entities in too many clusters */
+
+	int numareas;                       /* highest area in use + 1 */
+	entitybits_t areas[MAX_MAP_AREAS];  /* entities touching each area */
+
+	int numclusters;
+	int *clusterrows;                   /* row of each cluster, -1 if none */
+	int *rowclusters;                   /* cluster of each row */
+	entitybits_t *rows;                 /* entities touching a cluster */
+	int numrows;
+} entindex;
+
+#define ENTBIT_SET(b, n) ((b)->bits[(n) >> 5] |= 1u << ((n) & 31))
+#define ENTBIT_TEST(b, n) ((b)->bits[(n) >> 5] & (1u << ((n) & 31)))
+
 void
-SV_BuildClientFrame(client_t *client)
+SV_FreeEntityIndex(void)
+{
+	if (entindex.clusterrows)
+	{
+		Z_Free(entindex.clusterrows);
+		Z_Free(entindex.rowclusters);
+		Z_Free(entindex.rows);
+	}
+
+	entindex.clusterrows = NULL;
+	entindex.rowclusters = NULL;
+	entindex.rows = NULL;
+	entindex.numclusters = 0;
+	entindex.numrows = 0;
+}
+
+static void
+SV_IndexEntityArea(int area, int e)
+{
+	if ((area < 0) || (area >= MAX_MAP_AREAS))
+	{
+		return;
+	}
+
+	ENTBIT_SET(&entindex.areas[area], e);
+
+	if (area >= entindex.numareas)
+	{
+		entindex.numareas = area + 1;
+	}
+}
+
+static void
+SV_IndexEntityCluster(int cluster, int e)
+{
+	int row;
+
+	if ((cluster < 0) || (cluster >= entindex.numclusters))
+	{
+		return;
+	}
+
+	row = entindex.clusterrows[cluster];
+
+	if (row < 0)
+	{
+		row = entindex.numrows++;
+
+		entindex.clusterrows[cluster] = row;
+		entindex.rowclusters[row] = cluster;
+		memset(&entindex.rows[row], 0, entindex.numwords * sizeof(uint32_t));
+	}
+
+	ENTBIT_SET(&entindex.rows[row], e);
+}
+
+/*
+ * Makes sure that every entity knows its number and
+ * builds the per cluster and per area entity index.
+ * Must be called after the game ran and before the
+ * client frames are built.
+ */
+void
+SV_IndexEntities(void)
 {
-	int e, i;
-	vec3_t org;
 	edict_t *ent;
+	int e, i;
+	int numclusters;
+	int numedicts;
+
+	/* (re)allocate the cluster rows for the current map */
+	numclusters = CM_NumClusters();
+
+	if (numclusters != entindex.numclusters)
+	{
+		SV_FreeEntityIndex();
+
+		if (numclusters > 0)
+		{
+			entindex.numclusters = numclusters;
+			entindex.clusterrows = Z_Malloc(numclusters * sizeof(int));
+			entindex.rowclusters = Z_Malloc(numclusters * sizeof(int));
+			entindex.rows = Z_Malloc(numclusters * sizeof(entitybits_t));
+
+			for (i = 0; i < numclusters; i++)
+			{
+				entindex.clusterrows[i] = -1;
+			}
+		}
+	}
+
+	/* forget the last frame */
+	for (i = 0; i < entindex.numrows; i++)
+	{
+		entindex.clusterrows[entindex.rowclusters[i]] = -1;
+	}
+
+	entindex.numrows = 0;
+
+	numedicts = Q_min(ge->num_edicts, MAX_EDICTS);
+	entindex.numwords = (numedicts + 31) >> 5;
+
+	memset(&entindex.sendable, 0, sizeof(entindex.sendable));
+	memset(&entindex.special, 0, sizeof(entindex.special));
+
+	for (i = 0; i < entindex.numareas; i++)
+	{
+		memset(&entindex.areas[i], 0, entindex.numwords * sizeof(uint32_t));
+	}
+
+	entindex.numareas = 0;
+
+	for (e = 1; e < ge->num_edicts; e++)
+	{
+		ent = EDICT_NUM(e);
+
+		if (ent->s.number != e)
+		{
+			Com_DPrintf("FIXING ENT->S.NUMBER!!!\n");
+			ent->s.number = e;
+		}
+
+		if (e >= MAX_EDICTS)
+		{
+			continue;
+		}
+
+		/* ignore ents without visible models */
+		if (ent->svflags & SVF_NOCLIENT)
+		{
+			continue;
+		}
+
+		/* ignore ents without visible models unless they have an effect */
+		if (!ent->s.modelindex && !ent->s.effects &&
+			!ent->s.sound && !ent->s.event)
+		{
+			continue;
+		}
+
+		ENTBIT_SET(&entindex.sendable, e);
+
+		/* doors can legally straddle two areas */
+		SV_IndexEntityArea(ent->areanum, e);
+
+		if (ent->areanum2)
+		{
+			SV_IndexEntityArea(ent->areanum2, e);
+		}
+
+		if ((ent->s.renderfx & RF_BEAM) || (ent->num_clusters == -1))
+		{
+			/* checked one by one */
+			ENTBIT_SET(&entindex.special, e);
+			continue;
+		}
+
+		for (i = 0; i < ent->num_clusters; i++)
+		{
+			SV_IndexEntityCluster(ent->clusternums[i], e);
+		}
+	}
+}
+
+/*
+ * Sets up the clients frame and everything needed to
+ * decide which entities the client sees. Uses the
+ * collision model, so it must run on the main thread.
+ * Returns false if the client isn't in game yet.
+ */
+qboolean
+SV_SetupClientView(client_t *client, clientview_t *view)
+{
+	int i;
 	edict_t *clent;
 	client_frame_t *frame;
-	entity_state_t *state;
-	int l;
-	int clientarea, clientcluster;
+	int clientcluster;
 	int leafnum;
-	byte *clientphs;
-	byte *bitvector;
 
 	clent = CL_EDICT(client);
 
 	if (!clent->client)
 	{
-		return; /* not in game yet */
+		return false; /* not in game yet */
 	}
 
 	/* this is the frame we are creating */
@@ -535,62 +751,108 @@ SV_BuildClientFrame(client_t *client)
 	/* find the client's PVS */
 	for (i = 0; i < 3; i++)
 	{
-		org[i] = clent->client->ps.pmove.origin[i] * 0.125 +
+		view->org[i] = clent->client->ps.pmove.origin[i] * 0.125 +
 				 clent->client->ps.viewoffset[i];
 	}
 
-	leafnum = CM_PointLeafnum(org);
-	clientarea = CM_LeafArea(leafnum);
+	leafnum = CM_PointLeafnum(view->org);
+	view->area = CM_LeafArea(leafnum);
 	clientcluster = CM_LeafCluster(leafnum);
 
 	/* calculate the visible areas */
-	frame->areabytes = CM_WriteAreaBits(frame->areabits, clientarea);
+	frame->areabytes = CM_WriteAreaBits(frame->areabits, view->area);
 
 	/* grab the current player_state_t */
 	frame->ps = clent->client->ps;
 
-	SV_FatPVS(org);
-	clientphs = CM_ClusterPHS(clientcluster);
+	SV_FatPVS(view->org, view->fatpvs);
+	memcpy(view->phs, CM_ClusterPHS(clientcluster),
+			((CM_NumClusters() + 31) >> 5) << 2);
 
-	/* build up the list of visible entities */
-	frame->num_entities = 0;
-	frame->first_entity = svs.next_client_entities;
+	return true;
+}
 
-	for (e = 1; e < ge->num_edicts; e++)
-	{
-		ent = EDICT_NUM(e);
+/*
+ * Decides which entities are going to be visible to the
+ * client and copies them into its slice of the client
+ * entities. Only reads the world, so frames of different
+ * clients can be built in parallel.
+ */
+void
+SV_BuildClientEntities(client_t *client, const clientview_t *view)
+{
+	int e, i, w;
+	edict_t *ent;
+	edict_t *clent;
+	client_frame_t *frame;
+	entity_state_t *state;
+	int l;
+	const byte *clientphs;
+	const byte *bitvector;
+	entitybits_t areas;
+	entitybits_t visible;
+	uint32_t bits;
 
-		/* ignore ents without visible models */
-		if (ent->svflags & SVF_NOCLIENT)
+	clent = CL_EDICT(client);
+
+	/* this is the frame we are creating */
+	frame = &client->frames[sv.framenum & UPDATE_MASK];
+
+	clientphs = (const byte *)view->phs;
+	bitvector = (const byte *)view->fatpvs;
+
+	/* entities in areas connected to the clients area */
+	memset(&areas, 0, entindex.numwords * sizeof(uint32_t));
+
+	for (i = 0; i < entindex.numareas; i++)
+	{
+		if (CM_AreasConnected(view->area, i))
 		{
-			continue;
+			for (w = 0; w < entindex.numwords; w++)
+			{
+				areas.bits[w] |= entindex.areas[i].bits[w];
+			}
 		}
+	}
 
-		/* ignore ents without visible models unless they have an effect */
-		if (!ent->s.modelindex && !ent->s.effects &&
-			!ent->s.sound && !ent->s.event)
+	/* entities touching a PV leaf */
+	memset(&visible, 0, entindex.numwords * sizeof(uint32_t));
+
+	for (i = 0; i < entindex.numrows; i++)
+	{
+		l = entindex.rowclusters[i];
+
+		if (bitvector[l >> 3] & (1 << (l & 7)))
 		{
-			continue;
+			for (w = 0; w < entindex.numwords; w++)
+			{
+				visible.bits[w] |= entindex.rows[i].bits[w];
+			}
 		}
+	}
 
-		/* ignore if not touching a PV leaf */
-		if (ent != clent)
+	for (w = 0; w < entindex.numwords; w++)
+	{
+		visible.bits[w] &= areas.bits[w];
+	}
+
+	/* the rest needs to be checked one by one */
+	for (w = 0; w < entindex.numwords; w++)
+	{
+		bits = entindex.special.bits[w] & areas.bits[w];
+
+		for (e = w << 5; bits; e++, bits >>= 1)
 		{
-			/* check area */
-			if (!CM_AreasConnected(clientarea, ent->areanum))
+			if (!(bits & 1))
 			{
-				/* doors can legally straddle two areas,
-				   so we may need to check another one */
-				if (!ent->areanum2 ||
-					!CM_AreasConnected(clientarea, ent->areanum2))
-				{
-					continue; /* blocked by a door */
-				}
+				continue;
 			}
 
-			/* beams just check one point for PHS */
+			ent = EDICT_NUM(e);
+
 			if (ent->s.renderfx & RF_BEAM)
 			{
+				/* beams just check one point for PHS */
 				l = ent->clusternums[0];
 
 				if (!(clientphs[l >> 3] & (1 << (l & 7))))
@@ -598,74 +860,86 @@ SV_BuildClientFrame(client_t *client)
 					continue;
 				}
 			}
-			else
+			else if (!CM_HeadnodeVisible(ent->headnode, bitvector))
 			{
-				bitvector = fatpvs;
+				/* too many leafs for individual check, go by headnode */
+				continue;
+			}
 
-				if (ent->num_clusters == -1)
-				{
-					/* too many leafs for individual check, go by headnode */
-					if (!CM_HeadnodeVisible(ent->headnode, bitvector))
-					{
-						continue;
-					}
-				}
-				else
-				{
-					/* check individual leafs */
-					for (i = 0; i < ent->num_clusters; i++)
-					{
-						l = ent->clusternums[i];
-
-						if (bitvector[l >> 3] & (1 << (l & 7)))
-						{
-							break;
-						}
-					}
-
-					if (i == ent->num_clusters)
-					{
-						continue; /* not visible */
-					}
-				}
+			ENTBIT_SET(&visible, e);
+		}
+	}
 
-				if (!ent->s.modelindex)
-				{
-					/* don't send sounds if they
-					   will be attenuated away */
-					vec3_t delta;
+	/* the client always sees itself */
+	e = NUM_FOR_EDICT(clent);
+
+	if ((e < MAX_EDICTS) && ENTBIT_TEST(&entindex.sendable, e))
+	{
+		ENTBIT_SET(&visible, e);
+	}
+
+	/* build up the list of visible entities */
+	frame->num_entities = 0;
+	frame->first_entity = client->next_entity;
+
+	for (w = 0; w < entindex.numwords; w++)
+	{
+		bits = visible.bits[w];
+
+		for (e = w << 5; bits; e++, bits >>= 1)
+		{
+			if (!(bits & 1))
+			{
+				continue;
+			}
+
+			ent = EDICT_NUM(e);
+
+			if ((ent != clent) && !ent->s.modelindex &&
+				!(ent->s.renderfx & RF_BEAM))
+			{
+				/* don't send sounds if they
+				   will be attenuated away */
+				vec3_t delta;
 
-					VectorSubtract(org, ent->s.origin, delta);
+				VectorSubtract(view->org, ent->s.origin, delta);
 
-					if (VectorLengthSquared(delta) > 400.0f * 400.0f)
-					{
-						continue;
-					}
+				if (VectorLengthSquared(delta) > 400.0f * 400.0f)
+				{
+					continue;
 				}
 			}
-		}
 
-		/* add it to the circular client_entities array */
-		state = &svs.client_entities[svs.next_client_entities %
-				svs.num_client_entities];
+			/* add it to the clients slice of the client_entities array */
+			state = SV_ClientEntity(client, client->next_entity);
 
-		if (ent->s.number != e)
-		{
-			Com_DPrintf("FIXING ENT->S.NUMBER!!!\n");
-			ent->s.number = e;
-		}
+			*state = ent->s;
 
-		*state = ent->s;
+			/* don't mark players missiles as solid */
+			if (ent->owner == clent)
+			{
+				state->solid = 0;
+			}
 
-		/* don't mark players missiles as solid */
-		if (ent->owner == clent)
-		{
-			state->solid = 0;
+			client->next_entity++;
+			frame->num_entities++;
 		}
+	}
+}
 
-		svs.next_client_entities++;
-		frame->num_entities++;
+/*
+ * Decides which entities are going to be visible to the client, and
+ * copies off the playerstat and areabits.
+ */
+void
+SV_BuildClientFrame(client_t *client)
+{
+	if (!SV_SetupClientView(client, &clientview))
+	{
+		return;
 	}
+
+	SV_BuildClientEntities(client, &clientview);
 }
 
 /*
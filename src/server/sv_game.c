@@ -32,6 +32,7 @@ void SCR_DebugGraph(float value, int color);
 #endif
 
 game_export_t *ge;
+int ge_extversion; /* extension version agreed on with the game */
 
 /*
  * Sends the contents of the mutlicast buffer to a single client
@@ -315,7 +316,7 @@ PF_inPVS(vec3_t p1, vec3_t p2)
 	int leafnum;
 	int cluster;
 	int area1, area2;
-	byte *mask;
+	const byte *mask;
 
 	leafnum = CM_PointLeafnum(p1);
 	cluster = CM_LeafCluster(leafnum);
@@ -351,7 +352,7 @@ PF_inPHS(vec3_t p1, vec3_t p2)
 	int leafnum;
 	int cluster;
 	int area1, area2;
-	byte *mask;
+	const byte *mask;
 
 	leafnum = CM_PointLeafnum(p1);
 	cluster = CM_LeafCluster(leafnum);
@@ -406,6 +407,39 @@ SV_ShutdownGameProgs(void)
 	ge->Shutdown();
 	Sys_UnloadGame();
 	ge = NULL;
+	ge_extversion = 0;
+}
+
+/*
+ * Offers the extended imports to games that export
+ * GetGameExtension() and agrees on a version.
+ */
+static void
+SV_InitGameExtension(void)
+{
+	static game_ext_import_t extimport;
+	game_ext_t GetGameExtension;
+	int version;
+
+	ge_extversion = 0;
+
+	GetGameExtension = (game_ext_t)Sys_GetGameProc("GetGameExtension");
+
+	if (!GetGameExtension)
+	{
+		return;
+	}
+
+	extimport.apiversion = GAME_EXT_API_VERSION;
+	extimport.Microseconds = Sys_Microseconds;
+	extimport.ProfileThink = SV_ProfileThink;
+	extimport.TraceBatch = SV_TraceBatch;
+	extimport.ProfileThinkWanted = SV_ProfileThinkWanted;
+
+	version = GetGameExtension(&extimport);
+	ge_extversion = Q_clamp(version, 0, GAME_EXT_API_VERSION);
+
+	Com_DPrintf("Game extensions version %i.\n", ge_extversion);
 }
 
 /*
@@ -529,6 +563,8 @@ SV_InitGameProgs(void)
 				GAME_API_VERSION);
 	}
 
+	SV_InitGameExtension();
+
 	ge->Init();
 
 	Com_Printf("------------------------------------\n\n");
@@ -191,10 +191,118 @@ SV_GiveMsec(void)
 	}
 }
 
+/*
+ * Hash of the parts of an address that NET_CompareBaseAdr()
+ * looks at, combined with the qport. The port isn't used,
+ * address translating routers may change it.
+ */
+static int
+SV_ClientHash(const netadr_t *adr, int qport)
+{
+	unsigned int hash = 2166136261u;
+	const byte *bytes;
+	int i, len;
+
+	switch (adr->type)
+	{
+		case NA_IP:
+			bytes = adr->ip;
+			len = 4;
+			break;
+
+		case NA_IP6:
+			bytes = adr->ip;
+			len = 16;
+			break;
+
+		case NA_IPX:
+			bytes = adr->ipx;
+			len = 10;
+			break;
+
+		default:
+			bytes = NULL;
+			len = 0;
+			break;
+	}
+
+	hash = (hash ^ adr->type) * 16777619u;
+
+	for (i = 0; i < len; i++)
+	{
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+
+	hash = (hash ^ (qport & 0xff)) * 16777619u;
+	hash = (hash ^ ((qport >> 8) & 0xff)) * 16777619u;
+
+	return hash & (CLIENT_HASH_SIZE - 1);
+}
+
+/*
+ * Adds a client to the address lookup. Must be
+ * called once the netchan is set up.
+ */
+void
+SV_HashClient(client_t *cl)
+{
+	int hash;
+
+	SV_UnhashClient(cl);
+
+	hash = SV_ClientHash(&cl->netchan.remote_address, cl->netchan.qport);
+
+	cl->hash_next = svs.client_hash[hash];
+	cl->hash_bucket = hash + 1;
+	svs.client_hash[hash] = cl;
+}
+
+void
+SV_UnhashClient(client_t *cl)
+{
+	client_t **back;
+
+	if (!cl->hash_bucket)
+	{
+		return;
+	}
+
+	for (back = &svs.client_hash[cl->hash_bucket - 1]; *back;
+		 back = &(*back)->hash_next)
+	{
+		if (*back == cl)
+		{
+			*back = cl->hash_next;
+			break;
+		}
+	}
+
+	cl->hash_next = NULL;
+	cl->hash_bucket = 0;
+}
+
+static client_t *
+SV_FindClient(const netadr_t *adr, int qport)
+{
+	client_t *cl;
+
+	cl = svs.client_hash[SV_ClientHash(adr, qport)];
+
+	for ( ; cl; cl = cl->hash_next)
+	{
+		if ((cl->state != cs_free) && (cl->netchan.qport == qport) &&
+			NET_CompareBaseAdr(*adr, cl->netchan.remote_address))
+		{
+			return cl;
+		}
+	}
+
+	return NULL;
+}
+
 static void
 SV_ReadPackets(void)
 {
-	int i;
 	client_t *cl;
 	int qport;
 
@@ -215,49 +323,31 @@ SV_ReadPackets(void)
 		qport = MSG_ReadShort(&net_message) & 0xffff;
 
 		/* check for packets from connected clients */
-		for (i = 0, cl = svs.clients; i < maxclients->value; i++, cl++)
-		{
-			if (cl->state == cs_free)
-			{
-				continue;
-			}
+		cl = SV_FindClient(&net_from, qport);
 
-			if (!NET_CompareBaseAdr(net_from, cl->netchan.remote_address))
-			{
-				continue;
-			}
+		if (!cl)
+		{
+			continue;
+		}
 
-			if (cl->netchan.qport != qport)
-			{
-				continue;
-			}
+		if (cl->netchan.remote_address.port != net_from.port)
+		{
+			Com_Printf("%s: fixing up a translated port\n", __func__);
+			cl->netchan.remote_address.port = net_from.port;
+		}
 
-			if (cl->netchan.remote_address.port != net_from.port)
+		if (Netchan_Process(&cl->netchan, &net_message))
+		{
+			/* this is a valid, sequenced packet, so process it */
+			if (cl->state != cs_zombie)
 			{
-				Com_Printf("%s: fixing up a translated port\n", __func__);
-				cl->netchan.remote_address.port = net_from.port;
-			}
+				cl->lastmessage = svs.realtime; /* don't timeout */
 
-			if (Netchan_Process(&cl->netchan, &net_message))
-			{
-				/* this is a valid, sequenced packet, so process it */
-				if (cl->state != cs_zombie)
+				if (!(sv.demofile && (sv.state == ss_demo)))
 				{
-					cl->lastmessage = svs.realtime; /* don't timeout */
-
-					if (!(sv.demofile && (sv.state == ss_demo)))
-					{
-						SV_ExecuteClientMessage(cl);
-					}
+					SV_ExecuteClientMessage(cl);
 				}
 			}
-
-			break;
-		}
-
-		if (i != maxclients->value)
-		{
-			continue;
 		}
 	}
 }
@@ -294,6 +384,7 @@ SV_CheckTimeouts(void)
 			(cl->lastmessage < zombiepoint))
 		{
 			cl->state = cs_free; /* can now be reused */
+			SV_UnhashClient(cl);
 			continue;
 		}
 
@@ -303,6 +394,7 @@ SV_CheckTimeouts(void)
 			SV_BroadcastPrintf(PRINT_HIGH, "%s timed out\n", cl->name);
 			SV_DropClient(cl);
 			cl->state = cs_free; /* don't bother with zombie state */
+			SV_UnhashClient(cl);
 		}
 	}
 }
@@ -384,6 +476,78 @@ SV_Optimizations(void)
 	return cv ? ((int)cv->value & OPTIMIZE_MASK_ALL) : 0;
 }
 
+/* How late the game frames start, for tickstats */
+static struct
+{
+	int ticks;
+	long long total;
+	int max;
+	int late1, late5;   /* more than 1 and 5 msec late */
+} tickstats;
+
+void
+SV_TickStats_f(void)
+{
+	if ((Cmd_Argc() == 2) && !strcmp(Cmd_Argv(1), "reset"))
+	{
+		memset(&tickstats, 0, sizeof(tickstats));
+		return;
+	}
+
+	if (!tickstats.ticks)
+	{
+		Com_Printf("No server frames yet.\n");
+		return;
+	}
+
+	Com_Printf("%i frames started %.3f msec late on average, %.3f msec at most\n",
+			tickstats.ticks, tickstats.total / 1000.0 / tickstats.ticks,
+			tickstats.max / 1000.0);
+	Com_Printf("%i frames more than 1 msec late, %i more than 5 msec\n",
+			tickstats.late1, tickstats.late5);
+}
+
+/*
+ * Records how far the servers clock has run past the
+ * time the frame was due, when the frame starts.
+ */
+static void
+SV_RecordTickStart(void)
+{
+	int late;
+
+	late = (svs.realtime - sv.time) * 1000 + svs.realtime_usec;
+
+	tickstats.ticks++;
+	tickstats.total += late;
+	tickstats.max = Q_max(tickstats.max, late);
+
+	if (late > 1000)
+	{
+		tickstats.late1++;
+	}
+
+	if (late > 5000)
+	{
+		tickstats.late5++;
+	}
+}
+
+/*
+ * Returns the microseconds until the next game frame is
+ * due, counted from the last SV_Frame() call.
+ */
+int
+SV_FrameDelay(void)
+{
+	if (!svs.initialized || sv_timedemo->value)
+	{
+		return 0;
+	}
+
+	return (sv.time - svs.realtime) * 1000 - svs.realtime_usec;
+}
+
 void
 SV_Frame(int usec)
 {
@@ -399,16 +563,23 @@ SV_Frame(int usec)
 		return;
 	}
 
-	svs.realtime += usec / 1000;
+	/* keep the fraction of a msec for the next frame */
+	svs.realtime_usec += usec;
+	svs.realtime += svs.realtime_usec / 1000;
+	svs.realtime_usec %= 1000;
 
 	/* keep the random time dependent */
 	randk();
 
+	SV_ProfileBeginFrame();
+
 	/* check timeouts */
 	SV_CheckTimeouts();
+	SV_ProfileMark(PROF_TIMEOUTS);
 
 	/* get packets from clients */
 	SV_ReadPackets();
+	SV_ProfileMark(PROF_PACKETS);
 
 	/* send messages more often to new clients getting ready for spawning in
 	   speeds up the process of sending configstrings, entty deltas, etc.
@@ -418,6 +589,7 @@ SV_Frame(int usec)
 	if (opt_sendrate)
 	{
 		SV_SendPrepClientMessages();
+		SV_ProfileMark(PROF_SEND);
 	}
 
 	/* move autonomous things around if enough time has passed */
@@ -434,20 +606,33 @@ SV_Frame(int usec)
 			svs.realtime = sv.time - 100;
 		}
 
-		NET_Sleep(sv.time - svs.realtime);
+		/* The dedicated main loop sleeps until the
+		   frame is due itself, see Qcommon_Frame() */
+#ifndef DEDICATED_ONLY
+		NET_Sleep(SV_FrameDelay());
+#endif
 		return;
 	}
 
+	if (!sv_timedemo->value)
+	{
+		SV_RecordTickStart();
+	}
+
 	/* update ping based on the last known frame from all clients */
 	SV_CalcPings();
 
 	/* give the clients some timeslices */
 	SV_GiveMsec();
+	SV_ProfileMark(PROF_PINGS);
 
 	/* let everything in the world think and move */
+	CM_NewFrame();
 	SV_RunGameFrame();
+	SV_ProfileMark(PROF_GAME);
 
 	/* send messages back to the clients that had packets read this frame */
+	NET_BatchPackets(NS_SERVER);
 	SV_SendClientMessages();
 
 	/* if not optimizing, send all messages here */
@@ -456,14 +641,21 @@ SV_Frame(int usec)
 		SV_SendPrepClientMessages();
 	}
 
+	NET_FlushPackets(NS_SERVER);
+	SV_ProfileMark(PROF_SEND);
+
 	/* save the entire world state if recording a serverdemo */
 	SV_RecordDemoMessage();
+	SV_ProfileMark(PROF_DEMO);
 
 	/* send a heartbeat to the master if needed */
 	Master_Heartbeat();
+	SV_ProfileMark(PROF_HEARTBEAT);
 
 	/* clear teleport flags, etc for next frame */
 	SV_PrepWorldFrame();
+
+	SV_ProfileEndFrame();
 }
 
 /*
@@ -602,6 +794,7 @@ void
 SV_Init(void)
 {
 	SV_InitOperatorCommands();
+	SV_InitProfile();
 
 	sv_optimize_sp_loadtime = Cvar_Get("sv_optimize_sp_loadtime", "31", 0);
 	sv_optimize_mp_loadtime = Cvar_Get("sv_optimize_mp_loadtime", "7", 0);
@@ -642,6 +835,65 @@ SV_Init(void)
 	SZ_Init(&net_message, net_message_buffer, sizeof(net_message_buffer));
 }
 
+/*
+ * Called once at dedicated server startup, after the command
+ * line was executed. Runs sv_instances servers in copies of
+ * this process. The first map, the filesystem index and the
+ * game code are loaded once and shared by all copies until
+ * they write to them. Copy n listens on port + n and executes
+ * instance<n>.cfg, if there is one.
+ */
+void
+SV_StartInstances(void)
+{
+	cvar_t *sv_instances;
+	char cfg[MAX_QPATH];
+	int instance;
+	int port;
+
+	sv_instances = Cvar_Get("sv_instances", "1", CVAR_NOSET);
+
+	if (!dedicated->value || (sv_instances->value <= 1))
+	{
+		return;
+	}
+
+	/* load the map before forking, so it's shared */
+	Cbuf_Execute();
+
+	port = Cvar_Get("port", va("%i", PORT_SERVER), CVAR_NOSET)->value;
+
+	/* threads don't survive fork() */
+	Jobs_Shutdown();
+	instance = Sys_ForkInstances(sv_instances->value);
+	Jobs_Init();
+
+	Cvar_FullSet("sv_instance", va("%i", instance), CVAR_NOSET);
+
+	if (!instance)
+	{
+		return;
+	}
+
+	/* give the copy its own sockets */
+	NET_Config(false);
+	Cvar_FullSet("port", va("%i", port + instance), CVAR_NOSET);
+
+	if (Com_ServerState())
+	{
+		NET_Config(true);
+	}
+
+	Com_Printf("Instance %i listening on port %i.\n", instance, port + instance);
+
+	Com_sprintf(cfg, sizeof(cfg), "instance%i.cfg", instance);
+
+	if (FS_LoadFile(cfg, NULL) > 0)
+	{
+		Cbuf_AddText(va("exec %s\n", cfg));
+	}
+}
+
 /*
  * Used by SV_Shutdown to send a final message to all
  * connected clients before the server goes down. The
@@ -674,11 +926,11 @@ SV_FinalMessage(char *message, qboolean reconnect)
 	 *     because this is called by SV_Shutdown() and the shut down server might have
 	 *     a different number of clients (e.g. 1 if it's single player), when maxclients
 	 *     has already been set to a higher value for multiplayer (e.g. 4 for coop)
-	 *     Luckily, svs.num_client_entities = maxclients->value * UPDATE_BACKUP * 64;
+	 *     Luckily, svs.num_client_entities = maxclients->value * ENTITIES_PER_CLIENT;
 	 *     with the maxclients value from when the current server was started (see SV_InitGame())
 	 *     so we can just calculate the right number of clients from that
 	 */
-	int numClients = svs.num_client_entities / ( UPDATE_BACKUP * 64 );
+	int numClients = svs.num_client_entities / ENTITIES_PER_CLIENT;
 	for (i = 0, cl = svs.clients; i < numClients; i++, cl++)
 	{
 		if (cl->state >= cs_connected)
@@ -748,6 +1000,13 @@ SV_Shutdown(char *finalmsg, qboolean reconnect)
 		Z_Free(svs.client_entities);
 	}
 
+	if (svs.sends)
+	{
+		Z_Free(svs.sends);
+	}
+
+	SV_FreeEntityIndex();
+
 	if (svs.demofile)
 	{
 		fclose(svs.demofile);
@@ -0,0 +1,550 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * Server frame profiler. SV_Frame() marks the end of each of its phases,
+ * the times of the last PROF_WINDOW game frames are kept for the
+ * percentiles. Games that support the extension report the think time
+ * of every entity if sv_profile_think is set, which is summed up by
+ * classname. The results are
+ * printed by the sv_profile command and can be appended to a file
+ * every few seconds.
+ *
+ * =======================================================================
+ */
+
+#include "header/server.h"
+
+#define PROF_WINDOW 1024      /* game frames, a bit less than 2 minutes */
+#define PROF_MAXCLASSES 512   /* must be a power of two */
+#define PROF_SHOWCLASSES 20
+
+typedef struct
+{
+	char name[48];
+	unsigned int hash;
+	qboolean inframe;   /* already in frameclasses */
+	int frame;          /* usec in the current frame */
+	int calls;
+	long long total;
+	int max;            /* most usec in a single frame */
+} profclass_t;
+
+static const char *phasenames[PROF_NUMPHASES] = {
+	"timeouts",
+	"packets",
+	"pings",
+	"game",
+	"send",
+	"demo",
+	"heartbeat",
+	"total"
+};
+
+static cvar_t *sv_profile_dump;
+static cvar_t *sv_profile_file;
+static cvar_t *sv_profile_overrun;
+static cvar_t *sv_profile_think;
+
+/* the current frame */
+static long long prof_last;
+static int prof_cur[PROF_NUMPHASES];
+
+/* the last game frames */
+static int prof_samples[PROF_WINDOW][PROF_NUMPHASES];
+static int prof_head;
+static int prof_frames;
+static int prof_lastdump;
+
+/* think time by classname, hashed */
+static profclass_t profclasses[PROF_MAXCLASSES];
+static profclass_t profother;
+static int numprofclasses;
+static int frameclasses[PROF_MAXCLASSES + 1];
+static int numframeclasses;
+
+static void
+SV_ProfileReset(void)
+{
+	memset(prof_cur, 0, sizeof(prof_cur));
+	prof_head = prof_frames = 0;
+
+	memset(profclasses, 0, sizeof(profclasses));
+	memset(&profother, 0, sizeof(profother));
+	Q_strlcpy(profother.name, "(other)", sizeof(profother.name));
+	numprofclasses = numframeclasses = 0;
+
+	prof_lastdump = svs.realtime;
+}
+
+static profclass_t *
+SV_ProfileClass(int index)
+{
+	return (index < PROF_MAXCLASSES) ? &profclasses[index] : &profother;
+}
+
+static unsigned int
+SV_ProfileHash(const char *name)
+{
+	unsigned int hash = 2166136261u;
+
+	while (*name)
+	{
+		hash = (hash ^ (byte)*name++) * 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+ * Called by the game after each entity ran.
+ */
+void
+SV_ProfileThink(const char *classname, int usec)
+{
+	profclass_t *c;
+	unsigned int hash;
+	int i;
+
+	if (!classname || !classname[0])
+	{
+		classname = "(none)";
+	}
+
+	hash = SV_ProfileHash(classname);
+	i = hash & (PROF_MAXCLASSES - 1);
+
+	for ( ; ; )
+	{
+		c = &profclasses[i];
+
+		if (!c->name[0])
+		{
+			/* keep the table at most 3/4 full */
+			if (numprofclasses >= PROF_MAXCLASSES * 3 / 4)
+			{
+				i = PROF_MAXCLASSES;
+				c = &profother;
+				break;
+			}
+
+			Q_strlcpy(c->name, classname, sizeof(c->name));
+			c->hash = hash;
+			numprofclasses++;
+			break;
+		}
+
+		if ((c->hash == hash) &&
+			!strncmp(c->name, classname, sizeof(c->name) - 1))
+		{
+			break;
+		}
+
+		i = (i + 1) & (PROF_MAXCLASSES - 1);
+	}
+
+	if (!c->inframe)
+	{
+		c->inframe = true;
+		frameclasses[numframeclasses++] = i;
+	}
+
+	c->frame += usec;
+	c->calls++;
+}
+
+/*
+ * Starts timing the phases of SV_Frame(). Frames
+ * that only read packets and sleep add to the
+ * next frame that runs the game.
+ */
+void
+SV_ProfileBeginFrame(void)
+{
+	prof_last = Sys_Microseconds();
+}
+
+/*
+ * Adds the time since the last mark to phase.
+ */
+void
+SV_ProfileMark(profphase_t phase)
+{
+	long long now;
+	int usec;
+
+	now = Sys_Microseconds();
+	usec = (int)(now - prof_last);
+	prof_last = now;
+
+	prof_cur[phase] += usec;
+
+	if (phase != PROF_TOTAL)
+	{
+		prof_cur[PROF_TOTAL] += usec;
+	}
+}
+
+static int
+SV_ProfileCompareInts(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+static void
+SV_ProfilePercentiles(profphase_t phase, int *p50, int *p99, int *max)
+{
+	static int sorted[PROF_WINDOW];
+	int i;
+
+	if (!prof_frames)
+	{
+		*p50 = *p99 = *max = 0;
+		return;
+	}
+
+	for (i = 0; i < prof_frames; i++)
+	{
+		sorted[i] = prof_samples[i][phase];
+	}
+
+	qsort(sorted, prof_frames, sizeof(int), SV_ProfileCompareInts);
+
+	*p50 = sorted[(prof_frames - 1) * 50 / 100];
+	*p99 = sorted[(prof_frames - 1) * 99 / 100];
+	*max = sorted[prof_frames - 1];
+}
+
+static int
+SV_ProfileCompareClasses(const void *a, const void *b)
+{
+	const profclass_t *ca = SV_ProfileClass(*(const int *)a);
+	const profclass_t *cb = SV_ProfileClass(*(const int *)b);
+
+	if (ca->total != cb->total)
+	{
+		return (ca->total < cb->total) ? 1 : -1;
+	}
+
+	return strcmp(ca->name, cb->name);
+}
+
+/*
+ * Fills list with the indices of all classes
+ * that ever ran, the most expensive first.
+ */
+static int
+SV_ProfileSortClasses(int *list)
+{
+	int i, count;
+
+	count = 0;
+
+	for (i = 0; i < PROF_MAXCLASSES; i++)
+	{
+		if (profclasses[i].name[0])
+		{
+			list[count++] = i;
+		}
+	}
+
+	if (profother.calls)
+	{
+		list[count++] = PROF_MAXCLASSES;
+	}
+
+	qsort(list, count, sizeof(int), SV_ProfileCompareClasses);
+
+	return count;
+}
+
+/*
+ * Prints where the time of a frame longer
+ * than sv_profile_overrun msec went.
+ */
+static void
+SV_ProfileOverrun(void)
+{
+	char line[256];
+	int best[3] = {-1, -1, -1};
+	int i, j, k;
+
+	Com_sprintf(line, sizeof(line), "Frame %i took %.1f msec:",
+			sv.framenum, prof_cur[PROF_TOTAL] / 1000.0f);
+
+	for (i = 0; i < PROF_TOTAL; i++)
+	{
+		if (prof_cur[i] >= 100)
+		{
+			Q_strlcat(line, va(" %s %.1f", phasenames[i],
+						prof_cur[i] / 1000.0f), sizeof(line));
+		}
+	}
+
+	Com_Printf("%s\n", line);
+
+	/* the three classes that took the longest */
+	for (i = 0; i < numframeclasses; i++)
+	{
+		int frame = SV_ProfileClass(frameclasses[i])->frame;
+
+		for (j = 0; j < 3; j++)
+		{
+			if ((best[j] < 0) ||
+				(frame > SV_ProfileClass(frameclasses[best[j]])->frame))
+			{
+				for (k = 2; k > j; k--)
+				{
+					best[k] = best[k - 1];
+				}
+
+				best[j] = i;
+				break;
+			}
+		}
+	}
+
+	if (best[0] < 0)
+	{
+		return;
+	}
+
+	Q_strlcpy(line, "  slowest:", sizeof(line));
+
+	for (j = 0; (j < 3) && (best[j] >= 0); j++)
+	{
+		const profclass_t *c = SV_ProfileClass(frameclasses[best[j]]);
+
+		Q_strlcat(line, va(" %s %.1f", c->name, c->frame / 1000.0f),
+				sizeof(line));
+	}
+
+	Com_Printf("%s\n", line);
+}
+
+static void
+SV_ProfileWriteString(FILE *f, const char *s)
+{
+	fputc('"', f);
+
+	for ( ; *s; s++)
+	{
+		if ((*s == '"') || (*s == '\\'))
+		{
+			fputc('\\', f);
+		}
+
+		if ((byte)*s >= ' ')
+		{
+			fputc(*s, f);
+		}
+	}
+
+	fputc('"', f);
+}
+
+/*
+ * Appends the current state as a single line of JSON to
+ * sv_profile_file. Phases are p50, p99 and max over the
+ * window, classes are calls, total and max per frame
+ * since the last reset. All times are in usec.
+ */
+static void
+SV_ProfileDump(void)
+{
+	static int list[PROF_MAXCLASSES + 1];
+	char name[MAX_OSPATH];
+	int i, count, p50, p99, max;
+	FILE *f;
+
+	Com_sprintf(name, sizeof(name), "%s/%s", FS_Gamedir(),
+			sv_profile_file->string);
+	FS_CreatePath(name);
+
+	f = Q_fopen(name, "a");
+
+	if (!f)
+	{
+		Com_Printf("Couldn't open %s, profile dump disabled.\n", name);
+		Cvar_Set("sv_profile_dump", "0");
+		return;
+	}
+
+	fprintf(f, "{\"time\":%i,\"map\":", svs.realtime);
+	SV_ProfileWriteString(f, sv.name);
+	fprintf(f, ",\"frames\":%i,\"phases\":{", prof_frames);
+
+	for (i = 0; i < PROF_NUMPHASES; i++)
+	{
+		SV_ProfilePercentiles(i, &p50, &p99, &max);
+		fprintf(f, "%s\"%s\":[%i,%i,%i]", i ? "," : "",
+				phasenames[i], p50, p99, max);
+	}
+
+	fprintf(f, "},\"classes\":{");
+
+	count = SV_ProfileSortClasses(list);
+
+	for (i = 0; i < count; i++)
+	{
+		const profclass_t *c = SV_ProfileClass(list[i]);
+
+		if (i)
+		{
+			fputc(',', f);
+		}
+
+		SV_ProfileWriteString(f, c->name);
+		fprintf(f, ":[%i,%lld,%i]", c->calls, c->total, c->max);
+	}
+
+	fprintf(f, "}}\n");
+	fclose(f);
+}
+
+/*
+ * Stores the finished game frame in the window.
+ */
+void
+SV_ProfileEndFrame(void)
+{
+	int i;
+
+	SV_ProfileMark(PROF_TOTAL);
+
+	memcpy(prof_samples[prof_head], prof_cur, sizeof(prof_cur));
+	prof_head = (prof_head + 1) % PROF_WINDOW;
+	prof_frames = Q_min(prof_frames + 1, PROF_WINDOW);
+
+	if ((sv_profile_overrun->value > 0) &&
+		(prof_cur[PROF_TOTAL] > sv_profile_overrun->value * 1000))
+	{
+		SV_ProfileOverrun();
+	}
+
+	for (i = 0; i < numframeclasses; i++)
+	{
+		profclass_t *c = SV_ProfileClass(frameclasses[i]);
+
+		c->total += c->frame;
+		c->max = Q_max(c->max, c->frame);
+		c->frame = 0;
+		c->inframe = false;
+	}
+
+	numframeclasses = 0;
+	memset(prof_cur, 0, sizeof(prof_cur));
+
+	if (sv_profile_dump->value > 0)
+	{
+		/* svs.realtime is reset by a new game */
+		if (svs.realtime < prof_lastdump)
+		{
+			prof_lastdump = svs.realtime;
+		}
+
+		if (svs.realtime - prof_lastdump >= sv_profile_dump->value * 1000)
+		{
+			prof_lastdump = svs.realtime;
+			SV_ProfileDump();
+		}
+	}
+}
+
+/*
+ * Think times are only taken if something uses them.
+ */
+qboolean
+SV_ProfileThinkWanted(void)
+{
+	return sv_profile_think->value || sv_profile_dump->value ||
+		sv_profile_overrun->value;
+}
+
+void
+SV_Profile_f(void)
+{
+	static int list[PROF_MAXCLASSES + 1];
+	int i, count, p50, p99, max;
+
+	if ((Cmd_Argc() == 2) && !strcmp(Cmd_Argv(1), "reset"))
+	{
+		SV_ProfileReset();
+		return;
+	}
+
+	if (!prof_frames)
+	{
+		Com_Printf("No server frames yet.\n");
+		return;
+	}
+
+	Com_Printf("Last %i frames, msec:\n", prof_frames);
+	Com_Printf("phase          p50      p99      max\n");
+
+	for (i = 0; i < PROF_NUMPHASES; i++)
+	{
+		SV_ProfilePercentiles(i, &p50, &p99, &max);
+		Com_Printf("%-10s %7.3f  %7.3f  %7.3f\n", phasenames[i],
+				p50 / 1000.0f, p99 / 1000.0f, max / 1000.0f);
+	}
+
+	count = SV_ProfileSortClasses(list);
+
+	if (!count)
+	{
+		if (!ge_extversion)
+		{
+			Com_Printf("The game doesn't report think times.\n");
+		}
+
+		else if (!SV_ProfileThinkWanted())
+		{
+			Com_Printf("Set sv_profile_think to 1 for think times.\n");
+		}
+
+		return;
+	}
+
+	Com_Printf("\nThink time since reset, msec:\n");
+	Com_Printf("class                          calls      total  max/frame\n");
+
+	for (i = 0; i < Q_min(count, PROF_SHOWCLASSES); i++)
+	{
+		const profclass_t *c = SV_ProfileClass(list[i]);
+
+		Com_Printf("%-28.28s %8i %10.3f %10.3f\n", c->name, c->calls,
+				c->total / 1000.0, c->max / 1000.0f);
+	}
+
+	if (count > PROF_SHOWCLASSES)
+	{
+		Com_Printf("%i more classes.\n", count - PROF_SHOWCLASSES);
+	}
+}
+
+void
+SV_InitProfile(void)
+{
+	sv_profile_dump = Cvar_Get("sv_profile_dump", "0", 0);
+	sv_profile_file = Cvar_Get("sv_profile_file", "profile.log", 0);
+	sv_profile_overrun = Cvar_Get("sv_profile_overrun", "0", 0);
+	sv_profile_think = Cvar_Get("sv_profile_think", "0", 0);
+
+	SV_ProfileReset();
+}
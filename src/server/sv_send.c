@@ -211,7 +211,7 @@ SV_Multicast(const vec3_t origin, multicast_t to)
 	int leafnum, cluster, area1 = 0, j;
 	qboolean reliable;
 	client_t *client;
-	byte *mask;
+	const byte *mask;
 
 	reliable = false;
 
@@ -443,52 +443,136 @@ SV_StartSound(const vec3_t origin, const edict_t *entity, int channel, int sound
 	SV_Multicast(origin, to);
 }
 
-static qboolean
-SV_SendClientDatagram(client_t *client)
+/*
+ * Writes the frame and the accumulated multicast datagram
+ * into msg. Doesn't print or transmit anything, so it can
+ * run on a worker thread.
+ */
+static void
+SV_WriteClientDatagram(client_t *client, sizebuf_t *msg)
 {
-	byte msg_buf[MAX_MSGLEN];
-	sizebuf_t msg;
-
-	SV_BuildClientFrame(client);
-
-	SZ_Init(&msg, msg_buf, sizeof(msg_buf));
-	msg.allowoverflow = true;
-
 	/* send over all the relevant entity_state_t
 	   and the player_state_t */
-	SV_WriteFrameToClient(client, &msg);
+	SV_WriteFrameToClient(client, msg);
 
 	/* copy the accumulated multicast datagram
 	   for this client out to the message
 	   it is necessary for this to be after the WriteEntities
 	   so that entity references will be current */
-	if (client->datagram.overflowed)
+	if (!client->datagram.overflowed)
 	{
-		Com_Printf("WARNING: datagram overflowed for %s\n", client->name);
+		if (msg->cursize + client->datagram.cursize > msg->maxsize)
+		{
+			SZ_Clear(msg);
+			msg->overflowed = true;
+		}
+		else
+		{
+			SZ_Write(msg, client->datagram.data, client->datagram.cursize);
+		}
 	}
-	else
+}
+
+static void
+SV_TransmitClientDatagram(client_t *client, sizebuf_t *msg)
+{
+	if (client->datagram.overflowed)
 	{
-		SZ_Write(&msg, client->datagram.data, client->datagram.cursize);
+		Com_Printf("WARNING: datagram overflowed for %s\n", client->name);
 	}
 
 	SZ_Clear(&client->datagram);
 
-	if (msg.overflowed)
+	if (msg->overflowed)
 	{
 		/* must have room left for the packet header */
 		Com_Printf("WARNING: msg overflowed for %s\n", client->name);
-		SZ_Clear(&msg);
+		SZ_Clear(msg);
 	}
 
 	/* send the datagram */
-	Netchan_Transmit(&client->netchan, msg.cursize, msg.data);
+	Netchan_Transmit(&client->netchan, msg->cursize, msg->data);
 
 	/* record the size for rate estimation */
-	client->message_size[sv.framenum % RATE_MESSAGES] = msg.cursize;
+	client->message_size[sv.framenum % RATE_MESSAGES] = msg->cursize;
+}
+
+static qboolean
+SV_SendClientDatagram(client_t *client)
+{
+	byte msg_buf[MAX_MSGLEN];
+	sizebuf_t msg;
+
+	SV_BuildClientFrame(client);
+
+	SZ_Init(&msg, msg_buf, sizeof(msg_buf));
+	msg.allowoverflow = true;
+
+	SV_WriteClientDatagram(client, &msg);
+	SV_TransmitClientDatagram(client, &msg);
 
 	return true;
 }
 
+static void
+SV_SendClientJob(void *data, int index)
+{
+	clientsend_t *send = (clientsend_t *)data + index;
+
+	SV_BuildClientEntities(send->client, &send->view);
+	SV_WriteClientDatagram(send->client, &send->msg);
+}
+
+/*
+ * Sends the datagrams of several clients. The frames are
+ * built and delta compressed on the worker threads, all
+ * collision model lookups and the network traffic stay
+ * on the main thread.
+ */
+static void
+SV_SendClientDatagrams(client_t **clients, int count)
+{
+	clientsend_t *send;
+	int i, n;
+
+	if (!svs.sends)
+	{
+		svs.sends = Z_Malloc(svs.num_client_entities /
+				ENTITIES_PER_CLIENT * sizeof(clientsend_t));
+	}
+
+	for (i = 0, n = 0; i < count; i++)
+	{
+		send = &svs.sends[n];
+		send->client = clients[i];
+
+		SZ_Init(&send->msg, send->msg_buf, sizeof(send->msg_buf));
+		send->msg.allowoverflow = true;
+
+		/* filled on a worker, so it must not print. The
+		   overflow is reported in SV_TransmitClientDatagram() */
+		send->msg.quietoverflow = true;
+
+		if (!SV_SetupClientView(clients[i], &send->view))
+		{
+			/* not in game yet, send the
+			   last frame again */
+			SV_WriteClientDatagram(clients[i], &send->msg);
+			SV_TransmitClientDatagram(clients[i], &send->msg);
+			continue;
+		}
+
+		n++;
+	}
+
+	Jobs_Run(SV_SendClientJob, svs.sends, n);
+
+	for (i = 0; i < n; i++)
+	{
+		SV_TransmitClientDatagram(svs.sends[i].client, &svs.sends[i].msg);
+	}
+}
+
 static void
 SV_DemoCompleted(void)
 {
@@ -592,6 +676,8 @@ SV_SendClientMessages(void)
 	client_t *c;
 	int msglen;
 	byte msgbuf[MAX_MSGLEN];
+	client_t *spawned[MAX_CLIENTS];
+	int numspawned = 0;
 
 	/* read the next demo message if needed */
 	if (sv.demofile && (sv.state == ss_demo))
@@ -609,6 +695,11 @@ SV_SendClientMessages(void)
 		msglen = 0;
 	}
 
+	if (sv.state == ss_game)
+	{
+		SV_IndexEntities();
+	}
+
 	/* send a message to each spawned client */
 	for (i = 0, c = svs.clients; i < maxclients->value; i++, c++)
 	{
@@ -637,11 +728,27 @@ SV_SendClientMessages(void)
 				continue;
 			}
 
+			if (Jobs_NumWorkers())
+			{
+				/* sent below */
+				spawned[numspawned++] = c;
+				continue;
+			}
+
 			SV_SendClientDatagram(c);
 		}
 
 		/* messages to non-spawned clients are sent by SendPrepClientMessages */
 	}
+
+	if (numspawned == 1)
+	{
+		SV_SendClientDatagram(spawned[0]);
+	}
+	else if (numspawned > 1)
+	{
+		SV_SendClientDatagrams(spawned, numspawned);
+	}
 }
 
 void
@@ -558,17 +558,14 @@ SV_HullForEntity(edict_t *ent)
 }
 
 static void
-SV_ClipMoveToEntities(moveclip_t *clip)
+SV_ClipMoveToEntities(moveclip_t *clip, edict_t **touchlist, int num)
 {
-	int i, num;
-	edict_t *touchlist[MAX_EDICTS], *touch;
+	int i;
+	edict_t *touch;
 	trace_t trace;
 	int headnode;
 	float *angles;
 
-	num = SV_AreaEdicts(clip->boxmins, clip->boxmaxs, touchlist,
-			MAX_EDICTS, AREA_SOLID);
-
 	/* be careful, it is possible to have an entity in this
 	   list removed before we get to it (killtriggered) */
 	for (i = 0; i < num; i++)
@@ -679,6 +676,8 @@ SV_Trace(const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t
 		const edict_t *passedict, int contentmask)
 {
 	moveclip_t clip;
+	edict_t *touchlist[MAX_EDICTS];
+	int num;
 
 	if (!mins)
 	{
@@ -716,8 +715,162 @@ SV_Trace(const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t
 			end, clip.boxmins, clip.boxmaxs);
 
 	/* clip to other solid entities */
-	SV_ClipMoveToEntities(&clip);
+	num = SV_AreaEdicts(clip.boxmins, clip.boxmaxs, touchlist,
+			MAX_EDICTS, AREA_SOLID);
+	SV_ClipMoveToEntities(&clip, touchlist, num);
 
 	return clip.trace;
 }
 
+/* a part of the requests of SV_TraceBatch() */
+#define MAX_TRACEJOBS 32
+
+typedef struct
+{
+	const tracerequest_t *requests;
+	trace_t *results;
+	int count;
+	int perjob;
+} tracebatch_t;
+
+static cmtrace_t sv_tracectx[MAX_TRACEJOBS];
+
+/*
+ * Clips a part of the batch to the world, runs on the worker
+ * threads. Each job has its own trace context.
+ */
+static void
+SV_TraceBatchWorld(void *data, int job)
+{
+	const tracebatch_t *batch = data;
+	int i, last;
+
+	last = Q_min((job + 1) * batch->perjob, batch->count);
+
+	for (i = job * batch->perjob; i < last; i++)
+	{
+		const tracerequest_t *req = &batch->requests[i];
+
+		batch->results[i] = CM_BoxTraceCtx(&sv_tracectx[job], req->start,
+				req->end, req->mins, req->maxs, 0, req->contentmask);
+	}
+}
+
+/*
+ * Runs count independent traces, giving the same results as
+ * SV_Trace(). The world traces run in parallel. The entities
+ * are gathered once for the bounds of all moves and then
+ * filtered for each trace. That gives the same entities in
+ * the same order as SV_AreaEdicts() for the single move,
+ * because an entity is linked to the first area node its box
+ * crosses.
+ */
+void
+SV_TraceBatch(const tracerequest_t *requests, trace_t *results, int count)
+{
+	edict_t *arealist[MAX_EDICTS], *touchlist[MAX_EDICTS];
+	vec3_t allmins, allmaxs;
+	tracebatch_t batch;
+	int i, j, jobs, numarea;
+	qboolean moving;
+
+	if (count <= 0)
+	{
+		return;
+	}
+
+	jobs = Q_min(Jobs_NumWorkers() + 1, MAX_TRACEJOBS);
+	jobs = Q_max(Q_min(jobs, count / 8), 1);
+
+	batch.requests = requests;
+	batch.results = results;
+	batch.count = count;
+	batch.perjob = (count + jobs - 1) / jobs;
+
+	Jobs_Run(SV_TraceBatchWorld, &batch, jobs);
+
+	for (i = 0; i < jobs; i++)
+	{
+		CM_AddTraceStats(&sv_tracectx[i]);
+	}
+
+	/* bounds of all moves not blocked by the world */
+	ClearBounds(allmins, allmaxs);
+	moving = false;
+
+	for (i = 0; i < count; i++)
+	{
+		results[i].ent = ge->edicts;
+
+		if (results[i].fraction != 0)
+		{
+			vec3_t boxmins, boxmaxs;
+
+			SV_TraceBounds(requests[i].start, requests[i].mins,
+					requests[i].maxs, requests[i].end, boxmins, boxmaxs);
+			AddPointToBounds(boxmins, allmins, allmaxs);
+			AddPointToBounds(boxmaxs, allmins, allmaxs);
+			moving = true;
+		}
+	}
+
+	if (!moving)
+	{
+		return; /* all blocked by the world */
+	}
+
+	numarea = SV_AreaEdicts(allmins, allmaxs, arealist, MAX_EDICTS,
+			AREA_SOLID);
+
+	for (i = 0; i < count; i++)
+	{
+		const tracerequest_t *req = &requests[i];
+		moveclip_t clip;
+		int num;
+
+		if (results[i].fraction == 0)
+		{
+			continue; /* blocked by the world */
+		}
+
+		memset(&clip, 0, sizeof(moveclip_t));
+
+		clip.trace = results[i];
+		clip.contentmask = req->contentmask;
+		clip.start = req->start;
+		clip.end = req->end;
+		clip.mins = req->mins;
+		clip.maxs = req->maxs;
+		clip.passedict = req->passent;
+
+		VectorCopy(req->mins, clip.mins2);
+		VectorCopy(req->maxs, clip.maxs2);
+
+		SV_TraceBounds(req->start, clip.mins2, clip.maxs2,
+				req->end, clip.boxmins, clip.boxmaxs);
+
+		/* the same test as in SV_AreaEdicts_r() */
+		num = 0;
+
+		for (j = 0; j < numarea; j++)
+		{
+			const edict_t *check = arealist[j];
+
+			if ((check->absmin[0] > clip.boxmaxs[0]) ||
+				(check->absmin[1] > clip.boxmaxs[1]) ||
+				(check->absmin[2] > clip.boxmaxs[2]) ||
+				(check->absmax[0] < clip.boxmins[0]) ||
+				(check->absmax[1] < clip.boxmins[1]) ||
+				(check->absmax[2] < clip.boxmins[2]))
+			{
+				continue; /* not touching */
+			}
+
+			touchlist[num++] = arealist[j];
+		}
+
+		SV_ClipMoveToEntities(&clip, touchlist, num);
+		results[i] = clip.trace;
+	}
+}
+